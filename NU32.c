@@ -1,5 +1,6 @@
 #include <plib.h>
 #include "NU32.h"
+#include "load.h"
 
 #define DESIRED_BAUDRATE_NU32 230400 // Baudrate for RS232
 
@@ -94,6 +95,8 @@ void NU32_DisableUART1Interrupt(void) {
 void NU32_ReadUART1(char * message, int maxLength) {
   char data;
   int complete = 0, num_bytes = 0;
+  // waiting for the PC counts as idle time
+  load_idle_begin();
   // loop until you get a '\r' or '\n'
   while (!complete) {
     if (U1STAbits.URXDA) {
@@ -110,10 +113,46 @@ void NU32_ReadUART1(char * message, int maxLength) {
       }
     }
   }
+  load_idle_end();
   // end the string
   message[num_bytes] = '\0';
 }
 
+/* Read n bytes from UART1, whatever their values
+ * blocks until all of them have arrived.  Used for binary frames, which may contain '\r' and '\n'
+ */
+void NU32_ReadBytesUART1(char * data, int n) {
+  int num_bytes = 0;
+  load_idle_begin();
+  while (num_bytes != n) {
+    if (U1STAbits.URXDA) {
+      data[num_bytes] = U1RXREG;
+      num_bytes++;
+    }
+  }
+  load_idle_end();
+}
+
+/* Read one byte from UART1 if one has arrived, without waiting
+ * returns 1 if a byte was read into data, 0 otherwise.  Lets the foreground check for commands
+ * between other work
+ */
+int NU32_PollUART1(char * data) {
+  if (U1STAbits.URXDA) {
+    *data = U1RXREG;
+    return 1;
+  }
+  return 0;
+}
+
+// Write n bytes using UART1, including any zero bytes
+void NU32_WriteBytesUART1(const char * data, int n) {
+  int i;
+  for (i = 0; i != n; i++) {
+    PutCharacter(UART1, data[i]);
+  }
+}
+
 // Write a charater array using UART1
 void NU32_WriteUART1(const char *string) {
   WriteString(UART1, string);
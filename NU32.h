@@ -28,6 +28,9 @@
 void NU32_Startup();
 void NU32_ReadUART1(char* string,int maxLength);
 void NU32_WriteUART1(const char *string);
+void NU32_ReadBytesUART1(char* data,int n);
+void NU32_WriteBytesUART1(const char *data,int n);
+int NU32_PollUART1(char* data);
 void NU32_EnableUART1Interrupt();
 void NU32_DisableUART1Interrupt();
 void WriteString(UART_MODULE id, const char *string);
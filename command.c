@@ -0,0 +1,613 @@
+#include "command.h"
+#include "core.h"
+#include "current.h"
+#include "motion.h"
+#include "param.h"
+#include "streaming.h"
+#include "trace.h"
+#include "load.h"
+#include "NU32.h"
+
+/// @file command.c
+/// @brief Implements the binary command frames
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MAX_ARGS 4		// the most arguments a command takes
+#define MAX_REPLY 104		// the longest reply that is not a stream: a parameter value, or a few ints
+#define SAMPLE_BYTES 12		// r, s and u of a streamed sample
+#define FRAME_SAMPLES 8		// the most samples in a COMMAND_SAMPLES frame, which bounds how long a reply waits for one
+#define MAX_STREAM 0x1000000	// the most samples a command streams, about a day of the motion loop
+
+/// @brief An argument of a command, as declared by the type in its table entry
+union CommandArg {
+	int i;				/// 'i'
+	const char * s;			/// 's', within the payload
+	struct {
+		const unsigned char * data;	/// little endian shorts, within the payload
+		int n;
+	} a;				/// 'a'
+};
+
+/// @brief An entry of the command table
+struct Command {
+	enum CommandOpcode opcode;
+	const char * args;		/// the types of the arguments, in order
+	int concurrent;			/// 1 if the command may run while a stream is in progress
+	/// @brief Carries out the command.  Values put in the reply with reply_int() or
+	///	   reply_text() are sent once it returns.
+	/// @return an enum CommandStatus
+	int (*run)(const union CommandArg * args);
+};
+
+static int run_state(const union CommandArg * args);
+static int run_angle(const union CommandArg * args);
+static int run_encoder(const union CommandArg * args);
+static int run_encoder_reset(const union CommandArg * args);
+static int run_adc(const union CommandArg * args);
+static int run_amps(const union CommandArg * args);
+static int run_pwm(const union CommandArg * args);
+static int run_stop(const union CommandArg * args);
+static int run_tune(const union CommandArg * args);
+static int run_trajectory(const union CommandArg * args);
+static int run_execute(const union CommandArg * args);
+static int run_hold(const union CommandArg * args);
+static int run_goto(const union CommandArg * args);
+static int run_queue_goto(const union CommandArg * args);
+static int run_queue_dwell(const union CommandArg * args);
+static int run_queue_trajectory(const union CommandArg * args);
+static int run_queue_hold(const union CommandArg * args);
+static int run_queue_pvt(const union CommandArg * args);
+static int run_queue_status(const union CommandArg * args);
+static int run_watch(const union CommandArg * args);
+static int run_param_get(const union CommandArg * args);
+static int run_param_set(const union CommandArg * args);
+static int run_save(const union CommandArg * args);
+static int run_load(const union CommandArg * args);
+
+static const struct Command commands[] = {
+	{COMMAND_STATE, "", 1, run_state},
+	{COMMAND_ANGLE, "", 1, run_angle},
+	{COMMAND_ENCODER, "", 1, run_encoder},
+	{COMMAND_ENCODER_RESET, "", 0, run_encoder_reset},
+	{COMMAND_ADC, "", 1, run_adc},
+	{COMMAND_AMPS, "", 1, run_amps},
+	{COMMAND_PWM, "i", 0, run_pwm},
+	{COMMAND_STOP, "", 1, run_stop},
+	{COMMAND_TUNE, "i", 0, run_tune},
+	{COMMAND_TRAJECTORY, "a", 0, run_trajectory},
+	{COMMAND_EXECUTE, "i", 0, run_execute},
+	{COMMAND_HOLD, "i", 0, run_hold},
+	{COMMAND_GOTO, "ii", 0, run_goto},
+	{COMMAND_QUEUE_GOTO, "iii", 1, run_queue_goto},
+	{COMMAND_QUEUE_DWELL, "i", 1, run_queue_dwell},
+	{COMMAND_QUEUE_TRAJECTORY, "", 1, run_queue_trajectory},
+	{COMMAND_QUEUE_HOLD, "", 1, run_queue_hold},
+	{COMMAND_QUEUE_STATUS, "", 1, run_queue_status},
+	{COMMAND_WATCH, "i", 0, run_watch},
+	{COMMAND_QUEUE_PVT, "iii", 1, run_queue_pvt},
+	{COMMAND_PARAM_GET, "s", 1, run_param_get},
+	{COMMAND_PARAM_SET, "ss", 1, run_param_set},
+	{COMMAND_SAVE, "", 0, run_save},
+	{COMMAND_LOAD, "", 0, run_load},
+};
+#define NCOMMANDS (sizeof(commands)/sizeof(commands[0]))
+
+static unsigned char payload[COMMAND_MAX_PAYLOAD + 1];	// one more for the checksum
+static unsigned char reply[MAX_REPLY];
+static unsigned int reply_length = 0;
+static enum CommandOpcode opcode;	// the command being run
+static int serving = 0;		// set while command_serve() sends a stream
+static unsigned int stream_sent = 0;	// the samples sent by stream_poll()
+
+/// @brief Parses the payload into arguments of the declared types
+/// @return 1 if the payload holds exactly those arguments
+static int args_parse(const char * types, unsigned int length, union CommandArg * args);
+
+/// @brief Adds an int to the reply
+static void reply_int(int value);
+
+/// @brief Adds text to the reply, without its terminating 0
+static void reply_text(const char * text);
+
+/// @brief Sends a reply to the command being run with the given payload
+static void reply_send(int status, const unsigned char * data, unsigned int length);
+
+/// @brief Sends a frame
+static void frame_send(int op, int status, const unsigned char * data, unsigned int length);
+
+/// @brief Sends the streamed samples, once streaming_begin() has been called and the loops
+///	   started, and puts the number sent and the number of overflows in the reply
+static void reply_stream(void);
+
+/// @brief Sends the samples recorded so far in a COMMAND_SAMPLES frame, for command_serve()
+/// @return an enum StreamPoll
+static int stream_poll(void);
+
+/// @brief Finishes a command that appends to the motion queue
+/// @param queued 1 if the segment was queued, which the reply then follows with the queue depth
+/// @return an enum CommandStatus
+static int queue_reply(int queued);
+
+/// @brief Writes bytes to the serial port, adding them to a checksum
+static void write_sum(const unsigned char * data, unsigned int length, unsigned char * sum);
+
+void command_frame(void)
+{
+	unsigned char header[3], sum = 0;
+	unsigned int i = 0;
+	NU32_ReadBytesUART1((char *)header,3);
+	unsigned int length = header[1] | (header[2] << 8);
+	opcode = header[0];
+	trace_record(TRACE_COMMAND,COMMAND_SYNC,opcode);
+
+	if (length > COMMAND_MAX_PAYLOAD)
+	{
+		// read the payload and the checksum anyway, so the next frame is found
+		for (i = 0; i != length + 1; ++i)
+		{
+			NU32_ReadBytesUART1((char *)payload,1);
+		}
+		reply_send(COMMAND_BAD_FRAME,0,0);
+		return;
+	}
+	NU32_ReadBytesUART1((char *)payload,length + 1);
+	for (i = 0; i != 3; ++i)
+	{
+		sum += header[i];
+	}
+	for (i = 0; i != length + 1; ++i)
+	{
+		sum += payload[i];
+	}
+	if (sum != 0)
+	{
+		reply_send(COMMAND_BAD_FRAME,0,0);
+		return;
+	}
+
+	const struct Command * command = 0;
+	for (i = 0; i != NCOMMANDS && !command; ++i)
+	{
+		command = commands[i].opcode == opcode ? &commands[i] : 0;
+	}
+	union CommandArg args[MAX_ARGS];
+	if (!command)
+	{
+		reply_send(COMMAND_UNKNOWN,0,0);
+		return;
+	}
+	if (serving && !command->concurrent)
+	{
+		reply_send(COMMAND_BUSY,0,0);
+		return;
+	}
+	if (!args_parse(command->args,length,args))
+	{
+		reply_send(COMMAND_INVALID,0,0);
+		return;
+	}
+
+	reply_length = 0;
+	int status = command->run(args);
+	reply_send(status,reply,status == COMMAND_OK ? reply_length : 0);
+}
+
+void command_serve(int (*poll)(void))
+{
+	enum CommandOpcode streaming = opcode; // a frame run meanwhile changes it
+	int progress = STREAM_SENT, received = 0;
+	char c = 0;
+	serving = 1;
+	while (progress != STREAM_DONE)
+	{
+		progress = poll();
+		if (progress == STREAM_WAITING)
+		{
+			// waiting for samples counts as idle time, as waiting for the serial port does, up
+			// to the sample or byte that ends it, so sending the sample is not counted
+			load_idle_begin();
+			while (streaming_available() == 0 && streaming_remaining() != 0
+				&& !(received = NU32_PollUART1(&c)))
+			{
+				;
+			}
+			load_idle_end();
+		}
+		else
+		{
+			received = NU32_PollUART1(&c);
+		}
+		if (received && c == (char)COMMAND_SYNC)
+		{
+			command_frame();
+		}
+	}
+	serving = 0;
+	opcode = streaming;
+}
+
+static int args_parse(const char * types, unsigned int length, union CommandArg * args)
+{
+	unsigned int pos = 0;
+	for (; *types; ++types, ++args)
+	{
+		switch (*types)
+		{
+			case 'i':
+			{
+				if (length - pos < 4)
+				{
+					return 0;
+				}
+				args->i = (int)(payload[pos] | (payload[pos + 1] << 8) | (payload[pos + 2] << 16)
+					| ((unsigned int)payload[pos + 3] << 24));
+				pos += 4;
+				break;
+			}
+			case 's':
+			{
+				unsigned int end = pos;
+				while (end != length && payload[end] != 0)
+				{
+					++end;
+				}
+				if (end == length)
+				{
+					return 0;
+				}
+				args->s = (const char *)payload + pos;
+				pos = end + 1;
+				break;
+			}
+			case 'a':
+			{
+				if (length - pos < 2)
+				{
+					return 0;
+				}
+				args->a.n = payload[pos] | (payload[pos + 1] << 8);
+				args->a.data = payload + pos + 2;
+				if (length - pos - 2 < 2*(unsigned int)args->a.n)
+				{
+					return 0;
+				}
+				pos += 2 + 2*args->a.n;
+				break;
+			}
+			default:
+			{
+				return 0;
+			}
+		}
+	}
+	return pos == length;
+}
+
+static void reply_int(int value)
+{
+	if (reply_length + 4 <= MAX_REPLY)
+	{
+		reply[reply_length++] = value;
+		reply[reply_length++] = value >> 8;
+		reply[reply_length++] = value >> 16;
+		reply[reply_length++] = value >> 24;
+	}
+}
+
+static void reply_text(const char * text)
+{
+	while (*text && reply_length != MAX_REPLY)
+	{
+		reply[reply_length++] = *text++;
+	}
+}
+
+static void reply_send(int status, const unsigned char * data, unsigned int length)
+{
+	frame_send(opcode,status,data,length);
+}
+
+static void frame_send(int op, int status, const unsigned char * data, unsigned int length)
+{
+	unsigned char header[5] = {COMMAND_SYNC, op, status, length, length >> 8}, sum = 0;
+	NU32_WriteBytesUART1((const char *)header,1);
+	write_sum(header + 1,4,&sum);
+	write_sum(data,length,&sum);
+	sum = -sum;
+	NU32_WriteBytesUART1((const char *)&sum,1);
+}
+
+static void reply_stream(void)
+{
+	stream_sent = 0;
+	command_serve(stream_poll);
+	reply_length = 0; // the frames served meanwhile used the reply for theirs
+	reply_int(stream_sent);
+	reply_int(streaming_end());
+}
+
+static int stream_poll(void)
+{
+	unsigned char samples[FRAME_SAMPLES*SAMPLE_BYTES];
+	unsigned int n = streaming_available(), i = 0, j = 0;
+	if (streaming_remaining() == 0)
+	{
+		return STREAM_DONE;
+	}
+	if (n == 0)
+	{
+		return STREAM_WAITING;
+	}
+	if (n > FRAME_SAMPLES)
+	{
+		n = FRAME_SAMPLES;
+	}
+	for (i = 0; i != n; ++i)
+	{
+		int values[3];
+		streaming_read(&values[0],&values[1],&values[2]);
+		for (j = 0; j != 3; ++j)
+		{
+			samples[SAMPLE_BYTES*i + 4*j] = values[j];
+			samples[SAMPLE_BYTES*i + 4*j + 1] = values[j] >> 8;
+			samples[SAMPLE_BYTES*i + 4*j + 2] = values[j] >> 16;
+			samples[SAMPLE_BYTES*i + 4*j + 3] = values[j] >> 24;
+		}
+	}
+	frame_send(COMMAND_SAMPLES,COMMAND_OK,samples,n*SAMPLE_BYTES);
+	stream_sent += n;
+	return STREAM_SENT;
+}
+
+static void write_sum(const unsigned char * data, unsigned int length, unsigned char * sum)
+{
+	unsigned int i = 0;
+	for (i = 0; i != length; ++i)
+	{
+		*sum += data[i];
+	}
+	if (length)
+	{
+		NU32_WriteBytesUART1((const char *)data,length);
+	}
+}
+
+static int run_state(const union CommandArg * args)
+{
+	reply_int(core_state);
+	return COMMAND_OK;
+}
+
+static int run_angle(const union CommandArg * args)
+{
+	reply_int(motion_angle());
+	return COMMAND_OK;
+}
+
+static int run_encoder(const union CommandArg * args)
+{
+	reply_int(core_encoder_read());
+	return COMMAND_OK;
+}
+
+static int run_encoder_reset(const union CommandArg * args)
+{
+	core_encoder_reset();
+	return COMMAND_OK;
+}
+
+static int run_adc(const union CommandArg * args)
+{
+	reply_int(core_adc_read());
+	return COMMAND_OK;
+}
+
+static int run_amps(const union CommandArg * args)
+{
+	reply_int(current_amps_get());
+	return COMMAND_OK;
+}
+
+static int run_pwm(const union CommandArg * args)
+{
+	if (args[0].i < -100 || args[0].i > 100)
+	{
+		return COMMAND_INVALID;
+	}
+	current_pwm_set(args[0].i);
+	core_state = PWM;
+	return COMMAND_OK;
+}
+
+static int run_stop(const union CommandArg * args)
+{
+	core_state = IDLE;
+	streaming_stop(); // the loops record no more samples
+	return COMMAND_OK;
+}
+
+static int run_tune(const union CommandArg * args)
+{
+	if (args[0].i < 0 || args[0].i > MAX_STREAM)
+	{
+		return COMMAND_INVALID;
+	}
+	core_state = IDLE;
+	streaming_begin(args[0].i);
+	core_state = TUNE;
+	reply_stream();
+	core_state = IDLE;
+	return COMMAND_OK;
+}
+
+static int run_trajectory(const union CommandArg * args)
+{
+	int i = 0, n = args[0].a.n;
+	const unsigned char * data = args[0].a.data;
+	if (motion_trajectory_queued())
+	{
+		return COMMAND_FAILED;
+	}
+	if (n < 1 || !motion_trajectory_set(0,n - 1))
+	{
+		return COMMAND_INVALID;
+	}
+	for (i = 0; i != n; ++i)
+	{
+		motion_trajectory_set((short)(data[2*i] | (data[2*i + 1] << 8)),i);
+	}
+	return COMMAND_OK;
+}
+
+static int run_execute(const union CommandArg * args)
+{
+	int length = motion_trajectory_length();
+	if (args[0].i < 0 || args[0].i > MAX_STREAM - length)
+	{
+		return COMMAND_INVALID;
+	}
+	if (length <= 0)
+	{
+		return COMMAND_FAILED;
+	}
+	motion_trajectory_reset(LAST,0);
+	streaming_begin(length + args[0].i);
+	core_state = TRACK;
+	reply_stream();
+	if (core_state == TRACK) // unless a frame stopped it meanwhile
+	{
+		core_state = HOLD;
+	}
+	return COMMAND_OK;
+}
+
+static int run_hold(const union CommandArg * args)
+{
+	if (args[0].i < 0 || args[0].i > MAX_STREAM)
+	{
+		return COMMAND_INVALID;
+	}
+	motion_trajectory_reset(NOW,0);
+	streaming_begin(args[0].i);
+	core_state = HOLD;
+	reply_stream();
+	return COMMAND_OK;
+}
+
+static int run_goto(const union CommandArg * args)
+{
+	if (args[1].i < 0 || args[1].i > MAX_STREAM)
+	{
+		return COMMAND_INVALID;
+	}
+	motion_trajectory_reset(ANGLE,args[0].i);
+	streaming_begin(args[1].i);
+	core_state = HOLD;
+	reply_stream();
+	return COMMAND_OK;
+}
+
+static int queue_reply(int queued)
+{
+	unsigned int depth = 0, underruns = 0, completed = 0;
+	if (!queued)
+	{
+		return COMMAND_FAILED;
+	}
+	motion_queue_status(&depth,&underruns,&completed);
+	reply_int(depth);
+	return COMMAND_OK;
+}
+
+static int run_queue_goto(const union CommandArg * args)
+{
+	if (args[0].i < -MOTION_MAX_ANGLE || args[0].i > MOTION_MAX_ANGLE || args[1].i < 1 || args[2].i < 1)
+	{
+		return COMMAND_INVALID;
+	}
+	return queue_reply(motion_queue_goto(args[0].i,args[1].i,args[2].i));
+}
+
+static int run_queue_dwell(const union CommandArg * args)
+{
+	if (args[0].i < 0)
+	{
+		return COMMAND_INVALID;
+	}
+	return queue_reply(motion_queue_dwell(args[0].i));
+}
+
+static int run_queue_trajectory(const union CommandArg * args)
+{
+	return queue_reply(motion_queue_trajectory());
+}
+
+static int run_queue_hold(const union CommandArg * args)
+{
+	return queue_reply(motion_queue_hold());
+}
+
+static int run_queue_pvt(const union CommandArg * args)
+{
+	if (args[0].i < -1000*MOTION_MAX_ANGLE || args[0].i > 1000*MOTION_MAX_ANGLE
+		|| args[1].i < -MOTION_MAX_PVT_SPEED || args[1].i > MOTION_MAX_PVT_SPEED || args[2].i < 0)
+	{
+		return COMMAND_INVALID;
+	}
+	return queue_reply(motion_queue_pvt(args[0].i,args[1].i,args[2].i));
+}
+
+static int run_queue_status(const union CommandArg * args)
+{
+	unsigned int depth = 0, underruns = 0, completed = 0;
+	motion_queue_status(&depth,&underruns,&completed);
+	reply_int(depth);
+	reply_int(underruns);
+	reply_int(completed);
+	return COMMAND_OK;
+}
+
+static int run_watch(const union CommandArg * args)
+{
+	if (args[0].i < 0 || args[0].i > MAX_STREAM)
+	{
+		return COMMAND_INVALID;
+	}
+	if (core_state != TRACK && core_state != HOLD && core_state != QUEUE)
+	{
+		return COMMAND_FAILED; // the motion loop records nothing
+	}
+	streaming_begin(args[0].i);
+	reply_stream();
+	return COMMAND_OK;
+}
+
+static int run_param_get(const union CommandArg * args)
+{
+	char buffer[100];
+	if (!param_sprintf(param_find(args[0].s),buffer))
+	{
+		return COMMAND_INVALID;
+	}
+	reply_text(buffer);
+	return COMMAND_OK;
+}
+
+static int run_param_set(const union CommandArg * args)
+{
+	return param_set(param_find(args[0].s),args[1].s) ? COMMAND_OK : COMMAND_INVALID;
+}
+
+static int run_save(const union CommandArg * args)
+{
+	core_gains_save();
+	return COMMAND_OK;
+}
+
+static int run_load(const union CommandArg * args)
+{
+	core_gains_load();
+	return COMMAND_OK;
+}
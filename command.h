@@ -0,0 +1,87 @@
+#ifndef COMMAND_H_
+#define COMMAND_H_
+/// @file command.h
+/// @brief Dispatches binary command frames through a table of opcodes.
+///	   A command and all of its arguments arrive in one frame and get one framed reply, so a
+///	   command that takes several round trips in the menu, such as 'm' 'g', takes one.
+///	   The menu stays available: menu_run() hands a frame over when its first byte is
+///	   COMMAND_SYNC, which no menu command starts with.
+///
+///	   A request is COMMAND_SYNC, the opcode, the length of the payload (2 bytes), the payload
+///	   and a checksum.  A reply is COMMAND_SYNC, the opcode, an enum CommandStatus, the length
+///	   of the payload (2 bytes), the payload and a checksum.  Numbers are little endian.  The
+///	   checksum makes the bytes after COMMAND_SYNC, the checksum included, sum to 0 modulo 256.
+///
+///	   The arguments of each command are declared in its table entry, and are sent in order:
+///	   'i' an int (4 bytes), 's' a string ending in a 0 byte, 'a' an array of shorts preceded by
+///	   their number (2 bytes).  Replies carry ints, or the text of a parameter.
+///
+///	   Commands that stream send the samples in COMMAND_SAMPLES frames as they are recorded,
+///	   r, s and u as ints for each sample, and reply once the stream is over with the number of
+///	   samples sent and the number of overflows.  Frames may be sent while a stream is in
+///	   progress, whether a frame or a menu command started it: their replies come between the
+///	   sample frames or lines, so the motor can be stopped, retuned and queried mid-run, and
+///	   the motion queue kept topped up while it is watched.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief The first byte of every frame
+#define COMMAND_SYNC 0xA5
+
+/// @brief The longest payload of a request
+#define COMMAND_MAX_PAYLOAD 2048
+
+/// @brief The opcodes, with the menu commands they stand for and their arguments -> reply
+enum CommandOpcode {
+		COMMAND_STATE = 0x01,		/// 'd' 'x': -> core_state
+		COMMAND_ANGLE = 0x02,		/// 'd' 'd': -> degrees
+		COMMAND_ENCODER = 0x03,		/// 'd' 'e': -> encoder count
+		COMMAND_ENCODER_RESET = 0x04,	/// 'd' 'r'
+		COMMAND_ADC = 0x05,		/// 'd' 'a': -> adc count
+		COMMAND_AMPS = 0x06,		/// 'd' 'i': -> mA
+		COMMAND_PWM = 0x07,		/// 'd' 'p': duty percent
+		COMMAND_STOP = 0x10,		/// 'm' 's' and 'i' 'c': go to IDLE
+		COMMAND_TUNE = 0x11,		/// 'i' 'r': samples -> stream
+		COMMAND_TRAJECTORY = 0x20,	/// 'm' 'l': angles
+		COMMAND_EXECUTE = 0x21,		/// 'm' 'x': extra samples -> stream
+		COMMAND_HOLD = 0x22,		/// 'm' 'h': samples -> stream
+		COMMAND_GOTO = 0x23,		/// 'm' 'g': angle, samples -> stream
+		COMMAND_QUEUE_GOTO = 0x24,	/// 'm' 'q' "g": angle, speed, accel -> queue depth
+		COMMAND_QUEUE_DWELL = 0x25,	/// 'm' 'q' "d": ms -> queue depth
+		COMMAND_QUEUE_TRAJECTORY = 0x26,	/// 'm' 'q' "t": -> queue depth
+		COMMAND_QUEUE_HOLD = 0x27,	/// 'm' 'q' "h": -> queue depth
+		COMMAND_QUEUE_STATUS = 0x28,	/// 'm' 'q': -> depth, underruns, completed
+		COMMAND_WATCH = 0x29,		/// samples -> stream of the motion loop, whatever it is doing
+		COMMAND_QUEUE_PVT = 0x2A,	/// 'm' 'q' "p": position, velocity, ms -> queue depth
+		COMMAND_PARAM_GET = 0x30,	/// 'p' 'g': name -> value as text
+		COMMAND_PARAM_SET = 0x31,	/// 'p' 's': name, value as text
+		COMMAND_SAVE = 0x40,		/// 's'
+		COMMAND_LOAD = 0x41,		/// 'l'
+		COMMAND_SAMPLES = 0x50		/// sent by the firmware: samples of a stream
+	       };
+
+/// @brief The outcome of a command, the third byte of its reply
+enum CommandStatus {
+		COMMAND_OK,		/// the command was carried out
+		COMMAND_UNKNOWN,	/// there is no such opcode
+		COMMAND_BAD_FRAME,	/// the checksum is wrong or the payload is too long
+		COMMAND_INVALID,	/// the arguments do not match the command or are out of range
+		COMMAND_FAILED,		/// the command cannot be carried out now, such as executing no trajectory
+		COMMAND_BUSY		/// the command cannot run while a stream is in progress
+	       };
+
+/// @brief Reads the rest of a frame whose COMMAND_SYNC byte has been read, runs the command
+///	   and sends its reply
+void command_frame(void);
+
+/// @brief Sends a stream to its end, carrying out the frames that arrive meanwhile.  Commands
+///	   that stream themselves, or change what the loops are doing other than stopping them or
+///	   appending to the motion queue, are answered COMMAND_BUSY.  Bytes outside a frame are
+///	   discarded.
+/// @param poll Sends the next piece of the stream without waiting, returns an enum StreamPoll.
+///	       STREAM_WAITING must mean that no sample is available, which command_serve() then
+///	       waits for as idle time.
+void command_serve(int (*poll)(void));
+
+#endif
@@ -1,5 +1,9 @@
 #include "NU32.h"
 #include "core.h"
+#include "param.h"
+#include "sched.h"
+#include "load.h"
+#include "trace.h"
 #include "dee_emulation_pic32.h" /// emulates an eeprom using program flash (thanks microchip!)
 
 #define AVERAGES 20	/// the number of averages we take when reading the ADC
@@ -17,6 +21,10 @@ static void adc_init(void);
 static void encoder_init(void);
 
 
+/// @brief Diagnostic task: toggles LED2 so a running scheduler can be seen at a glance
+static void heartbeat(void);
+
+
 /// @brief Communcicates with the encoder
 ///
 /// @param read - if 1 reads the current value, if 0 sends a reset command
@@ -25,8 +33,12 @@ static int encoder_send(int read);
 
 void core_init(void)
 {
+	trace_init();		//start recording events
 	DataEEInit();		//initialize eeprom emulation
 	core_state = IDLE;	//initialize the state
+	sched_init();		//start the timebase that the control loops run from
+	sched_register("heartbeat",heartbeat,SCHED_BASE_HZ/HEARTBEAT_HZ,HEARTBEAT_PHASE,SCHED_DEFERRED);
+	load_init();		//account for the cpu time
 	adc_init();     	//initialize the analog to digital converter
 	encoder_init(); 	//initialize the encoders
 };
@@ -60,6 +72,11 @@ int core_encoder_read(void)
 	return encoder_send(1);
 }
 
+static void heartbeat(void)
+{
+	NU32LED2 = !NU32LED2;
+}
+
 static void adc_init(void)
 {
 	// setup the analog to digital converter
@@ -108,65 +125,12 @@ static int encoder_send(int read)
 	return temp;
 }
 
-#define MAX_REGISTERS 10
-static int * registered_ints[MAX_REGISTERS];
-static float * registered_floats[MAX_REGISTERS];
-static int nints = 0;
-static int nfloats = 0;
-
-void core_register_int(int * a)
-{
-	if(a && nints < MAX_REGISTERS)
-	{
-		registered_ints[nints] = a;
-		++nints;
-	}
-}
-
-void core_register_float(float * a)
-{
-	if (a && nfloats < MAX_REGISTERS)
-	{
-		registered_floats[nfloats] = a;
-		++nfloats;
-	}
-}
-
 void core_gains_save()
 {
-	INTDisableInterrupts();
-	DataEEWrite(0xDEAD,0);
-	
-	int i = 0;
-	for(i = 0; i != nints; ++i)
-	{
-		DataEEWrite(*registered_ints[i],i+1);
-	}
-
-	for(i = 0; i != nfloats; ++i)
-	{
-		DataEEWrite(*((unsigned int*)registered_floats[i]),i+1+nints);
-	}
-	INTEnableInterrupts();
+	param_save();
 }
 
 void core_gains_load()
 {
-	INTDisableInterrupts();
-	unsigned int data = 0;
-	DataEERead(&data,0);
-	if(data == 0xDEAD) //we have written to flash before
-	{
-		int i = 0;
-		for(i = 0; i != nints; ++i)
-		{
-			DataEERead((unsigned int *)registered_ints[i],i+1);
-		}
-
-		for(i = 0; i != nfloats; ++i)
-		{
-			DataEERead((unsigned int*)registered_floats[i],i+1+nints);
-		}
-	}
-	INTEnableInterrupts();
+	param_load();
 }
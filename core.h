@@ -7,7 +7,11 @@
 /// @date 2014-02-28
 
 
+#define HEARTBEAT_HZ 2		/// how often the heartbeat LED toggles
+#define HEARTBEAT_PHASE 12	/// keeps the heartbeat off the scheduler ticks that run the motion loop
+
 /// @brief Initializes the core module, including the ADC and SPI (for reading the encoder)
+///	   and the heartbeat task of the scheduler
 void core_init(void);
 
 
@@ -27,33 +31,12 @@ void core_encoder_reset(void);
 int core_encoder_read(void);
 
 
-/// @brief Call this function on your integer gains.
-///	   Say you have a gain int kp;
-///	   In your initialization code call core_register_int(&kp).  The value can now be saved to and loaded from flash
-///	   Details:
-///	   	Registers an integer for saving to flash
-///	   	This should be called during initialization.	
-///	   	Subsequently, core_load() and core_save() can be used to save
-///	   	and restore these values from flash memory.
-///	   	There is a maximum number of values that can be registered, subsequent values will not be saved
-/// @param a pointer to the variable to save
-void core_register_int(int * a);
-
-
-/// @brief Registers a float for saving to flash
-///	   Subsequently, core_load() and core_save() can be used to save
-///	   and restore these values from flash memory
-///	   There is a maximum number of values that can be registered, subsequent values will not be saved
-/// @param a pointer to the variable to save
-void core_register_float(float * a);
-
-
-/// @brief Saves all registered values to flash
-///	    values are registered using core_register_int and core_register_float
-///	    are written to the flash
+/// @brief Saves all registered parameters to flash
+///	    parameters are registered by name using param_register_int and param_register_float
+///	    (see param.h) and are written to the flash
 void core_gains_save();
 
-/// @brief loads all registered values from flash.
+/// @brief loads all registered parameters from flash.
 ///	   if no values were indeed saved, no changes occur
 void core_gains_load();
 
@@ -63,7 +46,8 @@ enum State {
 		PWM,		/// The motor PWM is directly controlled
 	    	TUNE, 		/// The current loop is being tuned
 		TRACK, 		/// The motor is tracking a trajectory
-		HOLD		/// The motor is holding its position
+		HOLD,		/// The motor is holding its position
+		QUEUE		/// The motor runs the segments of the motion queue
 	   };
 
 
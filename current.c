@@ -3,9 +3,22 @@
 #include "streaming.h"
 #include "NU32.h"
 #include "motion.h"
+#include "param.h"
+#include "setpoint.h"
+#include "sched.h"
+#include "trace.h"
+#include "metrics.h"
+#include "response.h"
+#include "excite.h"
+#include "relay.h"
+#include "gains.h"
 
 #define FULL_DUTY 1999
-#define WAVEFORM_SAMPS 50
+#define TUNE_AMPLITUDE 200	// the default tuning wave is a +/- 200 mA square wave...
+#define TUNE_PERIOD 50		// ...with a period of 50 ticks
+#define MAX_AMPS 2000		// the largest current reference, in mA
+#define MAX_GAIN 10000		// the largest kp and ki
+#define SETPOINT_TIMEOUT (3*motion_period()) // a setpoint older than 3 motion periods is stale, in core timer ticks
 
 /// @file current.c
 /// @brief Implements the inner current control loop
@@ -19,28 +32,60 @@
 // they can also be named kp and ki and there will be no issue
 // (thus these variables are global within the module, but not throughout the 
 // whole program)
-int currentref = 0;
 static int kp = 100, ki = 100, pwmref;
-static int waveform[WAVEFORM_SAMPS], waveformcount = 0;
+
+// The gains used by the ISR are double buffered (see gains.h). kp and ki above are the
+// working copies that the menu and the parameter registry edit, and
+// current_gains_commit() publishes them.
+struct Gains {
+	int kp, ki;
+};
+static volatile struct Gains gains[2] = {{100,100},{100,100}};
+static volatile unsigned int gains_seq = 0;	// the number of commits, gains_seq & 1 is the active set
+static struct GainsFollower follower = {0,100};	// the gains the ISR ran with on its last tick
+static struct Excitation excitation;		// the tuning wave the TUNE state tracks
 static int eint = 0, u = 0;
+static enum State last_state = IDLE;		// core_state on the last tick, to trace transitions
+static int u_saturated = 0, amps_saturated = 0;	// so only the start of a saturation is traced
+static struct Metrics metrics;			// the tracking metrics of the current run
+static int band = 20;				// the settling band of the metrics, in mA
+static int current_task = -1;			// the scheduler task that runs the current loop
+static struct Response response;		// the frequency response measurement
+static volatile int responding = 0;		// 1 if TUNE injects the sine of response instead of the square wave
+static struct Relay relay;			// the relay auto-tune experiment
+static volatile int tuning = 0;			// 1 if TUNE runs the relay instead of the PI controller
 
-/// @brief Setup Timer 1, which runs the current control loop
-/// @post  Timer 1 and its interrupt are enabled.  
-///        Its frequency is 5 kHz and its interrupt priority should be 7
+/// @brief The current control loop
+///	   Runs inside the priority 7 scheduler tick (see sched.h), once every tick
 ///// NOTE: static just means that this function is only visible within current.c
 ///	   code in other files cannot call this function
-static void timer1_init(void);
+static void current_control(void);
+
+/// @brief Publishes kp and ki to the ISR by flipping the gain buffers
+static void current_gains_commit(void);
+
+/// @brief Reads the setpoint that the motion loop has written to the mailbox
+/// @param ff [out] The feedforward term of the setpoint
+/// @return the current reference, in mA.  If the setpoint is stale, the reference and ff are 0.
+static int reference_get(int * ff);
 
 int set_u(int u);
 
-void makeWaveform();
-// TODO: this is setup for interrupt priority of 1.
-//       You will need to change this.
-//       Remember that interrupt priority 7 uses the shadow register set (SRS)
-void __ISR(_TIMER_1_VECTOR,IPL7SRS) Current_Control_Interrupt(void)
+static void current_control(void)
 {
 	//TODO: invert E0 so we can see when the interrupt is triggered
     LATEINV = 0x1;
+
+	// pick up gains committed since the last tick, keeping the integral term continuous
+	unsigned int seq = gains_seq;
+	const volatile struct Gains * g = &gains[seq & 1];
+	eint = gains_follow(&follower,seq,g->ki,eint);
+
+	if (core_state != last_state)
+	{
+		trace_record(TRACE_STATE,last_state,core_state);
+		last_state = core_state;
+	}
 	//the switch stament examines the core_state.
 	//it then jumps to the appropriate case (so if core_state = PWM,
 	//the switch statement will jump to the PWM case.)
@@ -105,12 +150,24 @@ void __ISR(_TIMER_1_VECTOR,IPL7SRS) Current_Control_Interrupt(void)
 
 			// in tune mode you are tracking a -200mA to 200mA square wave at 100 Hz.
             //streaming_record( , , control effort);
-            r = waveform[waveformcount];
+            if (responding) {
+                r = response_reference(&response);
+            }
+            else {
+                r = excite_next(&excitation);
+            }
             s = current_amps_get();
+            if (responding) {
+                response_update(&response,s);
+            }
             e = r-s;
             eint = e+eint;
-            u = (kp*e + ki*eint)/100;
+            u = (g->kp*e + g->ki*eint)/100;
+            if (tuning) {
+                u = relay_step(&relay,s);
+            }
             newu = set_u(u);
+            metrics_update(&metrics,r,s,newu != u);
             
             if (newu > 0) {
                 OC1RS = FULL_DUTY;
@@ -126,24 +183,19 @@ void __ISR(_TIMER_1_VECTOR,IPL7SRS) Current_Control_Interrupt(void)
             }
 
             streaming_record(r,s,u);
-            
-            if (waveformcount < WAVEFORM_SAMPS) {
-                waveformcount = waveformcount + 1;
-            }
-            if (waveformcount == WAVEFORM_SAMPS) {
-                waveformcount = 0;
-            }
             break;
 		}
+		case QUEUE: // the motion loop sets the current as it does in TRACK
 		case TRACK:
 		{
-            int r, s, e, newu;
-            r = currentref;
+            int r, s, e, newu, ff;
+            r = reference_get(&ff);
             s = current_amps_get();
             e = r-s;
             eint = eint + e;
-            u = (kp*e + ki*eint)/100;
+            u = (g->kp*e + g->ki*eint)/100 + ff;
             newu = set_u(u);
+            metrics_update(&metrics,r,s,newu != u);
             
             if (newu > 0) {
                 OC1RS = FULL_DUTY;
@@ -167,13 +219,14 @@ void __ISR(_TIMER_1_VECTOR,IPL7SRS) Current_Control_Interrupt(void)
 		}
 		case HOLD:
 		{
-            int r, s, e, newu;
-            r = currentref;
+            int r, s, e, newu, ff;
+            r = reference_get(&ff);
             s = current_amps_get();
             e = r-s;
             eint = eint + e;
-            u = (kp*e + ki*eint)/100;
+            u = (g->kp*e + g->ki*eint)/100 + ff;
             newu = set_u(u);
+            metrics_update(&metrics,r,s,newu != u);
 
             if (newu > 0) {
                 OC1RS = FULL_DUTY;
@@ -201,16 +254,12 @@ void __ISR(_TIMER_1_VECTOR,IPL7SRS) Current_Control_Interrupt(void)
 			break;
 		}
 	}
-
-	IFS0bits.T1IF = 0; // clear the interrupt flag
 }
 
 void current_init(void)
 {
-	//TODO: Uh Oh, somebody made the timer run too fast and at the
-	//wrong priority.  FIXME
-	// setup the current loop timer for for 5 kHz operation
-	timer1_init();
+	// the current loop runs on every tick of the scheduler, at priority 7
+	current_task = sched_register("current",current_control,1,0,SCHED_TICK);
 	//TODO: setup the appropriate output compare pins and a timer for
 	// 20 kHz PWM operation
     
@@ -230,7 +279,7 @@ void current_init(void)
     T3CONbits.ON = 1; // Turn on timer 3
     OC2CONbits.ON = 1; // Turn on output compare 2
 	
-    makeWaveform();
+    excite_set(&excitation,EXCITE_SQUARE,TUNE_AMPLITUDE,0,TUNE_PERIOD);
     //TODO: setup pin e0 for digital I/O. this is just so that we can
 	//verify the control loop frequency on the nscope.
     TRISEbits.TRISE0 = 0;
@@ -238,9 +287,11 @@ void current_init(void)
 	//NOTE: due to a bug in the nscope firmware, the frequency displayed
 	//	may not exactly match what you specify here, but it should be close
 
-	//We register the gains. This allows core.c to handle saving them
-	core_register_int(&kp);
-	core_register_int(&ki);
+	//We register the gains by name. This allows them to be set from the menu
+	//and saved to flash without knowing the order current_gains_sprintf uses
+	param_notify(param_register_int("i.kp",&kp,0,MAX_GAIN),current_gains_commit);
+	param_notify(param_register_int("i.ki",&ki,0,MAX_GAIN),current_gains_commit);
+	param_register_int("i.band",&band,0,2000);
 }
 
 
@@ -255,20 +306,102 @@ void current_pwm_set(int duty_percent)
     pwmref = (duty_percent/100.00)*FULL_DUTY;
 }
 
+unsigned int current_period(void)
+{
+	return sched_period(current_task);
+}
+
+void current_metrics_begin(unsigned int nsamples)
+{
+	metrics_begin(&metrics,nsamples,band);
+}
+
+int current_metrics_done(void)
+{
+	return metrics_done(&metrics);
+}
+
+void current_metrics_sprintf(char * buffer)
+{
+	metrics_sprintf(&metrics,current_period(),buffer);
+}
+
+float current_response_begin(float hz, int amplitude, unsigned int cycles)
+{
+	float actual = response_begin(&response,hz,current_period(),amplitude,cycles);
+	responding = 1;
+	return actual;
+}
+
+int current_response_done(void)
+{
+	return response_done(&response);
+}
+
+void current_response_result(float * gain, float * phase)
+{
+	response_result(&response,gain,phase);
+}
+
+void current_response_stop(void)
+{
+	responding = 0;
+}
+
+void current_autotune_begin(int amplitude, int hysteresis, unsigned int cycles)
+{
+	relay_begin(&relay,0,amplitude,hysteresis,cycles);
+	tuning = 1;
+}
+
+int current_autotune_done(void)
+{
+	return relay_done(&relay);
+}
+
+int current_autotune_finish(char * buffer)
+{
+	float ku = 0, tu = 0;
+	tuning = 0;
+	if (!relay_result(&relay,&ku,&tu))
+	{
+		return 0;
+	}
+
+	// Ziegler-Nichols PI: Kp = 0.45 Ku, Ti = Tu/1.2.  The controller is
+	// u = (kp*e + ki*sum(e))/100, so ki is Kp/Ti per tick.
+	float newkp = 0.45f*ku, newki = newkp*1.2f/tu;
+	kp = (int)(100*newkp + 0.5f);
+	ki = (int)(100*newki + 0.5f);
+	kp = kp > MAX_GAIN ? MAX_GAIN : kp;
+	ki = ki > MAX_GAIN ? MAX_GAIN : ki;
+	current_gains_commit();
+	sprintf(buffer,"%f %u %d %d",ku,(unsigned int)(tu*current_period()/40),kp,ki);
+	return 1;
+}
+
 void current_amps_set(int amps)
+{
+    current_reference_set(amps,0);
+}
+
+void current_reference_set(int amps, int voltage)
 {
     //TODO:
     // set the amp reference
 	// saturate at +/- 2000 mA
+    int requested = amps;
     if (amps > 2000) {
-        currentref = 2000;
+        amps = 2000;
     }
     else if (amps < -2000) {
-        currentref = -2000;
+        amps = -2000;
     }
-    else {
-        currentref = amps;
+    if (amps != requested && !amps_saturated) {
+        trace_record(TRACE_CURRENT_SAT,requested,amps);
     }
+    amps_saturated = amps != requested;
+    setpoint_write(amps,voltage);
 }
 
 short current_amps_get()
@@ -291,41 +424,68 @@ void current_gains_sprintf(char * buffer)
     sprintf(buffer,"%d %d",kp,ki);
 }
 
-void current_gains_sscanf(const char * buffer)
+int current_gains_sscanf(const char * buffer)
 {
 	//TODO: buffer will contain the gains as two numbers separated by 
 	// a space.  scanf them from buffer and store the gains in
 	// kp and ki
-    sscanf(buffer,"%d %d",&kp,&ki);
+	int newkp = 0, newki = 0;
+	// the same bounds as the i.kp and i.ki parameters
+	if (sscanf(buffer,"%d %d",&newkp,&newki) != 2 || newkp < 0 || newkp > MAX_GAIN
+		|| newki < 0 || newki > MAX_GAIN)
+	{
+		return 0;
+	}
+	kp = newkp;
+	ki = newki;
+	current_gains_commit();
+	return 1;
 }
 
-void makeWaveform() {
-    
-    int i, max = 200, min = -200;
-    for (i = 0; i < WAVEFORM_SAMPS; i++) {
-        if (i < WAVEFORM_SAMPS/2) {
-            waveform[i] = min;
-        }
-        else {
-            waveform[i] = max;
-        }
-    }
+void current_excite_sprintf(char * buffer)
+{
+	sprintf(buffer,"%s %d %d %u",excite_name(excitation.type),excitation.amplitude,
+		excitation.offset,excitation.period);
 }
 
-static void timer1_init(void)
+int current_excite_sscanf(const char * buffer)
 {
-	// setup timer 1
-	// TODO: Make the timer run at 5kHz
-	// whoever coded this is fired!
-	T1CONbits.TCS = 0;    	  
-	T1CONbits.TCKPS = 0b01;
-	PR1 = 1999;
-	TMR1 = 0;   	  
-	IPC1bits.T1IP = 7;
-	IPC1bits.T1IS = 0;
-	IFS0bits.T1IF = 0;
-	IEC0bits.T1IE = 1;
-	T1CONbits.ON  = 1;
+	char name[20];
+	int amplitude = 0, offset = 0;
+	unsigned int period = 0;
+	if (sscanf(buffer,"%19s %d %d %u",name,&amplitude,&offset,&period) != 4)
+	{
+		return 0;
+	}
+
+	enum ExciteType type = excite_find(name);
+	int peak = (offset < 0 ? -offset : offset) + amplitude;
+	if (type == EXCITE_TYPES || amplitude < 0 || peak > MAX_AMPS || period < 2)
+	{
+		return 0;
+	}
+	excite_set(&excitation,type,amplitude,offset,period);
+	return 1;
+}
+
+static void current_gains_commit(void)
+{
+	unsigned int next = gains_seq + 1;
+	gains[next & 1].kp = kp;
+	gains[next & 1].ki = ki;
+	gains_seq = next;
+}
+
+static int reference_get(int * ff)
+{
+	struct Setpoint sp;
+	if (setpoint_read(&sp) > SETPOINT_TIMEOUT)
+	{
+		*ff = 0;	// the motion loop has stopped updating the reference, so don't act on it
+		return 0;
+	}
+	*ff = sp.voltage;
+	return sp.current;
 }
 
 int set_u(int uvalue) {
@@ -340,5 +500,9 @@ int set_u(int uvalue) {
     else {
         newu = uvalue;
     }
+    if (newu != uvalue && !u_saturated) {
+        trace_record(TRACE_VOLTAGE_SAT,uvalue,newu);
+    }
+    u_saturated = newu != uvalue;
     return newu;
 }
\ No newline at end of file
@@ -7,7 +7,6 @@
 /// @date 2014-03-01
 /// Implements the PI current controller.  Also allows for directly setting PWM values.
 #define FULL_DUTY 1999
-int currentref;
 /// @brief Initializes the current.c module and the peripherals it uses
 void current_init(void);
 
@@ -23,8 +22,85 @@ void current_pwm_set(int duty_percent);
 ///	   This function will set the current amps reference, subject to a saturation condition.
 ///	   Saturate the current at +/- 2000 mA so we do not command too much current
 ///   	   This function will not change core_state
+///	   Only the motion control ISR may call this: it writes the setpoint mailbox (see setpoint.h)
 void current_amps_set(int amps);
 
+/// @brief Specifies the current reference, in mA, along with a feedforward term
+///	   The feedforward term is added to the output of the current controller.
+///	   Like current_amps_set, only the motion control ISR may call this.
+/// @param amps    The current reference, saturated at +/- 2000 mA
+/// @param voltage The feedforward term, in control effort units (+/- 2000 is full duty)
+/// @post  If the reference is not refreshed for 3 motion control periods, the current loop treats it as 0
+void current_reference_set(int amps, int voltage);
+
+/// @brief Get the period of the current control loop
+/// @return the period of the current control loop, in core timer ticks
+unsigned int current_period(void);
+
+/// @brief Starts recording the tracking metrics of the current loop (see metrics.h)
+///	   The current loop records a tick in the TUNE, TRACK, HOLD and QUEUE states.
+/// @param nsamples The number of ticks to record
+void current_metrics_begin(unsigned int nsamples);
+
+/// @brief Checks whether the current loop has recorded all the ticks of its metrics run
+/// @return 1 if the run is over
+int current_metrics_done(void);
+
+/// @brief Writes the tracking metrics of the current loop to the buffer, in mA
+/// @param buffer [out] "samples rms max_error iae overshoot settling_us saturated_us"
+/// @pre   The buffer has a minimum length of 100 characters
+void current_metrics_sprintf(char * buffer);
+
+/// @brief Writes the tuning wave that the TUNE state tracks to the buffer
+/// @param buffer [out] "type amplitude offset period", where type is the name of an excitation
+///		  (see excite.h), the amplitude and offset are in mA and the period is in ticks
+/// @pre   The buffer has a minimum length of 100 characters
+void current_excite_sprintf(char * buffer);
+
+/// @brief Sets the tuning wave that the TUNE state tracks
+/// @param buffer "type amplitude offset period", as written by current_excite_sprintf
+/// @return 1 on success, 0 if the buffer cannot be parsed or the wave would exceed +/- 2000 mA
+/// @post  On success the wave starts again from its beginning.  On failure it is unchanged.
+int current_excite_sscanf(const char * buffer);
+
+/// @brief Starts a relay auto-tune of the current loop (see relay.h)
+///	   From now on the TUNE state drives the motor with a relay about 0 mA instead of the PI controller.
+/// @param amplitude  The output of the relay, in control effort units (+/- 2000 is full duty)
+/// @param hysteresis The hysteresis of the relay, in mA
+/// @param cycles     The number of limit cycles to measure
+void current_autotune_begin(int amplitude, int hysteresis, unsigned int cycles);
+
+/// @brief Checks whether the relay experiment is over
+/// @return 1 if it is over
+int current_autotune_done(void);
+
+/// @brief Ends the relay experiment and, if it produced a limit cycle, sets kp and ki from
+///	   the ultimate gain and period with the Ziegler-Nichols PI rule
+/// @param buffer [out] "ku tu_us kp ki"
+/// @pre   The buffer has a minimum length of 100 characters
+/// @return 1 if the gains were set, 0 if no limit cycle was measured
+int current_autotune_finish(char * buffer);
+
+/// @brief Starts measuring the frequency response of the current loop at one frequency (see response.h)
+///	   From now on the TUNE state tracks a sine about 0 mA instead of the square wave.
+/// @param hz        The frequency, in Hz
+/// @param amplitude The amplitude of the sine, in mA
+/// @param cycles    The number of periods to measure
+/// @return the frequency actually used, in Hz
+float current_response_begin(float hz, int amplitude, unsigned int cycles);
+
+/// @brief Checks whether the frequency response measurement is over
+/// @return 1 if it is over
+int current_response_done(void);
+
+/// @brief Get the result of the frequency response measurement
+/// @param gain  [out] The measured current over the reference
+/// @param phase [out] The phase of the measured current relative to the reference, in degrees
+void current_response_result(float * gain, float * phase);
+
+/// @brief Makes the TUNE state track the square wave again
+void current_response_stop(void);
+
 /// @brief Reads the current from the ADC, in mA
 /// @return The motor current, in mA.
 short current_amps_get();
@@ -41,5 +117,8 @@ void current_gains_sprintf(char * buffer);
 //
 /// @param buffer String containing the kp and ki gains as two integers separated by a ' ' (space )
 /// @post  	  The kp and ki gains will be set according to the values read from the buffer.
-void current_gains_sscanf(const char * buffer);
+///		  The controller may keep running: the new gains take effect together at its next tick.
+/// @return 1 on success, 0 if the buffer does not hold two gains within the bounds of i.kp and
+///	    i.ki, in which case the gains are unchanged
+int current_gains_sscanf(const char * buffer);
 #endif
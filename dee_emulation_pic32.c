@@ -36,6 +36,15 @@
  **********************************************************************/
 #include "dee_emulation_pic32.h"
 #include <plib.h>
+#include "trace.h"
+
+// Packs the page and records the status and the time the CPU stalled for, in us, in the trace
+static void TracePackEE(void)
+{
+    unsigned int start = _CP0_GET_COUNT(); // the core timer runs at 40 MHz
+    unsigned int status = PackEE();
+    trace_record(TRACE_FLASH_PACK, status, (_CP0_GET_COUNT() - start)/40);
+}
 
 //For the DEE emulation operation 3 Pages should be allocated in the program memory.
 const unsigned int eedata_addr[NUM_DATA_EE_PAGES][NUMBER_OF_INSTRUCTIONS_IN_PAGE] __attribute__ ((aligned(4096)))={0};
@@ -384,7 +393,7 @@ unsigned int DataEEInit(void)
 
         if(GetNextAvailCount()==0xFFFF)//Page full
         {
-            PackEE();
+            TracePackEE();
         }
         return(0);
     }
@@ -562,7 +571,7 @@ unsigned int DataEEWrite(unsigned int data, unsigned int addr)
         }
         else if (((addrIndex + 4) == DATA_OFFSET)&&(activePage == 2))// both active pages are full then pack the page.
         {
-            PackEE();
+            TracePackEE();
         }
     }
     return(0);
@@ -0,0 +1,180 @@
+#include <math.h>
+#include "NU32.h"
+#include "excite.h"
+
+/// @file excite.c
+/// @brief Implements the excitation signals
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define SINE_BITS 8			// the lookup table has 2^SINE_BITS entries per turn
+#define SINE_SIZE (1 << SINE_BITS)
+#define PRBS_TAP 7			// x^10 + x^7 + 1 is a maximum length feedback polynomial
+#define PI 3.14159265f
+
+static short sine_table[SINE_SIZE];	// one turn of a sine, Q15
+static int table_ready = 0;
+
+static const char * names[EXCITE_TYPES] = {"square", "sine", "chirp", "prbs", "multisine"};
+
+// Schroeder phases -pi*k*(k-1)/MULTISINE_N of harmonics 1 to MULTISINE_N, as a fraction of a turn
+// times 2^32, which keep the peak of the sum low
+static unsigned int schroeder[MULTISINE_N];
+static int multisine_peak = 1;		// the largest magnitude of the multisine sum at any phase
+
+/// @brief Fills the sine table and the multisine phases, and finds the peak of the multisine
+static void tables_init(void);
+
+/// @brief Get the multisine sum of harmonics at a phase of the fundamental, Q15 per harmonic
+static int multisine(unsigned int phase);
+
+int excite_sine(unsigned int phase)
+{
+	if (!table_ready)
+	{
+		tables_init();
+	}
+	return sine_table[phase >> (32 - SINE_BITS)];
+}
+
+void excite_set(struct Excitation * x, enum ExciteType type, int amplitude, int offset, unsigned int period)
+{
+	if (!table_ready)
+	{
+		tables_init();
+	}
+	if (period < 2)
+	{
+		period = 2;
+	}
+
+	int scale = type == EXCITE_MULTISINE ? (int)(32767LL*32767/multisine_peak) : 32767;
+
+	unsigned int status = INTDisableInterrupts();
+	x->type = type;
+	x->amplitude = amplitude;
+	x->offset = offset;
+	x->period = period;
+	x->phase = 0;
+	x->step = 0xFFFFFFFFu/period + 1;
+	x->step0 = x->step;
+	x->dstep = ((1u << 30) > x->step0 ? (1u << 30) - x->step0 : 0)/period;
+	x->tick = 0;
+	x->lfsr = 1;
+	x->scale = scale;
+	INTRestoreInterrupts(status);
+}
+
+int excite_next(struct Excitation * x)
+{
+	int v = 0;
+	switch (x->type)
+	{
+		case EXCITE_SQUARE:
+		{
+			v = x->phase < 0x80000000u ? -x->amplitude : x->amplitude;
+			x->phase += x->step;
+			break;
+		}
+		case EXCITE_SINE:
+		{
+			v = (x->amplitude*excite_sine(x->phase)) >> 15;
+			x->phase += x->step;
+			break;
+		}
+		case EXCITE_CHIRP:
+		{
+			v = (x->amplitude*excite_sine(x->phase)) >> 15;
+			x->phase += x->step;
+			x->step += x->dstep;
+			if (++x->tick == x->period)
+			{
+				x->tick = 0;
+				x->phase = 0;
+				x->step = x->step0;
+			}
+			break;
+		}
+		case EXCITE_PRBS:
+		{
+			v = (x->lfsr & 1) ? x->amplitude : -x->amplitude;
+			if (++x->tick == x->period)
+			{
+				unsigned int bit = ((x->lfsr >> (PRBS_BITS - 1)) ^ (x->lfsr >> (PRBS_TAP - 1))) & 1;
+				x->lfsr = ((x->lfsr << 1) | bit) & ((1u << PRBS_BITS) - 1);
+				x->tick = 0;
+			}
+			break;
+		}
+		case EXCITE_MULTISINE:
+		{
+			v = (int)(((long long)x->amplitude*((multisine(x->phase)*(long long)x->scale) >> 15)) >> 15);
+			x->phase += x->step;
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+	return x->offset + v;
+}
+
+const char * excite_name(enum ExciteType type)
+{
+	return type >= 0 && type < EXCITE_TYPES ? names[type] : 0;
+}
+
+enum ExciteType excite_find(const char * name)
+{
+	int i = 0;
+	for (i = 0; i != EXCITE_TYPES && strcmp(names[i],name) != 0; ++i)
+	{
+		;
+	}
+	return i;
+}
+
+static void tables_init(void)
+{
+	int i = 0;
+	for (i = 0; i != SINE_SIZE; ++i)
+	{
+		sine_table[i] = (short)(32767*sinf(2*PI*i/SINE_SIZE));
+	}
+	for (i = 0; i != MULTISINE_N; ++i)
+	{
+		int k = i + 1;
+		schroeder[i] = -(unsigned int)(((unsigned long long)(k*(k - 1)) << 31)/MULTISINE_N);
+	}
+
+	// The sum only changes at the phases where the table index of a harmonic does, so its peak
+	// over every phase the accumulator can reach is its peak over those edges.  Harmonic k
+	// crosses an entry when k*phase + schroeder reaches a multiple of the entry width.
+	multisine_peak = multisine(0);
+	multisine_peak = multisine_peak < 0 ? -multisine_peak : multisine_peak;
+	multisine_peak = multisine_peak ? multisine_peak : 1;
+	for (i = 0; i != MULTISINE_N; ++i)
+	{
+		unsigned long long k = i + 1, first = (schroeder[i] >> (32 - SINE_BITS)) + 1, c = 0;
+		for (c = first; c != first + k*SINE_SIZE; ++c)
+		{
+			unsigned int phase = (unsigned int)(((c << (32 - SINE_BITS)) - schroeder[i] + k - 1)/k);
+			int v = multisine(phase);
+			v = v < 0 ? -v : v;
+			multisine_peak = v > multisine_peak ? v : multisine_peak;
+		}
+	}
+	table_ready = 1;
+}
+
+static int multisine(unsigned int phase)
+{
+	int i = 0, sum = 0;
+	for (i = 0; i != MULTISINE_N; ++i)
+	{
+		sum += sine_table[(phase*(i + 1) + schroeder[i]) >> (32 - SINE_BITS)];
+	}
+	return sum;
+}
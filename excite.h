@@ -0,0 +1,63 @@
+#ifndef EXCITE_H_
+#define EXCITE_H_
+/// @file excite.h
+/// @brief Generates excitation signals for identification and tuning experiments
+///	   Every signal is generated one tick at a time at constant cost, from a phase
+///	   accumulator and a sine lookup table, so nothing is precomputed into RAM.
+///	   Periods are given in ticks of the loop that calls excite_next().
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MULTISINE_N 8		/// the number of harmonics in a multisine
+#define PRBS_BITS 10		/// the length of the prbs shift register, the sequence repeats every 2^PRBS_BITS - 1 bits
+
+/// @brief The shape of an excitation signal
+enum ExciteType {
+		EXCITE_SQUARE,		/// offset - amplitude for the first half of the period, offset + amplitude for the second
+		EXCITE_SINE,		/// a sine with the given period
+		EXCITE_CHIRP,		/// a sine whose frequency rises linearly from one cycle per period to a quarter
+					/// of the loop rate over the period, then starts again
+		EXCITE_PRBS,		/// a maximum length pseudo random binary sequence of +/- amplitude, one bit per period
+		EXCITE_MULTISINE,	/// harmonics 1 to MULTISINE_N of the period with Schroeder phases, scaled to a peak of amplitude
+		EXCITE_TYPES
+	       };
+
+/// @brief An excitation signal.  The fields are private to excite.c.
+struct Excitation {
+	enum ExciteType type;		// the shape
+	int amplitude, offset;		// the amplitude and offset
+	unsigned int period;		// the period, in ticks
+	unsigned int phase, step;	// the phase of the fundamental and its advance per tick, a turn is 2^32
+	unsigned int step0, dstep;	// chirp: the initial step and its increase per tick
+	unsigned int tick;		// the tick within the period (chirp) or the bit (prbs)
+	unsigned int lfsr;		// prbs: the shift register
+	int scale;			// multisine: the amplitude of each harmonic, Q15 of amplitude
+};
+
+/// @brief Get a sine from the lookup table
+/// @param phase The phase, a full turn is 2^32
+/// @return the sine of the phase, Q15
+int excite_sine(unsigned int phase);
+
+/// @brief Sets up an excitation signal and starts it from the beginning
+/// @param x         The excitation
+/// @param type      The shape of the signal
+/// @param amplitude The amplitude
+/// @param offset    The offset the signal is centred on
+/// @param period    The period, in ticks, at least 2
+void excite_set(struct Excitation * x, enum ExciteType type, int amplitude, int offset, unsigned int period);
+
+/// @brief Get the next sample of the signal.  Called once per tick.
+/// @return the signal on this tick
+int excite_next(struct Excitation * x);
+
+/// @brief Get the name of a shape
+/// @return the name, such as "square", or 0 if there is no such shape
+const char * excite_name(enum ExciteType type);
+
+/// @brief Finds a shape by its name
+/// @return the shape, or EXCITE_TYPES if there is no shape with that name
+enum ExciteType excite_find(const char * name);
+
+#endif
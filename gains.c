@@ -0,0 +1,22 @@
+#include "gains.h"
+
+/// @file gains.c
+/// @brief Implements the pick up of committed gains by the control loops
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+int gains_follow(struct GainsFollower * f, unsigned int seq, int ki, int eint)
+{
+	if (seq == f->seq)
+	{
+		return eint;
+	}
+	f->seq = seq;
+	if (ki != 0 && ki != f->ki)
+	{
+		eint = (int)(((long long)eint*f->ki)/ki);
+	}
+	f->ki = ki;
+	return eint;
+}
@@ -0,0 +1,29 @@
+#ifndef GAINS_H_
+#define GAINS_H_
+/// @file gains.h
+/// @brief Changes the gains of a control loop while it runs
+///	   Each loop keeps two sets of the gains its ISR uses.  The foreground writes the set
+///	   the ISR is not using and then bumps a sequence number, whose low bit is the index of
+///	   the set the ISR picks up at the start of its next tick.  Neither side holds the other
+///	   off: the ISR preempts the foreground but never the other way around (see sched.h), and
+///	   the bump is a single store.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief What the ISR of a loop remembers of the gains it ran with on its last tick
+struct GainsFollower {
+	unsigned int seq;	/// the sequence number of the set
+	int ki;			/// the integral gain of the set
+};
+
+/// @brief Picks up the gains committed since the last tick.  Called from the control loop
+///	   interrupt at the start of every tick.
+/// @param f    What the ISR ran with on its last tick
+/// @param seq  The sequence number of the set this tick uses
+/// @param ki   The integral gain of that set
+/// @param eint The error integral
+/// @return the error integral, rescaled so that ki*eint does not jump when ki changes
+int gains_follow(struct GainsFollower * f, unsigned int seq, int ki, int eint);
+
+#endif
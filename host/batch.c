@@ -0,0 +1,229 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+
+/// @file batch.c
+/// @brief Implements the batch of motors
+///	   Motors are integrated a block at a time: BATCH_STEPS steps of one block of motors,
+///	   then the next block, so the state of a block stays in the cache for the whole tick.
+///	   The integration loop has no branches, only selects, so it vectorises; keep it that way.
+///	   Build this file without floating point contraction (-ffp-contract=off): fused
+///	   multiply-adds round differently from plant.c and the motors would drift from sim.c.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define BLOCK 256		// motors integrated together, a few kB of state per array
+#define ALIGN 64		// the alignment of the arrays, a cache line and the widest vector
+#define STEP_DT (160.0/80000000.0) // the integration step of sim.c, in seconds
+#define ENCODER_MID 32768	// the encoder count at the last reset
+#define ADC_MID 512		// as plant.c and current_amps_get()
+#define ADC_MA 1500
+#define FULL_DUTY 1999		// OC1RS and OC2RS at full duty, PR3
+#define EINT_MAX 200		// the clamp on the motion error integral
+#define MAX_AMPS 2000		// the largest current reference
+#define COUNTS_PER_REV 396	// what motion_angle() assumes, whatever the encoder really has
+
+/// @brief Integrates motors lo to hi - 1 over one tick
+static void integrate(struct Batch * b, int lo, int hi);
+
+/// @brief Runs the current loop of every motor
+static void current_loop(struct Batch * b);
+
+/// @brief Runs the motion loop of every motor
+static void motion_loop(struct Batch * b);
+
+int batch_alloc(struct Batch * b, int n)
+{
+	memset(b,0,sizeof(*b));
+	b->n = n;
+
+	double ** doubles[] = {&b->supply, &b->resistance, &b->kt, &b->inertia, &b->viscous,
+		&b->coulomb, &b->counts, &b->noise, &b->decay, &b->current, &b->speed, &b->angle,
+		&b->duty};
+	int ** ints[] = {&b->ikp, &b->iki, &b->mkp, &b->mki, &b->mkd, &b->ieint, &b->reference,
+		&b->hold, &b->sensed, &b->meint, &b->eprev};
+	size_t i = 0;
+	int ok = posix_memalign((void **)&b->rng,ALIGN,n*sizeof(unsigned int)) == 0;
+	for (i = 0; i != sizeof(doubles)/sizeof(doubles[0]); ++i)
+	{
+		ok = posix_memalign((void **)doubles[i],ALIGN,n*sizeof(double)) == 0 && ok;
+	}
+	for (i = 0; i != sizeof(ints)/sizeof(ints[0]); ++i)
+	{
+		ok = posix_memalign((void **)ints[i],ALIGN,n*sizeof(int)) == 0 && ok;
+	}
+	if (!ok)
+	{
+		batch_free(b);
+		return 0;
+	}
+
+	struct PlantParams p;
+	plant_defaults(&p);
+	int j = 0;
+	for (j = 0; j != n; ++j)
+	{
+		batch_plant(b,j,&p,1);
+		batch_gains(b,j,100,100,700,10,20000); // the defaults in current.c and motion.c
+	}
+	batch_hold(b,0);
+	return 1;
+}
+
+void batch_free(struct Batch * b)
+{
+	void * arrays[] = {b->supply, b->resistance, b->kt, b->inertia, b->viscous, b->coulomb,
+		b->counts, b->noise, b->decay, b->current, b->speed, b->angle, b->duty, b->rng,
+		b->ikp, b->iki, b->mkp, b->mki, b->mkd, b->ieint, b->reference, b->hold, b->sensed,
+		b->meint, b->eprev};
+	size_t i = 0;
+	for (i = 0; i != sizeof(arrays)/sizeof(arrays[0]); ++i)
+	{
+		free(arrays[i]);
+	}
+	memset(b,0,sizeof(*b));
+}
+
+void batch_plant(struct Batch * b, int i, const struct PlantParams * p, unsigned int seed)
+{
+	b->supply[i] = p->supply;
+	b->resistance[i] = p->resistance;
+	b->kt[i] = p->kt;
+	b->inertia[i] = p->inertia;
+	b->viscous[i] = p->viscous;
+	b->coulomb[i] = p->coulomb;
+	b->counts[i] = p->counts;
+	b->noise[i] = p->adc_noise;
+	b->decay[i] = exp(-STEP_DT*p->resistance/p->inductance); // the same expression as plant_step()
+	b->rng[i] = seed ? seed : 1;
+}
+
+void batch_gains(struct Batch * b, int i, int ikp, int iki, int mkp, int mki, int mkd)
+{
+	b->ikp[i] = ikp;
+	b->iki[i] = iki;
+	b->mkp[i] = mkp;
+	b->mki[i] = mki;
+	b->mkd[i] = mkd;
+}
+
+void batch_hold(struct Batch * b, int angle)
+{
+	int i = 0;
+	for (i = 0; i != b->n; ++i)
+	{
+		b->current[i] = b->speed[i] = b->angle[i] = 0.0;
+		b->duty[i] = 0.0;
+		b->ieint[i] = b->reference[i] = 0;
+		b->hold[i] = angle;
+		b->sensed[i] = b->meint[i] = b->eprev[i] = 0;
+	}
+	b->ticks = 0;
+}
+
+int batch_tick(struct Batch * b)
+{
+	int lo = 0;
+	for (lo = 0; lo < b->n; lo += BLOCK)
+	{
+		integrate(b,lo,lo + BLOCK < b->n ? lo + BLOCK : b->n);
+	}
+
+	// the current loop runs in the tick interrupt, before the deferred motion loop
+	current_loop(b);
+	int motion = b->ticks % BATCH_MOTION_DIVIDER == 0;
+	if (motion)
+	{
+		motion_loop(b);
+	}
+	++b->ticks;
+	return motion;
+}
+
+static void integrate(struct Batch * b, int lo, int hi)
+{
+	const double * supply = b->supply, * resistance = b->resistance, * kt = b->kt;
+	const double * inertia = b->inertia, * viscous = b->viscous, * coulomb = b->coulomb;
+	const double * decay = b->decay, * duty = b->duty;
+	double * current = b->current, * speed = b->speed, * angle = b->angle;
+	const double dt = STEP_DT;
+
+	int step = 0, i = 0;
+	for (step = 0; step != BATCH_STEPS; ++step)
+	{
+		// the arrays never overlap, but there are too many of them for the compiler to check
+		// at run time, so it has to be told
+		#pragma GCC ivdep
+		for (i = lo; i < hi; ++i)
+		{
+			// plant_step(), with its early return and branches turned into selects and the
+			// conditions combined with & and | rather than && and ||, which would be branches.
+			// duty is within -1 and 1 already, so the clamp is not needed
+			double w = speed[i], coulomb_i = coulomb[i];
+			double steady = (duty[i]*supply[i] - kt[i]*w)/resistance[i];
+			double c = steady + (current[i] - steady)*decay[i];
+			double torque = kt[i]*c - viscous[i]*w;
+			double friction = (w > 0) | ((w == 0.0) & (torque > 0)) ? coulomb_i : -coulomb_i;
+			double next = w + dt*(torque - friction)/inertia[i];
+			next = ((next > 0) != (w > 0)) & (w != 0.0) ? 0.0 : next;
+			next = (w == 0.0) & (fabs(torque) <= coulomb_i) ? w : next; // stuck
+			current[i] = c;
+			angle[i] += 0.5*dt*(next + w);
+			speed[i] = next;
+		}
+	}
+}
+
+static void current_loop(struct Batch * b)
+{
+	int i = 0;
+	for (i = 0; i != b->n; ++i)
+	{
+		// plant_adc() and current_amps_get()
+		double adc = ADC_MID + b->current[i]*1000.0*ADC_MID/ADC_MA;
+		if (b->noise[i] > 0)
+		{
+			b->rng[i] = b->rng[i]*1664525u + 1013904223u;
+			adc += b->noise[i]*(2.0*(b->rng[i] >> 8)/(double)(1u << 24) - 1.0);
+		}
+		adc = floor(adc + 0.5);
+		adc = adc < 0 ? 0 : adc > 1023 ? 1023 : adc;
+		short s = 1500*(((float)((short)adc - ADC_MID))/ADC_MID);
+
+		// the HOLD state of current_control(), with no feedforward
+		int e = b->reference[i] - s;
+		b->ieint[i] += e;
+		int u = (b->ikp[i]*e + b->iki[i]*b->ieint[i])/100;
+		int newu = u >= 2000 ? FULL_DUTY : u <= -2000 ? -FULL_DUTY : u;
+
+		// OC1RS - OC2RS, over PR3 + 1, as sim_duty() reads it
+		b->duty[i] = ((FULL_DUTY*newu)/2000)/(double)(FULL_DUTY + 1);
+	}
+}
+
+static void motion_loop(struct Batch * b)
+{
+	int i = 0;
+	for (i = 0; i != b->n; ++i)
+	{
+		// plant_encoder() and motion_angle()
+		int encoder = ENCODER_MID + (int)floor(b->angle[i]*b->counts[i]/(2*M_PI));
+		int s = (encoder - ENCODER_MID)*360/COUNTS_PER_REV;
+		b->sensed[i] = s;
+
+		// the HOLD state of motion_control()
+		int e = b->hold[i] - s;
+		int edot = e - b->eprev[i];
+		int eint = b->meint[i] + e;
+		eint = eint > EINT_MAX ? EINT_MAX : eint < -EINT_MAX ? -EINT_MAX : eint;
+		b->meint[i] = eint;
+		int u = (b->mkp[i]*e + b->mki[i]*eint + b->mkd[i]*edot)/100;
+
+		// current_amps_set()
+		b->reference[i] = u > MAX_AMPS ? MAX_AMPS : u < -MAX_AMPS ? -MAX_AMPS : u;
+		b->eprev[i] = e;
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef BATCH_H_
+#define BATCH_H_
+/// @file batch.h
+/// @brief Simulates many motors, each under its own copy of the current and motion loops, in lockstep
+///	   The state of the motors and their controllers is kept as a structure of arrays, one array
+///	   per quantity with one element per motor, so the inner loops run over contiguous memory
+///	   and the compiler can vectorise them.  The motors follow the model in plant.c and the
+///	   controllers replicate the integer arithmetic of the HOLD state of current.c and motion.c,
+///	   so a motor with the nominal parameters follows the interrupt-driven simulation in sim.c
+///	   exactly.  Only the HOLD state is modelled: there is no menu, no streaming and no tracing.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#include "plant.h"
+
+#define BATCH_TICK_HZ 5000	/// the current loop rate, SCHED_BASE_HZ
+#define BATCH_MOTION_DIVIDER 25	/// current loop ticks per motion loop tick, SCHED_BASE_HZ/MOTION_HZ
+#define BATCH_STEPS 100		/// motor integration steps per current loop tick, as sim.c integrates in 2 us steps
+
+/// @brief The motors and their controllers.  Each pointer is an array of n elements.
+struct Batch {
+	int n;			/// the number of motors
+	unsigned int ticks;	/// current loop ticks since batch_hold()
+
+	// the motor parameters, see struct PlantParams
+	double * supply, * resistance, * kt, * inertia, * viscous, * coulomb, * counts, * noise;
+	double * decay;		/// the decay of the current over one integration step, exp(-dt R/L)
+
+	// the motor state, see struct Plant
+	double * current, * speed, * angle;
+	unsigned int * rng;
+
+	// the gains, as the parameters i.kp, i.ki, m.kp, m.ki and m.kd
+	int * ikp, * iki, * mkp, * mki, * mkd;
+
+	// the controller state
+	int * ieint;		/// the integral of the current error
+	int * reference;	/// the current reference the motion loop last wrote to the mailbox, mA
+	double * duty;		/// the duty cycle the current loop last set, from OC1RS and OC2RS
+	int * hold;		/// the hold angle, degrees
+	int * sensed;		/// the angle the motion loop last read, degrees
+	int * meint, * eprev;	/// the integral of the angle error and the previous angle error
+};
+
+/// @brief Allocates a batch of motors, all with the parameters of plant_defaults() and
+///	   the default gains of the firmware, at rest at angle 0
+/// @return 1 on success, 0 if out of memory
+int batch_alloc(struct Batch * b, int n);
+
+/// @brief Frees the arrays of a batch
+void batch_free(struct Batch * b);
+
+/// @brief Sets the parameters of one motor
+/// @param seed Seeds its sensor noise, as plant_init() does
+void batch_plant(struct Batch * b, int i, const struct PlantParams * p, unsigned int seed);
+
+/// @brief Sets the gains of one motor's controllers
+void batch_gains(struct Batch * b, int i, int ikp, int iki, int mkp, int mki, int mkd);
+
+/// @brief Puts every motor at rest at angle 0 and starts holding an angle, as
+///	   motion_trajectory_reset(ANGLE,angle) followed by the HOLD state does right after sim_start()
+void batch_hold(struct Batch * b, int angle);
+
+/// @brief Advances every motor by one current loop tick: integrates the motors with the duty cycle
+///	   set on the previous tick, then runs the current loop and, when it is due, the motion loop
+/// @return 1 if the motion loop ran on this tick
+int batch_tick(struct Batch * b);
+
+#endif
@@ -0,0 +1,277 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "NU32.h"
+#include "core.h"
+#include "motion.h"
+#include "param.h"
+#include "sim.h"
+#include "batch.h"
+
+/// @file batch_sim.c
+/// @brief Runs a hold step on many motors at once, each with its parameters drawn at random
+///	   around a nominal motor, and reports how the spread of parameters spreads the response.
+///	   Motor 0 keeps the nominal parameters.  For every motor the integrated absolute error,
+///	   the overshoot and the settling time of the step are recorded; the distribution over the
+///	   motors is printed to stdout, and the throughput in motor integration steps per second
+///	   to stderr.  With -c motor 0 is also run through the interrupt-driven simulation of the
+///	   firmware and compared with it tick by tick, which must agree exactly.
+///
+///	   usage: batch_sim [-p plant] [-n motors] [-v variation] [-a angle] [-t seconds]
+///			    [-b band] [-g "ikp iki mkp mki mkd"] [-s seed] [-c]
+///	   The variation is the largest relative change of each parameter, 0.2 for +/- 20%.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MOTION_RATE (BATCH_TICK_HZ/BATCH_MOTION_DIVIDER) // the motion loop rate, in Hz
+
+/// @brief The step response of one motor
+struct Response {
+	double iae;		// the integrated absolute error, degree seconds
+	int overshoot;		// the furthest the angle went past the hold angle, degrees
+	int settled;		// the last motion tick the error was outside the band, plus 1
+};
+
+/// @brief Draws a number uniformly from -1 to 1
+static double uniform(unsigned int * rng);
+
+/// @brief Compares doubles, for qsort
+static int compare(const void * a, const void * b);
+
+/// @brief Prints the 50th, 90th and 99th percentile and the largest of n values
+static void percentiles(const char * name, double * values, int n);
+
+/// @brief Starts the firmware simulation holding an angle with the given gains
+static void start(struct Plant * m, const struct PlantParams * p, unsigned int seed, int angle,
+	const int * gains);
+
+/// @brief Runs motor 0 through the firmware simulation next to a batch of one and compares them,
+///	   then compares the batch of one with motor 0 of the batch
+/// @return 1 if they agree on every tick
+static int check(struct Batch * b, const struct PlantParams * p, unsigned int seed, int angle,
+	const int * gains, unsigned int ticks);
+
+/// @brief Seconds on a monotonic clock
+static double now(void);
+
+int main(int argc, char * argv[])
+{
+	int n = 4096, angle = 90, band = 2, verify = 0, opt = 0, i = 0;
+	int gains[5] = {100, 100, 700, 10, 20000};
+	double variation = 0.2, seconds = 1.0;
+	unsigned int seed = 1;
+	const char * plant = 0;
+
+	while ((opt = getopt(argc,argv,"p:n:v:a:t:b:g:s:c")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p': plant = optarg; break;
+			case 'n': n = atoi(optarg); break;
+			case 'v': variation = atof(optarg); break;
+			case 'a': angle = atoi(optarg); break;
+			case 't': seconds = atof(optarg); break;
+			case 'b': band = atoi(optarg); break;
+			case 'g':
+				if (sscanf(optarg,"%d %d %d %d %d",&gains[0],&gains[1],&gains[2],&gains[3],
+					&gains[4]) != 5)
+				{
+					fprintf(stderr,"-g needs five gains\n");
+					return 1;
+				}
+				break;
+			case 's': seed = (unsigned int)strtoul(optarg,0,0); break;
+			case 'c': verify = 1; break;
+			default:
+				fprintf(stderr,"usage: %s [-p plant] [-n motors] [-v variation] [-a angle] "
+					"[-t seconds] [-b band] [-g \"ikp iki mkp mki mkd\"] [-s seed] [-c]\n",argv[0]);
+				return 1;
+		}
+	}
+	n = n < 1 ? 1 : n;
+
+	struct PlantParams nominal;
+	plant_defaults(&nominal);
+	if (plant && !plant_load(&nominal,plant))
+	{
+		perror(plant);
+		return 1;
+	}
+
+	struct Batch b;
+	struct Response * responses = calloc(n,sizeof(struct Response));
+	if (!responses || !batch_alloc(&b,n))
+	{
+		fprintf(stderr,"out of memory\n");
+		return 1;
+	}
+
+	unsigned int rng = seed ? seed : 1;
+	for (i = 0; i != n; ++i)
+	{
+		struct PlantParams p = nominal;
+		if (i != 0)
+		{
+			p.resistance *= 1 + variation*uniform(&rng);
+			p.inductance *= 1 + variation*uniform(&rng);
+			p.kt *= 1 + variation*uniform(&rng);
+			p.inertia *= 1 + variation*uniform(&rng);
+			p.viscous *= 1 + variation*uniform(&rng);
+			p.coulomb *= 1 + variation*uniform(&rng);
+			p.supply *= 1 + variation*uniform(&rng);
+		}
+		batch_plant(&b,i,&p,seed + i);
+		batch_gains(&b,i,gains[0],gains[1],gains[2],gains[3],gains[4]);
+	}
+	batch_hold(&b,angle);
+
+	unsigned int ticks = (unsigned int)(seconds*BATCH_TICK_HZ + 0.5), t = 0;
+	int samples = 0;
+	double begin = now();
+	for (t = 0; t != ticks; ++t)
+	{
+		if (!batch_tick(&b))
+		{
+			continue;
+		}
+
+		++samples;
+		for (i = 0; i != n; ++i)
+		{
+			int e = b.hold[i] - b.sensed[i];
+			int over = angle >= 0 ? -e : e;
+			responses[i].iae += abs(e)/(double)MOTION_RATE;
+			responses[i].overshoot = over > responses[i].overshoot ? over : responses[i].overshoot;
+			responses[i].settled = abs(e) > band ? samples : responses[i].settled;
+		}
+	}
+	double elapsed = now() - begin;
+
+	double * values = malloc(n*sizeof(double));
+	int unsettled = 0;
+	printf("motors %d samples %d\n",n,samples);
+	for (i = 0; i != n; ++i)
+	{
+		values[i] = responses[i].iae;
+	}
+	percentiles("iae",values,n);
+	for (i = 0; i != n; ++i)
+	{
+		values[i] = responses[i].overshoot;
+	}
+	percentiles("overshoot",values,n);
+	for (i = 0; i != n; ++i)
+	{
+		values[i] = responses[i].settled/(double)MOTION_RATE;
+		unsettled += responses[i].settled == samples;
+	}
+	percentiles("settling",values,n);
+	printf("unsettled %d\n",unsettled);
+	printf("nominal iae %g overshoot %d settling %g\n",responses[0].iae,responses[0].overshoot,
+		responses[0].settled/(double)MOTION_RATE);
+
+	double steps = (double)n*ticks*BATCH_STEPS;
+	fprintf(stderr,"%.0f motor steps in %.3f s: %.3g steps/s\n",steps,elapsed,steps/elapsed);
+
+	int ok = 1;
+	if (verify)
+	{
+		ok = check(&b,&nominal,seed,angle,gains,ticks);
+	}
+	free(values);
+	free(responses);
+	batch_free(&b);
+	return ok ? 0 : 1;
+}
+
+static double uniform(unsigned int * rng)
+{
+	*rng = *rng*1664525u + 1013904223u;
+	return 2.0*(*rng >> 8)/(double)(1u << 24) - 1.0;
+}
+
+static int compare(const void * a, const void * b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void percentiles(const char * name, double * values, int n)
+{
+	qsort(values,n,sizeof(double),compare);
+	printf("%s p50 %g p90 %g p99 %g max %g\n",name,values[n/2],values[(int)(0.9*(n - 1))],
+		values[(int)(0.99*(n - 1))],values[n - 1]);
+}
+
+static void start(struct Plant * m, const struct PlantParams * p, unsigned int seed, int angle,
+	const int * gains)
+{
+	static const char * names[5] = {"i.kp", "i.ki", "m.kp", "m.ki", "m.kd"};
+	plant_init(m,p,seed);
+	sim_start(m);
+	int i = 0;
+	for (i = 0; i != 5; ++i)
+	{
+		char text[20];
+		sprintf(text,"%d",gains[i]);
+		param_set(param_find(names[i]),text);
+	}
+	motion_trajectory_reset(ANGLE,angle);
+	core_state = HOLD;
+}
+
+static int check(struct Batch * b, const struct PlantParams * p, unsigned int seed, int angle,
+	const int * gains, unsigned int ticks)
+{
+	struct Batch one;
+	if (!batch_alloc(&one,1))
+	{
+		return 0;
+	}
+	batch_plant(&one,0,p,seed);
+	batch_gains(&one,0,gains[0],gains[1],gains[2],gains[3],gains[4]);
+	batch_hold(&one,angle);
+
+	struct Plant m;
+	start(&m,p,seed,angle,gains);
+	unsigned int t = 0;
+	int ok = 1;
+	for (t = 0; t != ticks && ok; ++t)
+	{
+		batch_tick(&one);
+		sim_run(1.0/BATCH_TICK_HZ);
+		ok = one.current[0] == m.current && one.speed[0] == m.speed && one.angle[0] == m.angle;
+		if (!ok)
+		{
+			fprintf(stderr,"tick %u: batch %.17g %.17g %.17g, firmware %.17g %.17g %.17g\n",t,
+				one.current[0],one.speed[0],one.angle[0],m.current,m.speed,m.angle);
+		}
+	}
+
+	// and motor 0 of the whole batch followed the same path as the batch of one
+	ok = ok && b->current[0] == one.current[0] && b->speed[0] == one.speed[0]
+		&& b->angle[0] == one.angle[0];
+	// then the firmware simulation on its own, for its throughput.  It starts with the integral
+	// the current loop was left with, which does not matter for timing
+	start(&m,p,seed,angle,gains);
+	double begin = now();
+	sim_run((double)ticks/BATCH_TICK_HZ);
+	double elapsed = now() - begin;
+	fprintf(stderr,"firmware simulation: %.3g steps/s\n",(double)ticks*BATCH_STEPS/elapsed);
+
+	core_state = IDLE;
+	printf("check %s\n",ok ? "ok" : "failed");
+	batch_free(&one);
+	return ok;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
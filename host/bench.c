@@ -0,0 +1,434 @@
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "command.h"
+
+/// @file bench.c
+/// @brief Measures the menu protocol end to end, over the pseudo-terminal of the emulator or the
+///	   serial port of the board:
+///	   - the round trip of a 'd x' state query and of an 'm k' gain exchange, which writes back
+///	     the gains it read, from sending the command to receiving its acknowledgment;
+///	   - the round trip of the same state query as a binary frame, COMMAND_STATE;
+///	   - the round trip of an 'm l' trajectory upload and the rate its samples were sent at;
+///	   - the rate an 'i r' TUNE capture was streamed at;
+///	   - the cost of each sample on both sides: formatting uploaded and parsing streamed samples
+///	     on the host, and the 'd c' report of the firmware for the other way round.
+///	   The results are written as JSON, to stdout or to the file given by -o, so they can be kept
+///	   and compared across firmware versions; a summary goes to stderr.
+///	   The core timer of the emulator stands still while the foreground runs, so the firmware
+///	   costs it reports are the simulated time that happened to pass, not what the code costs.
+///
+///	   usage: bench [-n repeats] [-u uploads] [-s samples] [-b baud] [-o output] device
+///	   -s is the number of samples uploaded and streamed (default 1000); -b sets the baud rate,
+///	   with hardware flow control as the NU32 uses, for a real serial port.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define CORE_NS 25.0		// the period of the core timer of the PIC32, ns
+#define MAX_LINE 200		// the longest line the firmware sends
+#define MAX_REPEATS 100000	// the most round trips timed per command
+#define NLATENCIES 4		// the commands whose round trips are timed
+
+/// @brief The round trip times of a command
+struct Latency {
+	const char * name;
+	double * us;		// the round trips, in us
+	int n;
+};
+
+static int link_fd = -1;
+static char in_buffer[4096];
+static int in_start = 0, in_end = 0;
+static unsigned long long bytes_in = 0, bytes_out = 0;
+
+/// @brief Seconds on a monotonic clock
+static double now(void);
+
+/// @brief Opens the device, in raw mode and at the given baud rate if it is not 0
+/// @return 1 on success
+static int link_open(const char * device, int baud);
+
+/// @brief Sends text over the link
+static void send_text(const char * text);
+
+/// @brief Sends bytes over the link.  Exits if it fails.
+static void send_bytes(const unsigned char * data, size_t length);
+
+/// @brief Reads bytes from the link.  Exits if the link closes.
+static void receive_bytes(unsigned char * data, int n);
+
+/// @brief Reads a line from the link, without its line ending.  Exits if the firmware reports an
+///	   error, which starts with '\a', or if the link closes.
+static void receive_line(char * line);
+
+/// @brief Times a round trip of a command, from sending it to its acknowledgment, the empty line
+///	   that ends every reply
+/// @return the time, in us
+static double round_trip_d_x(void);
+static double round_trip_m_k(void);
+
+/// @brief Times a round trip of a binary frame without arguments, until its whole reply is read
+/// @return the time, in us
+static double round_trip_frame(enum CommandOpcode opcode);
+
+/// @brief Uploads a trajectory of n samples with 'm l'
+/// @param upload_s [out] The time from the first sample sent to the acknowledgment, in s
+/// @param format_s [out] The time spent formatting the samples, in s
+/// @return the round trip of the whole command, in us
+static double round_trip_frame(enum CommandOpcode opcode)
+{
+	unsigned char request[5] = {COMMAND_SYNC, opcode, 0, 0, 0}, reply[COMMAND_MAX_PAYLOAD];
+	request[4] = -opcode;
+	double begin = now();
+	send_bytes(request,sizeof(request));
+	receive_bytes(reply,5);
+	unsigned int length = reply[3] | (reply[4] << 8);
+	if (reply[0] != COMMAND_SYNC || reply[2] != COMMAND_OK || length + 1 > sizeof(reply))
+	{
+		fprintf(stderr,"the firmware did not reply to frame 0x%02x\n",opcode);
+		exit(1);
+	}
+	receive_bytes(reply,length + 1);
+	return (now() - begin)*1e6;
+}
+
+static double round_trip_m_l(int n, double * upload_s, double * format_s, unsigned long long * bytes);
+
+/// @brief Sorts the round trips and prints their percentiles as a JSON object
+static void latency_print(FILE * out, struct Latency * l, int last);
+
+/// @brief Get a percentile of sorted round trips: the one nearest the fraction p of the way
+///	   from the fastest to the slowest, so the percentiles of a few round trips stay in order
+static double percentile(const struct Latency * l, double p);
+
+/// @brief Compares doubles, for qsort
+static int compare(const void * a, const void * b);
+
+int main(int argc, char * argv[])
+{
+	int repeats = 100, uploads = 10, samples = 1000, baud = 0, opt = 0, i = 0;
+	const char * output = 0;
+	while ((opt = getopt(argc,argv,"n:u:s:b:o:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'n': repeats = atoi(optarg); break;
+			case 'u': uploads = atoi(optarg); break;
+			case 's': samples = atoi(optarg); break;
+			case 'b': baud = atoi(optarg); break;
+			case 'o': output = optarg; break;
+			default:
+				optind = argc;
+				break;
+		}
+	}
+	if (optind != argc - 1 || repeats < 1 || repeats > MAX_REPEATS || uploads < 1
+		|| uploads > MAX_REPEATS || samples < 1)
+	{
+		fprintf(stderr,"usage: %s [-n repeats] [-u uploads] [-s samples] [-b baud] [-o output] device\n",
+			argv[0]);
+		return 1;
+	}
+	const char * device = argv[optind];
+	if (!link_open(device,baud))
+	{
+		perror(device);
+		return 1;
+	}
+	FILE * out = output ? fopen(output,"w") : stdout;
+	if (!out)
+	{
+		perror(output);
+		return 1;
+	}
+
+	char line[MAX_LINE];
+	// start from a known state, and clear the costs of earlier commands
+	send_text("m\ns\n");
+	receive_line(line);
+	send_text("d\nc\n");
+	receive_line(line);
+	receive_line(line);
+
+	struct Latency latencies[NLATENCIES] = {{"d x", 0, 0}, {"m k", 0, 0}, {"m l", 0, 0}, {"state frame", 0, 0}};
+	for (i = 0; i != NLATENCIES; ++i)
+	{
+		latencies[i].us = malloc((i == 2 ? uploads : repeats)*sizeof(double));
+		if (!latencies[i].us)
+		{
+			fprintf(stderr,"out of memory\n");
+			return 1;
+		}
+	}
+	for (i = 0; i != repeats; ++i)
+	{
+		latencies[0].us[latencies[0].n++] = round_trip_d_x();
+	}
+	for (i = 0; i != repeats; ++i)
+	{
+		latencies[1].us[latencies[1].n++] = round_trip_m_k();
+	}
+	for (i = 0; i != repeats; ++i)
+	{
+		latencies[3].us[latencies[3].n++] = round_trip_frame(COMMAND_STATE);
+	}
+	double upload_s = 0, format_s = 0;
+	unsigned long long upload_bytes = 0;
+	for (i = 0; i != uploads; ++i)
+	{
+		double s = 0, f = 0;
+		latencies[2].us[latencies[2].n++] = round_trip_m_l(samples,&s,&f,&upload_bytes);
+		upload_s += s;
+		format_s += f;
+	}
+
+	// a TUNE capture, which the current loop streams as fast as it runs
+	double parse_s = 0;
+	char command[40];
+	snprintf(command,sizeof(command),"i\nr\n%d\n",samples);
+	double begin = now();
+	send_text(command);
+	receive_line(line);
+	unsigned long long first_byte = bytes_in;
+	double first = now();
+	int streamed = 0;
+	for (i = 0; i != samples; ++i)
+	{
+		receive_line(line);
+		double p = now();
+		char * s = line, * end = 0;
+		strtol(s,&end,10);	// r, s and u, which are not needed
+		strtol(end,&s,10);
+		strtol(s,&end,10);
+		parse_s += now() - p;
+		streamed += end != s;
+	}
+	receive_line(line);
+	double stream_s = now() - first;
+	unsigned long long stream_bytes = bytes_in - first_byte;
+	double stream_us = (now() - begin)*1e6;
+
+	unsigned int device_upload = 0, device_upload_ticks = 0, device_stream = 0, device_stream_ticks = 0;
+	send_text("d\nc\n");
+	receive_line(line);
+	sscanf(line,"%u %u %u %u",&device_upload,&device_upload_ticks,&device_stream,&device_stream_ticks);
+	receive_line(line);
+
+	fprintf(out,"{\n  \"device\": \"%s\",\n  \"repeats\": %d,\n  \"uploads\": %d,\n  \"samples\": %d,\n",
+		device,repeats,uploads,samples);
+	fprintf(out,"  \"latency_us\": {\n");
+	for (i = 0; i != NLATENCIES; ++i)
+	{
+		latency_print(out,&latencies[i],i == NLATENCIES - 1);
+	}
+	fprintf(out,"  },\n");
+	fprintf(out,"  \"upload\": {\"bytes\": %llu, \"bytes_per_s\": %.0f, \"samples_per_s\": %.0f},\n",
+		upload_bytes/uploads,upload_bytes/upload_s,(double)samples*uploads/upload_s);
+	fprintf(out,"  \"stream\": {\"round_trip_us\": %.0f, \"bytes\": %llu, \"bytes_per_s\": %.0f, "
+		"\"samples_per_s\": %.0f},\n",stream_us,stream_bytes,stream_bytes/stream_s,streamed/stream_s);
+	fprintf(out,"  \"ns_per_sample\": {\"host_upload_format\": %.1f, \"host_stream_parse\": %.1f, "
+		"\"device_upload_parse\": %.1f, \"device_stream_format\": %.1f}\n}\n",
+		format_s*1e9/((double)samples*uploads),parse_s*1e9/samples,
+		device_upload ? device_upload_ticks*CORE_NS/device_upload : 0.0,
+		device_stream ? device_stream_ticks*CORE_NS/device_stream : 0.0);
+
+	fprintf(stderr,"median d x %.0f us, m k %.0f us, m l %.0f us; upload %.0f B/s, stream %.0f B/s\n",
+		percentile(&latencies[0],0.5),percentile(&latencies[1],0.5),percentile(&latencies[2],0.5),
+		upload_bytes/upload_s,stream_bytes/stream_s);
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+	for (i = 0; i != NLATENCIES; ++i)
+	{
+		free(latencies[i].us);
+	}
+	return 0;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static int link_open(const char * device, int baud)
+{
+	static const struct {int baud; speed_t speed;} speeds[] = {{9600, B9600}, {19200, B19200},
+		{38400, B38400}, {57600, B57600}, {115200, B115200}, {230400, B230400}};
+	link_fd = open(device,O_RDWR | O_NOCTTY);
+	if (link_fd < 0)
+	{
+		return 0;
+	}
+	struct termios tio;
+	if (tcgetattr(link_fd,&tio) != 0)
+	{
+		return 0;
+	}
+	cfmakeraw(&tio);
+	if (baud)
+	{
+		size_t i = 0;
+		for (i = 0; i != sizeof(speeds)/sizeof(speeds[0]) && speeds[i].baud != baud; ++i)
+		{
+			;
+		}
+		if (i == sizeof(speeds)/sizeof(speeds[0]))
+		{
+			fprintf(stderr,"unsupported baud rate %d\n",baud);
+			return 0;
+		}
+		cfsetispeed(&tio,speeds[i].speed);
+		cfsetospeed(&tio,speeds[i].speed);
+		tio.c_cflag |= CRTSCTS | CLOCAL | CREAD;
+	}
+	tcsetattr(link_fd,TCSANOW,&tio);
+	tcflush(link_fd,TCIOFLUSH);
+	return 1;
+}
+
+static void send_text(const char * text)
+{
+	send_bytes((const unsigned char *)text,strlen(text));
+}
+
+static void send_bytes(const unsigned char * data, size_t length)
+{
+	size_t sent = 0;
+	while (sent != length)
+	{
+		ssize_t n = write(link_fd,data + sent,length - sent);
+		if (n <= 0)
+		{
+			perror("write");
+			exit(1);
+		}
+		sent += n;
+	}
+	bytes_out += length;
+}
+
+static void receive_bytes(unsigned char * data, int n)
+{
+	int i = 0;
+	for (i = 0; i != n; ++i)
+	{
+		if (in_start == in_end)
+		{
+			ssize_t got = read(link_fd,in_buffer,sizeof(in_buffer));
+			if (got <= 0)
+			{
+				fprintf(stderr,"the link closed\n");
+				exit(1);
+			}
+			in_start = 0;
+			in_end = got;
+			bytes_in += got;
+		}
+		data[i] = in_buffer[in_start++];
+	}
+}
+
+static void receive_line(char * line)
+{
+	int length = 0;
+	while (1)
+	{
+		unsigned char c = 0;
+		receive_bytes(&c,1);
+		if (c == '\n')
+		{
+			break;
+		}
+		if (c != '\r' && length != MAX_LINE - 1)
+		{
+			line[length++] = c;
+		}
+	}
+	line[length] = '\0';
+	if (line[0] == '\a')
+	{
+		fprintf(stderr,"the firmware reported an error: %s\n",line + 1);
+		exit(1);
+	}
+}
+
+static double round_trip_d_x(void)
+{
+	char line[MAX_LINE];
+	double begin = now();
+	send_text("d\nx\n");
+	receive_line(line);
+	receive_line(line);
+	return (now() - begin)*1e6;
+}
+
+static double round_trip_m_k(void)
+{
+	char line[MAX_LINE];
+	double begin = now();
+	send_text("m\nk\n");
+	receive_line(line);
+	strcat(line,"\n");
+	send_text(line);
+	receive_line(line);
+	return (now() - begin)*1e6;
+}
+
+static double round_trip_m_l(int n, double * upload_s, double * format_s, unsigned long long * bytes)
+{
+	static char text[16*1024];
+	char line[MAX_LINE];
+	double begin = now();
+	snprintf(line,sizeof(line),"m\nl\n%d\n",n);
+	send_text(line);
+	receive_line(line); // ready for the samples
+
+	// a 90 degree sine with a period of 200 samples, sent a block at a time
+	double first = now(), formatting = 0;
+	unsigned long long start_bytes = bytes_out;
+	int i = 0, used = 0;
+	for (i = 0; i != n; ++i)
+	{
+		double f = now();
+		used += snprintf(text + used,sizeof(text) - used,"%d\n",(int)lround(90*sin(2*M_PI*i/200)));
+		formatting += now() - f;
+		if (used > (int)sizeof(text) - 32 || i == n - 1)
+		{
+			send_text(text);
+			used = 0;
+		}
+	}
+	receive_line(line);
+	double end = now();
+	*upload_s = end - first;
+	*format_s = formatting;
+	*bytes += bytes_out - start_bytes;
+	return (end - begin)*1e6;
+}
+
+static void latency_print(FILE * out, struct Latency * l, int last)
+{
+	qsort(l->us,l->n,sizeof(double),compare);
+	fprintf(out,"    \"%s\": {\"p50\": %.0f, \"p90\": %.0f, \"p99\": %.0f, \"max\": %.0f}%s\n",l->name,
+		percentile(l,0.5),percentile(l,0.9),percentile(l,0.99),l->us[l->n - 1],last ? "" : ",");
+}
+
+static double percentile(const struct Latency * l, double p)
+{
+	return l->us[(int)(p*(l->n - 1) + 0.5)];
+}
+
+static int compare(const void * a, const void * b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
@@ -0,0 +1,230 @@
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "NU32.h"
+#include "core.h"
+#include "menu.h"
+#include "hal.h"
+#include "sim.h"
+
+/// @file emulator.c
+/// @brief Runs the firmware, menu and all, against the simulated motor and serves its UART on
+///	   a pseudo-terminal, so the client or any serial program can connect to it as to the board.
+///	   menu_run() runs in the main thread, as the foreground does on the PIC32.  A second thread
+///	   interrupts it with a signal, whose handler advances the simulation and so runs the
+///	   interrupt service routines: they preempt the foreground at arbitrary instructions and
+///	   run to completion, as on the hardware.  A signal that arrives while the firmware has
+///	   interrupts disabled is held off until the next one, like a pending interrupt.
+///
+///	   In real time (the default) the simulated clock follows the wall clock, scaled by -s.
+///	   Free running (-f) advances the simulation as fast as the host allows while the firmware
+///	   is busy, and stops it while the firmware waits for a command, so automated tests run
+///	   quickly and the motor does not drift between their commands.
+///
+///	   usage: emulator [-p plant] [-f] [-s speed] [-l link]
+///	   The name of the pseudo-terminal is printed to stderr; -l also makes a symbolic link to it,
+///	   such as -l /tmp/ttyNU32, which is removed when the emulator is interrupted.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define REALTIME_US 1000	// how often the simulation catches up with the wall clock, in us
+#define FREE_QUANTUM (HAL_PBCLK/5000) // the simulated time per interrupt when free running, a tick
+#define MAX_CATCH_UP (HAL_PBCLK/10) // the most simulated time per interrupt in real time, 100 ms
+
+static pthread_t foreground;
+static int free_running = 0;
+static double speed = 1.0;
+static const char * link_path = 0;
+static struct timespec start;		// the wall clock when the simulation started
+static sem_t taken;			// posted when the foreground has taken an interrupt
+
+/// @brief The interrupt: advances the simulation, in the foreground thread
+static void interrupt(int sig);
+
+/// @brief The thread that raises the interrupts
+static void * interrupter(void * arg);
+
+/// @brief Removes the link to the pseudo-terminal and exits
+static void quit(int sig);
+
+/// @brief Opens a pseudo-terminal in raw mode and makes it standard input and output
+/// @return the file descriptor of its slave side, which is kept open so the master side does not
+///	   report an error while no client is connected, or -1 on error
+static int pty_open(void);
+
+int main(int argc, char * argv[])
+{
+	const char * plant = 0;
+	int opt = 0;
+	while ((opt = getopt(argc,argv,"p:fs:l:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p': plant = optarg; break;
+			case 'f': free_running = 1; break;
+			case 's': speed = atof(optarg); break;
+			case 'l': link_path = optarg; break;
+			default:
+				fprintf(stderr,"usage: %s [-p plant] [-f] [-s speed] [-l link]\n",argv[0]);
+				return 1;
+		}
+	}
+	if (speed <= 0)
+	{
+		fprintf(stderr,"the speed must be positive\n");
+		return 1;
+	}
+
+	struct PlantParams p;
+	plant_defaults(&p);
+	if (plant && !plant_load(&p,plant))
+	{
+		perror(plant);
+		return 1;
+	}
+	static struct Plant m;
+	plant_init(&m,&p,1);
+
+	if (pty_open() < 0)
+	{
+		perror("pseudo-terminal");
+		return 1;
+	}
+	signal(SIGINT,quit);
+	signal(SIGTERM,quit);
+
+	// main() of the firmware, with the simulation standing in for the hardware
+	sim_start(&m);
+	clock_gettime(CLOCK_MONOTONIC,&start);
+
+	struct sigaction sa;
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler = interrupt;
+	sa.sa_flags = SA_RESTART; // reading the UART carries on after an interrupt
+	sigaction(SIGUSR1,&sa,0);
+	foreground = pthread_self();
+	sem_init(&taken,0,0);
+	pthread_t thread;
+	if (pthread_create(&thread,0,interrupter,0) != 0)
+	{
+		fprintf(stderr,"cannot start the interrupts\n");
+		return 1;
+	}
+
+	menu_run();
+	return 0;
+}
+
+static void interrupt(int sig)
+{
+	(void)sig;
+	if (free_running)
+	{
+		if (!hal_interrupts_off)
+		{
+			sim_advance(FREE_QUANTUM);
+		}
+		sem_post(&taken);
+		return;
+	}
+	if (hal_interrupts_off)
+	{
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	double elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec)*1e-9;
+	unsigned long long target = (unsigned long long)(elapsed*speed*HAL_PBCLK);
+	if (target > hal_clock)
+	{
+		// a host that falls behind slows the simulation down rather than skipping time
+		sim_advance(target - hal_clock < MAX_CATCH_UP ? target - hal_clock : MAX_CATCH_UP);
+	}
+}
+
+static void * interrupter(void * arg)
+{
+	(void)arg;
+	const struct timespec period = {0, REALTIME_US*1000};
+	while (1)
+	{
+		if (free_running && !hal_uart_waiting)
+		{
+			// let the foreground take the interrupt before raising the next, which on a single
+			// processor would otherwise wait for the end of this thread's time slice
+			pthread_kill(foreground,SIGUSR1);
+			sem_wait(&taken);
+		}
+		else if (free_running)
+		{
+			nanosleep(&period,0); // the firmware waits for a command, so time stands still
+		}
+		else
+		{
+			pthread_kill(foreground,SIGUSR1);
+			nanosleep(&period,0);
+		}
+	}
+	return 0;
+}
+
+static void quit(int sig)
+{
+	(void)sig;
+	if (link_path)
+	{
+		unlink(link_path);
+	}
+	_exit(0);
+}
+
+static int pty_open(void)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+	{
+		return -1;
+	}
+	const char * name = ptsname(master);
+	int slave = name ? open(name,O_RDWR | O_NOCTTY) : -1;
+	if (slave < 0)
+	{
+		return -1;
+	}
+
+	// the UART passes bytes through unchanged: no echo, no line editing, no newline translation
+	struct termios tio;
+	tcgetattr(slave,&tio);
+	cfmakeraw(&tio);
+	tcsetattr(slave,TCSANOW,&tio);
+
+	if (link_path)
+	{
+		unlink(link_path);
+		if (symlink(name,link_path) != 0)
+		{
+			perror(link_path);
+			link_path = 0;
+		}
+	}
+	fprintf(stderr,"serving the UART on %s%s%s\n",name,link_path ? " as " : "",link_path ? link_path : "");
+	if (dup2(master,STDIN_FILENO) < 0 || dup2(master,STDOUT_FILENO) < 0)
+	{
+		return -1;
+	}
+	close(master);
+	setvbuf(stdin,0,_IONBF,0); // NU32_PollUART1() looks at the descriptor, so no byte may wait in a buffer
+	return slave;
+}
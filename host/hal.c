@@ -0,0 +1,184 @@
+#include <string.h>
+#include "NU32.h"
+#include "core.h"
+#include "param.h"
+#include "sched.h"
+#include "load.h"
+#include "trace.h"
+#include "dee_emulation_pic32.h"
+#include "hal.h"
+
+/// @file hal.c
+/// @brief Host implementation of the special function registers, core.h and the data eeprom
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+struct HalBits T1CONbits, T2CONbits, T3CONbits, OC1CONbits, OC2CONbits;
+struct HalBits IPC1bits, IPC2bits, IPC6bits, IFS0bits, IEC0bits;
+struct HalBits TRISEbits, AD1CON1bits, AD1CON3bits, AD1CHSbits, SPI4STATbits;
+struct HalBits U1STAbits, U1MODEbits, DDPCONbits, LATAbits, PORTDbits;
+
+volatile unsigned int OC1R, OC1RS, OC2R, OC2RS;
+volatile unsigned int PR1, PR2, PR3, TMR1, TMR2, TMR3;
+volatile unsigned int LATEINV, TRISACLR, AD1PCFG, ADC1BUF0;
+volatile unsigned int SPI4CON, SPI4BUF, SPI4BRG, SPI4STATCLR, U1BRG, U1RXREG;
+volatile unsigned int IFS0SET, IFS0CLR;
+
+unsigned long long hal_clock = 0;
+struct Plant * hal_plant = 0;
+short hal_adc = 512;
+int hal_encoder = 32768;
+int hal_interrupts_off = 0;
+
+static unsigned int eeprom[DATA_EE_SIZE];
+
+/// @brief The heartbeat task of core.c, so the scheduler runs the same tasks as on the board
+static void heartbeat(void);
+
+enum State core_state = IDLE;
+
+void hal_reset(struct Plant * m)
+{
+	struct HalBits * regs[] = {&T1CONbits, &T2CONbits, &T3CONbits, &OC1CONbits, &OC2CONbits,
+		&IPC1bits, &IPC2bits, &IPC6bits, &IFS0bits, &IEC0bits, &TRISEbits, &AD1CON1bits,
+		&AD1CON3bits, &AD1CHSbits, &SPI4STATbits, &U1STAbits, &U1MODEbits, &DDPCONbits,
+		&LATAbits, &PORTDbits};
+	size_t i = 0;
+	for (i = 0; i != sizeof(regs)/sizeof(regs[0]); ++i)
+	{
+		memset(regs[i],0,sizeof(struct HalBits));
+	}
+	OC1R = OC1RS = OC2R = OC2RS = 0;
+	IFS0SET = IFS0CLR = 0;
+	PR1 = PR2 = PR3 = TMR1 = TMR2 = TMR3 = 0;
+	memset(eeprom,0,sizeof(eeprom));
+
+	hal_clock = 0;
+	hal_plant = m;
+	hal_adc = 512;
+	hal_encoder = 32768;
+	hal_interrupts_off = 0;
+	core_state = IDLE;
+}
+
+void hal_latch(void)
+{
+	if (IFS0SET & _IFS0_T1IF_MASK)
+	{
+		IFS0bits.T1IF = 1;
+	}
+	if (IFS0SET & _IFS0_T2IF_MASK)
+	{
+		IFS0bits.T2IF = 1;
+	}
+	if (IFS0CLR & _IFS0_T1IF_MASK)
+	{
+		IFS0bits.T1IF = 0;
+	}
+	if (IFS0CLR & _IFS0_T2IF_MASK)
+	{
+		IFS0bits.T2IF = 0;
+	}
+	IFS0SET = IFS0CLR = 0;
+}
+
+unsigned int INTDisableInterrupts(void)
+{
+	unsigned int was_on = !hal_interrupts_off;
+	hal_interrupts_off = 1;
+	return was_on;
+}
+
+unsigned int INTEnableInterrupts(void)
+{
+	unsigned int was_on = !hal_interrupts_off;
+	hal_interrupts_off = 0;
+	return was_on;
+}
+
+void INTRestoreInterrupts(unsigned int status)
+{
+	hal_interrupts_off = !status;
+}
+
+void INTEnableSystemMultiVectoredInt(void)
+{
+	hal_interrupts_off = 0;
+}
+
+unsigned int _CP0_GET_COUNT(void)
+{
+	return (unsigned int)(hal_clock/2);
+}
+
+void core_init(void)
+{
+	trace_init();
+	core_state = IDLE;
+	sched_init();
+	sched_register("heartbeat",heartbeat,SCHED_BASE_HZ/HEARTBEAT_HZ,HEARTBEAT_PHASE,SCHED_DEFERRED);
+	load_init();
+}
+
+static void heartbeat(void)
+{
+	NU32LED2 = !NU32LED2;
+}
+
+short core_adc_read(void)
+{
+	return hal_plant ? plant_adc(hal_plant) : hal_adc;
+}
+
+void core_encoder_reset(void)
+{
+	if (hal_plant)
+	{
+		plant_encoder_reset(hal_plant);
+	}
+	else
+	{
+		hal_encoder = 32768;
+	}
+}
+
+int core_encoder_read(void)
+{
+	return hal_plant ? plant_encoder(hal_plant) : hal_encoder;
+}
+
+void core_gains_save()
+{
+	param_save();
+}
+
+void core_gains_load()
+{
+	param_load();
+}
+
+unsigned int DataEEInit(void)
+{
+	return 0;
+}
+
+unsigned int DataEERead(unsigned int * data, unsigned int addr)
+{
+	if (addr >= DATA_EE_SIZE)
+	{
+		return 5; // illegal address
+	}
+	*data = eeprom[addr];
+	return 0;
+}
+
+unsigned int DataEEWrite(unsigned int data, unsigned int addr)
+{
+	if (addr >= DATA_EE_SIZE)
+	{
+		return 5; // illegal address
+	}
+	eeprom[addr] = data;
+	return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef HAL_H_
+#define HAL_H_
+/// @file hal.h
+/// @brief Host implementation of the hardware the firmware uses
+///	   hal.c defines the special function registers declared in include/plib.h,
+///	   implements core.h on top of a simulated motor, and emulates the data eeprom.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#include <stdio.h>
+#include "plant.h"
+
+#define HAL_PBCLK 80000000ULL	/// the peripheral bus clock, which the simulation counts in
+
+/// @brief The simulated time, in peripheral bus clock ticks.  The core timer runs at half this rate.
+extern unsigned long long hal_clock;
+
+/// @brief The motor that core_adc_read() and core_encoder_read() sample
+extern struct Plant * hal_plant;
+
+/// @brief The readings core_adc_read() and core_encoder_read() return while hal_plant is 0,
+///	   so recorded sensor data can be replayed through the control loops
+extern short hal_adc;
+extern int hal_encoder;
+
+/// @brief Where NU32_WriteUART1() writes.  Standard output if 0.
+extern FILE * hal_uart_out;
+
+/// @brief Nonzero while NU32_ReadUART1() waits for a line on standard input
+extern volatile int hal_uart_waiting;
+
+/// @brief Nonzero while the firmware has interrupts disabled
+extern int hal_interrupts_off;
+
+/// @brief Applies the bits written to the SET and CLR registers to the interrupt flags
+void hal_latch(void);
+
+/// @brief Resets the registers and the emulated eeprom and attaches the firmware to a motor, or to
+///	   hal_adc and hal_encoder if m is 0
+void hal_reset(struct Plant * m);
+
+#endif
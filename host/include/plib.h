@@ -0,0 +1,58 @@
+#ifndef PLIB_H_HOST__
+#define PLIB_H_HOST__
+/// @file plib.h
+/// @brief Host stand-in for the Microchip peripheral library.
+///	   Lets the firmware modules compile on Linux.  Special function registers
+///	   are plain variables defined in hal.c; the simulator (sim.c) reads the ones
+///	   that drive the plant and the interrupt scheduler.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#include <stdio.h>
+#include <string.h>
+
+/// interrupt service routines are ordinary functions that the simulator calls
+#define __ISR(vector,ipl)
+
+/// @brief Every bit field register shares this layout, only the fields the firmware uses matter
+struct HalBits {
+	unsigned int ON, TCS, TCKPS;				// timers
+	unsigned int OCM, OCTSEL;				// output compare
+	unsigned int T1IP, T1IS, T2IP, T2IS, U1IP, U1IS;	// interrupt priorities
+	unsigned int T1IF, T2IF, U1RXIF;			// interrupt flags
+	unsigned int T1IE, T2IE, U1RXIE;			// interrupt enables
+	unsigned int TRISE0, TRISE1;				// port E direction
+	unsigned int SAMP, DONE, ASAM, SSRC, ADRC, ADCS, SAMC, ADON, CH0SA; // adc
+	unsigned int SPIRBF;					// spi
+	unsigned int URXDA, UTXEN, URXEN, URXISEL, BRGH, PDSEL, STSEL, UEN; // uart
+	unsigned int JTAGEN, LATA4, LATA5, RD13;		// misc
+};
+
+extern struct HalBits T1CONbits, T2CONbits, T3CONbits, OC1CONbits, OC2CONbits;
+extern struct HalBits IPC1bits, IPC2bits, IPC6bits, IFS0bits, IEC0bits;
+extern struct HalBits TRISEbits, AD1CON1bits, AD1CON3bits, AD1CHSbits, SPI4STATbits;
+extern struct HalBits U1STAbits, U1MODEbits, DDPCONbits, LATAbits, PORTDbits;
+
+extern volatile unsigned int OC1R, OC1RS, OC2R, OC2RS;
+extern volatile unsigned int PR1, PR2, PR3, TMR1, TMR2, TMR3;
+extern volatile unsigned int LATEINV, TRISACLR, AD1PCFG, ADC1BUF0;
+extern volatile unsigned int SPI4CON, SPI4BUF, SPI4BRG, SPI4STATCLR, U1BRG, U1RXREG;
+
+/// writes to the SET and CLR registers take effect when hal_latch() runs, which the simulator
+/// does after every interrupt service routine
+extern volatile unsigned int IFS0SET, IFS0CLR;
+#define _IFS0_T1IF_MASK 0x00000010
+#define _IFS0_T2IF_MASK 0x00000100
+
+typedef enum { UART1 } UART_MODULE;
+
+unsigned int INTDisableInterrupts(void);
+unsigned int INTEnableInterrupts(void);
+void INTRestoreInterrupts(unsigned int status);
+void INTEnableSystemMultiVectoredInt(void);
+
+/// @brief The core timer, which counts at half the system clock
+unsigned int _CP0_GET_COUNT(void);
+
+#endif
@@ -0,0 +1,137 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "NU32.h"
+#include "core.h"
+#include "motion.h"
+#include "setpoint.h"
+#include "hal.h"
+#include "sim.h"
+
+/// @file mailbox_check.c
+/// @brief Verifies the setpoint mailbox between the motion and current loops
+///	   1. Preemption: the writer runs in a loop while a signal handler, standing in for the
+///	      priority 7 current ISR, reads the mailbox at arbitrary instructions of the writer.
+///	      Every setpoint read must be complete and no older than the previous one.
+///	   2. Scheduling: the firmware holds an angle under the interrupt scheduler simulation
+///	      and, after every current ISR, the setpoint must be no older than one motion period.
+///	   Exits with a nonzero status if either check fails.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define READS 500		// setpoints read in the preemption check
+#define HOLD_ANGLE 90		// degrees
+
+static volatile sig_atomic_t failures = 0, reads = 0, torn = 0, in_write = 0, done = 0;
+static volatile unsigned int last_seq = 0;
+static pthread_t writer_thread;
+
+// the writer publishes setpoint k with current k, feedforward -k and time stamp k,
+// so a setpoint mixing two writes is easy to spot
+static void reader(int sig)
+{
+	(void)sig;
+	struct Setpoint sp;
+	setpoint_read(&sp);
+	if (sp.current != (int)sp.seq || sp.voltage != -(int)sp.seq || sp.stamp != sp.seq || sp.seq < last_seq)
+	{
+		++failures;
+	}
+	last_seq = sp.seq;
+	++reads;
+	torn += in_write;
+}
+
+static void * interrupter(void * arg)
+{
+	(void)arg;
+	while (!done)
+	{
+		pthread_kill(writer_thread,SIGUSR1);
+	}
+	return 0;
+}
+
+static int check_preemption(void)
+{
+	struct sigaction sa;
+	memset(&sa,0,sizeof(sa));
+	sa.sa_handler = reader;
+	sigaction(SIGUSR1,&sa,0);
+
+	writer_thread = pthread_self();
+	pthread_t thread;
+	pthread_create(&thread,0,interrupter,0);
+
+	unsigned int k = 0;
+	for (k = 1; reads < READS; ++k)
+	{
+		hal_clock = 2ULL*k; // so the core timer, and the time stamp, read k
+		in_write = 1;
+		setpoint_write(k,-(int)k);
+		in_write = 0;
+	}
+	done = 1;
+	pthread_join(thread,0);
+
+	printf("preemption: %u writes, %d reads, %d inside a write, %d inconsistent\n",
+		k - 1,(int)reads,(int)torn,(int)failures);
+	return failures == 0 && torn > 0;
+}
+
+static unsigned int max_age = 0, isr_failures = 0, prev_seq = 0, current_ticks = 0, first_seq = 0;
+
+static void after_isr(enum SimVector vector)
+{
+	if (vector != SIM_TIMER_1 || core_state != HOLD)
+	{
+		return;
+	}
+
+	struct Setpoint sp;
+	unsigned int age = setpoint_read(&sp);
+	if (sp.seq < prev_seq)
+	{
+		++isr_failures;
+	}
+	prev_seq = sp.seq;
+	// ticks before the first motion tick see the stale setpoint left over from before HOLD
+	if (sp.seq != first_seq && age > max_age)
+	{
+		max_age = age;
+	}
+	++current_ticks;
+}
+
+static int check_schedule(void)
+{
+	struct PlantParams p;
+	struct Plant m;
+	plant_defaults(&p);
+	plant_init(&m,&p,1);
+	sim_start(&m);
+
+	struct Setpoint sp;
+	setpoint_read(&sp);
+	first_seq = prev_seq = sp.seq;
+	sim_isr_hook = after_isr;
+	motion_trajectory_reset(ANGLE,HOLD_ANGLE);
+	core_state = HOLD;
+	sim_run(1.0);
+	core_state = IDLE;
+	sim_isr_hook = 0;
+
+	printf("schedule: %u current ticks, oldest setpoint %u core ticks (motion period %u), angle %d\n",
+		current_ticks,max_age,motion_period(),motion_angle());
+	return isr_failures == 0 && max_age <= motion_period();
+}
+
+int main(void)
+{
+	int ok = check_preemption();
+	ok = check_schedule() && ok;
+	printf("%s\n",ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,499 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "NU32.h"
+#include "core.h"
+#include "current.h"
+#include "motion.h"
+#include "param.h"
+#include "hal.h"
+#include "sim.h"
+
+/// @file optimize.c
+/// @brief Searches the gains of the motion or current loop that minimise the tracking error
+///	   of the firmware on the simulated motor, over a library of experiments: trajectories
+///	   for the motion loop and tuning waves for the current loop.
+///	   The search is a grid over the logarithm of the gains, refined with Nelder-Mead.
+///	   Every (candidate, experiment) pair is a job.  Worker processes claim jobs from a shared
+///	   counter, so a worker that finishes early takes on work the others have not reached.
+///	   Processes are used rather than threads because the firmware keeps its state in globals,
+///	   and every job runs in a fresh fork, so it starts from the same state whichever worker
+///	   runs it.  The result therefore depends only on the seed, not on the number of workers.
+///	   The cost of a candidate is the sum of the integrated absolute errors of its experiments.
+///	   The best gains are printed to stdout in the format motion_gains_sscanf or
+///	   current_gains_sscanf reads; progress goes to stderr.
+///
+///	   usage: optimize [-l motion|current] [-p plant] [-t trajectory]... [-s seed]
+///			   [-j workers] [-g grid] [-n iterations]
+///	   A trajectory file holds one angle in degrees per line, sampled at the motion loop rate,
+///	   like the trajectories the 'm l' command loads.  Without -t a built-in library is used.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MAX_DIMS 3		// the most gains a loop has
+#define MAX_EXPERIMENTS 16	// the most experiments
+#define MAX_TRAJ 1000		// the longest trajectory, in motion samples (MAX_TRAJ_LEN in motion.c)
+#define SETTLE 100		// motion samples recorded after the end of a trajectory
+#define TUNE_SAMPLES 2500	// current loop ticks recorded per tuning wave
+#define MAX_GRID 9		// the most grid points per gain
+#define MOTION_RATE MOTION_HZ	// the motion loop rate, in Hz
+
+/// @brief An experiment: a trajectory for the motion loop or a tuning wave for the current loop
+struct Experiment {
+	int length;		// the trajectory length, in samples
+	int angles[MAX_TRAJ];	// the trajectory, in degrees
+	char wave[40];		// the tuning wave, as current_excite_sscanf reads it
+};
+
+/// @brief A simulation job, shared between the processes
+struct Job {
+	double gains[MAX_DIMS];	// the gains to simulate
+	int experiment;		// the experiment to run
+	double cost;		// the result
+};
+
+/// @brief The job queue, in memory shared with the workers
+struct Queue {
+	unsigned int next;	// the next job to claim
+	unsigned int njobs;	// the number of jobs
+	struct Job jobs[];
+};
+
+static int motion = 1;				// 1 to optimise the motion gains, 0 for the current gains
+static int dims = 3;				// the number of gains
+static const char * names[2][MAX_DIMS] = {{"i.kp", "i.ki", ""}, {"m.kp", "m.ki", "m.kd"}};
+static double lo[MAX_DIMS], hi[MAX_DIMS];	// the bounds of the log of each gain
+static struct PlantParams params;
+static struct Experiment experiments[MAX_EXPERIMENTS];
+static int nexperiments = 0;
+static unsigned int seed = 1;
+static int workers = 1;
+static struct Queue * queue = 0;
+static unsigned int capacity = 0;		// the number of jobs the queue can hold
+
+/// @brief Fills in the built-in experiments of the loop being optimised
+static void library(void);
+
+/// @brief Reads a trajectory file into the next experiment
+/// @return 1 on success, 0 on failure
+static int trajectory_load(const char * path);
+
+/// @brief Rounds the log of the gains into the text the sscanf function of the loop reads
+static void gains_text(const double * x, char * buffer);
+
+/// @brief Runs one job.  Called in a fresh process.
+static double simulate(const struct Job * job);
+
+/// @brief Evaluates the cost of candidates in parallel
+/// @param x    The candidates, the log of the gains
+/// @param n    The number of candidates
+/// @param cost [out] The cost of each candidate
+static void evaluate(double x[][MAX_DIMS], int n, double * cost);
+
+/// @brief Keeps a candidate within the bounds
+static void clamp(double * x);
+
+/// @brief Sorts a simplex by cost, best first
+static void simplex_sort(double x[][MAX_DIMS], double * cost, int n);
+
+int main(int argc, char * argv[])
+{
+	int grid = 3, iterations = 20, opt = 0, i = 0, j = 0;
+	const char * plant = 0;
+	const char * trajectories[MAX_EXPERIMENTS];
+	int ntrajectories = 0;
+
+	workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(argc,argv,"l:p:t:s:j:g:n:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'l': motion = strcmp(optarg,"current") != 0; break;
+			case 'p': plant = optarg; break;
+			case 't':
+				if (ntrajectories < MAX_EXPERIMENTS)
+				{
+					trajectories[ntrajectories++] = optarg;
+				}
+				break;
+			case 's': seed = (unsigned int)strtoul(optarg,0,0); break;
+			case 'j': workers = atoi(optarg); break;
+			case 'g': grid = atoi(optarg); break;
+			case 'n': iterations = atoi(optarg); break;
+			default:
+				fprintf(stderr,"usage: %s [-l motion|current] [-p plant] [-t trajectory]... "
+					"[-s seed] [-j workers] [-g grid] [-n iterations]\n",argv[0]);
+				return 1;
+		}
+	}
+	workers = workers < 1 ? 1 : workers;
+	grid = grid < 1 ? 1 : grid > MAX_GRID ? MAX_GRID : grid;
+	dims = motion ? 3 : 2;
+
+	plant_defaults(&params);
+	if (plant && !plant_load(&params,plant))
+	{
+		perror(plant);
+		return 1;
+	}
+	if (ntrajectories && !motion)
+	{
+		fprintf(stderr,"trajectories only apply to the motion loop\n");
+		return 1;
+	}
+	for (i = 0; i != ntrajectories; ++i)
+	{
+		if (!trajectory_load(trajectories[i]))
+		{
+			return 1;
+		}
+	}
+	if (!nexperiments)
+	{
+		library();
+	}
+
+	// the bounds come from the parameter registry, which the loops fill in when they start
+	struct Plant m;
+	plant_init(&m,&params,seed);
+	sim_start(&m);
+	for (i = 0; i != dims; ++i)
+	{
+		char text[100], name[20], type = 0;
+		float min = 0, max = 0, value = 0;
+		param_describe(param_find(names[motion][i]),text);
+		sscanf(text,"%19s %c %f %f %f",name,&type,&value,&min,&max);
+		lo[i] = log(min < 1 ? 1 : min);
+		hi[i] = log(max);
+	}
+
+	int ngrid = 1;
+	for (i = 0; i != dims; ++i)
+	{
+		ngrid *= grid;
+	}
+	capacity = (ngrid > 4 ? ngrid : 4)*nexperiments; // a Nelder-Mead iteration evaluates 4 points
+	queue = mmap(0,sizeof(struct Queue) + capacity*sizeof(struct Job),PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_ANONYMOUS,-1,0);
+	if (queue == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+
+	// grid search over the log of the gains
+	double (*points)[MAX_DIMS] = calloc(ngrid,sizeof(*points));
+	double * costs = calloc(ngrid,sizeof(double));
+	for (i = 0; i != ngrid; ++i)
+	{
+		int k = i;
+		for (j = 0; j != dims; ++j)
+		{
+			points[i][j] = grid == 1 ? (lo[j] + hi[j])/2 : lo[j] + (hi[j] - lo[j])*(k % grid)/(grid - 1);
+			k /= grid;
+		}
+	}
+	evaluate(points,ngrid,costs);
+	int best = 0;
+	for (i = 1; i != ngrid; ++i)
+	{
+		best = costs[i] < costs[best] ? i : best;
+	}
+	char text[100];
+	gains_text(points[best],text);
+	fprintf(stderr,"grid: %d candidates, best %s cost %g\n",ngrid,text,costs[best]);
+
+	// Nelder-Mead from the best grid point, with a simplex half a grid step wide.  Every
+	// iteration evaluates the reflected, expanded and both contracted points together.
+	double simplex[MAX_DIMS + 1][MAX_DIMS], fs[MAX_DIMS + 1];
+	for (i = 0; i != dims + 1; ++i)
+	{
+		for (j = 0; j != dims; ++j)
+		{
+			double step = (hi[j] - lo[j])/(grid > 1 ? grid - 1 : 1)/2;
+			simplex[i][j] = points[best][j] + (i == j + 1 ? (points[best][j] + step > hi[j] ? -step : step) : 0);
+		}
+	}
+	evaluate(simplex,dims + 1,fs);
+	simplex_sort(simplex,fs,dims + 1);
+
+	int it = 0;
+	for (it = 0; it != iterations; ++it)
+	{
+		double centroid[MAX_DIMS] = {0}, trial[4][MAX_DIMS], ft[4];
+		static const double coef[4] = {1, 2, 0.5, -0.5}; // reflect, expand, contract outside, inside
+		for (i = 0; i != dims; ++i)
+		{
+			for (j = 0; j != dims; ++j)
+			{
+				centroid[j] += simplex[i][j]/dims;
+			}
+		}
+		for (i = 0; i != 4; ++i)
+		{
+			for (j = 0; j != dims; ++j)
+			{
+				trial[i][j] = centroid[j] + coef[i]*(centroid[j] - simplex[dims][j]);
+			}
+			clamp(trial[i]);
+		}
+		evaluate(trial,4,ft);
+
+		int accept = -1;
+		if (ft[0] < fs[0])
+		{
+			accept = ft[1] < ft[0] ? 1 : 0;
+		}
+		else if (ft[0] < fs[dims - 1])
+		{
+			accept = 0;
+		}
+		else if (ft[0] < fs[dims])
+		{
+			accept = ft[2] <= ft[0] ? 2 : -1;
+		}
+		else
+		{
+			accept = ft[3] < fs[dims] ? 3 : -1;
+		}
+
+		if (accept >= 0)
+		{
+			memcpy(simplex[dims],trial[accept],sizeof(simplex[dims]));
+			fs[dims] = ft[accept];
+		}
+		else // shrink towards the best point
+		{
+			for (i = 1; i != dims + 1; ++i)
+			{
+				for (j = 0; j != dims; ++j)
+				{
+					simplex[i][j] = simplex[0][j] + (simplex[i][j] - simplex[0][j])/2;
+				}
+			}
+			evaluate(simplex + 1,dims,fs + 1);
+		}
+		simplex_sort(simplex,fs,dims + 1);
+		gains_text(simplex[0],text);
+		fprintf(stderr,"iteration %d: best %s cost %g\n",it + 1,text,fs[0]);
+	}
+
+	gains_text(simplex[0],text);
+	printf("%s\n",text);
+	free(points);
+	free(costs);
+	return 0;
+}
+
+static void library(void)
+{
+	if (motion)
+	{
+		// a step, a step back, a smooth half turn and a 1 Hz sine, each 1.5 s
+		static const char * shapes[] = {"step", "step back", "move", "sine"};
+		int k = 0, i = 0, n = MOTION_RATE*3/2;
+		for (k = 0; k != 4; ++k)
+		{
+			struct Experiment * e = &experiments[nexperiments++];
+			e->length = n;
+			for (i = 0; i != n; ++i)
+			{
+				double t = (double)i/MOTION_RATE, s = t < 1 ? t : 1;
+				switch (k)
+				{
+					case 0: e->angles[i] = i < 10 ? 0 : 90; break;
+					case 1: e->angles[i] = i < 10 ? 0 : -45; break;
+					case 2: e->angles[i] = (int)lround(180*s*s*(3 - 2*s)); break;
+					default: e->angles[i] = (int)lround(45*sin(2*M_PI*t)); break;
+				}
+			}
+			fprintf(stderr,"experiment %d: %s\n",k,shapes[k]);
+		}
+	}
+	else
+	{
+		static const char * waves[] = {"square 200 0 50", "sine 300 0 100", "prbs 200 0 4", "chirp 200 0 2500"};
+		int k = 0;
+		for (k = 0; k != 4; ++k)
+		{
+			strcpy(experiments[nexperiments++].wave,waves[k]);
+			fprintf(stderr,"experiment %d: %s\n",k,waves[k]);
+		}
+	}
+}
+
+static int trajectory_load(const char * path)
+{
+	FILE * in = fopen(path,"r");
+	if (!in)
+	{
+		perror(path);
+		return 0;
+	}
+	struct Experiment * e = &experiments[nexperiments];
+	char line[100];
+	e->length = 0;
+	while (fgets(line,sizeof(line),in) && e->length < MAX_TRAJ)
+	{
+		if (sscanf(line,"%d",&e->angles[e->length]) == 1)
+		{
+			++e->length;
+		}
+	}
+	fclose(in);
+	if (e->length == 0)
+	{
+		fprintf(stderr,"%s: no angles\n",path);
+		return 0;
+	}
+	++nexperiments;
+	return 1;
+}
+
+static void gains_text(const double * x, char * buffer)
+{
+	if (dims == 3)
+	{
+		sprintf(buffer,"%ld %ld %ld",lround(exp(x[0])),lround(exp(x[1])),lround(exp(x[2])));
+	}
+	else
+	{
+		sprintf(buffer,"%ld %ld",lround(exp(x[0])),lround(exp(x[1])));
+	}
+}
+
+static double simulate(const struct Job * job)
+{
+	// the same noise for every candidate, so they are compared on equal terms
+	const struct Experiment * e = &experiments[job->experiment];
+	struct Plant m;
+	char text[100];
+	unsigned int samples = 0, rms = 0, iae = 0;
+	int max_error = 0, i = 0;
+	plant_init(&m,&params,seed*MAX_EXPERIMENTS + job->experiment);
+	sim_start(&m);
+	gains_text(job->gains,text);
+
+	if (motion)
+	{
+		if (!motion_gains_sscanf(text))
+		{
+			return HUGE_VAL;	// outside the bounds of the registry
+		}
+		for (i = 0; i != e->length; ++i)
+		{
+			motion_trajectory_set(e->angles[i],i);
+		}
+		motion_trajectory_reset(LAST,0);
+		core_state = TRACK;
+		motion_metrics_begin(e->length + SETTLE);
+		while (!motion_metrics_done())
+		{
+			sim_run(0.01);
+		}
+		motion_metrics_sprintf(text);
+	}
+	else
+	{
+		if (!current_gains_sscanf(text))
+		{
+			return HUGE_VAL;
+		}
+		current_excite_sscanf(e->wave);
+		current_metrics_begin(TUNE_SAMPLES);
+		core_state = TUNE;
+		while (!current_metrics_done())
+		{
+			sim_run(0.01);
+		}
+		current_metrics_sprintf(text);
+	}
+	sscanf(text,"%u %u %d %u",&samples,&rms,&max_error,&iae);
+	return iae;
+}
+
+static void evaluate(double x[][MAX_DIMS], int n, double * cost)
+{
+	int i = 0, k = 0;
+	queue->next = 0;
+	queue->njobs = n*nexperiments;
+	for (i = 0; i != n; ++i)
+	{
+		for (k = 0; k != nexperiments; ++k)
+		{
+			struct Job * job = &queue->jobs[i*nexperiments + k];
+			memcpy(job->gains,x[i],sizeof(job->gains));
+			job->experiment = k;
+			job->cost = HUGE_VAL;	// until a simulation finishes, so one that fails never wins
+		}
+	}
+
+	for (i = 0; i != workers; ++i)
+	{
+		if (fork() == 0)
+		{
+			unsigned int next = 0;
+			while ((next = __atomic_fetch_add(&queue->next,1,__ATOMIC_RELAXED)) < queue->njobs)
+			{
+				pid_t pid = fork();
+				int status = 0;
+				if (pid == 0)
+				{
+					queue->jobs[next].cost = simulate(&queue->jobs[next]);
+					_exit(0);
+				}
+				if (pid < 0 || waitpid(pid,&status,0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				{
+					queue->jobs[next].cost = HUGE_VAL;
+					fprintf(stderr,"job %u failed\n",next);
+				}
+			}
+			_exit(0);
+		}
+	}
+	while (wait(0) > 0)
+	{
+		;
+	}
+
+	for (i = 0; i != n; ++i)
+	{
+		cost[i] = 0;
+		for (k = 0; k != nexperiments; ++k)
+		{
+			cost[i] += queue->jobs[i*nexperiments + k].cost;
+		}
+	}
+}
+
+static void clamp(double * x)
+{
+	int i = 0;
+	for (i = 0; i != dims; ++i)
+	{
+		x[i] = x[i] < lo[i] ? lo[i] : x[i] > hi[i] ? hi[i] : x[i];
+	}
+}
+
+static void simplex_sort(double x[][MAX_DIMS], double * cost, int n)
+{
+	int i = 0, j = 0;
+	for (i = 1; i < n; ++i) // insertion sort, the simplex has at most 4 points
+	{
+		for (j = i; j > 0 && cost[j] < cost[j - 1]; --j)
+		{
+			double t = cost[j];
+			cost[j] = cost[j - 1];
+			cost[j - 1] = t;
+			double p[MAX_DIMS];
+			memcpy(p,x[j],sizeof(p));
+			memcpy(x[j],x[j - 1],sizeof(p));
+			memcpy(x[j - 1],p,sizeof(p));
+		}
+	}
+}
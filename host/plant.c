@@ -0,0 +1,161 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "plant.h"
+
+/// @file plant.c
+/// @brief Implements the DC motor model
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define ENCODER_MID 32768	// core_encoder_reset() sets the count to this value
+#define ADC_MID 512		// ADC count at zero current
+#define ADC_MA 1500		// current in mA at full scale, see current_amps_get()
+
+void plant_defaults(struct PlantParams * p)
+{
+	p->supply = 6.0;
+	p->resistance = 4.0;
+	p->inductance = 0.5e-3;
+	p->kt = 0.0125;
+	p->inertia = 4.0e-6;
+	p->viscous = 1.0e-6;
+	p->coulomb = 1.0e-4;
+	p->counts = 396;
+	p->adc_noise = 0.0;
+}
+
+// name and location of each parameter, for plant_load and plant_save
+static const struct {
+	const char * name;
+	size_t offset;
+} fields[] = {
+	{"supply", offsetof(struct PlantParams,supply)},
+	{"resistance", offsetof(struct PlantParams,resistance)},
+	{"inductance", offsetof(struct PlantParams,inductance)},
+	{"kt", offsetof(struct PlantParams,kt)},
+	{"inertia", offsetof(struct PlantParams,inertia)},
+	{"viscous", offsetof(struct PlantParams,viscous)},
+	{"coulomb", offsetof(struct PlantParams,coulomb)},
+	{"adc_noise", offsetof(struct PlantParams,adc_noise)},
+};
+#define NFIELDS (sizeof(fields)/sizeof(fields[0]))
+
+int plant_load(struct PlantParams * p, const char * path)
+{
+	FILE * in = fopen(path,"r");
+	if (!in)
+	{
+		return 0;
+	}
+
+	char line[200], name[64];
+	double value = 0;
+	while (fgets(line,sizeof(line),in))
+	{
+		if (line[0] == '#' || sscanf(line,"%63s %lf",name,&value) != 2)
+		{
+			continue;
+		}
+
+		size_t i = 0;
+		for (i = 0; i != NFIELDS; ++i)
+		{
+			if (strcmp(name,fields[i].name) == 0)
+			{
+				*(double *)((char *)p + fields[i].offset) = value;
+			}
+		}
+		if (strcmp(name,"counts") == 0)
+		{
+			p->counts = (int)value;
+		}
+	}
+	fclose(in);
+	return 1;
+}
+
+void plant_save(const struct PlantParams * p, FILE * out)
+{
+	size_t i = 0;
+	for (i = 0; i != NFIELDS; ++i)
+	{
+		fprintf(out,"%s %.9g\n",fields[i].name,*(const double *)((const char *)p + fields[i].offset));
+	}
+	fprintf(out,"counts %d\n",p->counts);
+}
+
+void plant_init(struct Plant * m, const struct PlantParams * p, unsigned int seed)
+{
+	memset(m,0,sizeof(*m));
+	m->p = *p;
+	m->rng = seed ? seed : 1;
+}
+
+void plant_step(struct Plant * m, double duty, double dt)
+{
+	const struct PlantParams * p = &m->p;
+	if (duty > 1.0)
+	{
+		duty = 1.0;
+	}
+	else if (duty < -1.0)
+	{
+		duty = -1.0;
+	}
+
+	// electrical: L di/dt = V - R i - kt w, solved exactly for constant V and w
+	double volts = duty*p->supply;
+	double steady = (volts - p->kt*m->speed)/p->resistance;
+	m->current = steady + (m->current - steady)*exp(-dt*p->resistance/p->inductance);
+
+	// mechanical: J dw/dt = kt i - b w - coulomb sign(w)
+	double torque = p->kt*m->current - p->viscous*m->speed;
+	if (m->speed == 0.0 && fabs(torque) <= p->coulomb)
+	{
+		return; // stuck
+	}
+
+	double friction = m->speed > 0 || (m->speed == 0.0 && torque > 0) ? p->coulomb : -p->coulomb;
+	double speed = m->speed + dt*(torque - friction)/p->inertia;
+	if ((speed > 0) != (m->speed > 0) && m->speed != 0.0)
+	{
+		speed = 0.0; // friction stops the motor rather than reversing it
+	}
+	m->angle += 0.5*dt*(speed + m->speed);
+	m->speed = speed;
+}
+
+short plant_adc(struct Plant * m)
+{
+	double adc = ADC_MID + m->current*1000.0*ADC_MID/ADC_MA;
+	if (m->p.adc_noise > 0)
+	{
+		m->rng = m->rng*1664525u + 1013904223u; // numerical recipes lcg
+		adc += m->p.adc_noise*(2.0*(m->rng >> 8)/(double)(1u << 24) - 1.0);
+	}
+
+	adc = floor(adc + 0.5);
+	if (adc < 0)
+	{
+		adc = 0;
+	}
+	else if (adc > 1023)
+	{
+		adc = 1023;
+	}
+	return (short)adc;
+}
+
+int plant_encoder(const struct Plant * m)
+{
+	int count = (int)floor(m->angle*m->p.counts/(2*M_PI));
+	return ENCODER_MID + count - m->encoder_zero;
+}
+
+void plant_encoder_reset(struct Plant * m)
+{
+	m->encoder_zero = (int)floor(m->angle*m->p.counts/(2*M_PI));
+}
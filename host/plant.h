@@ -0,0 +1,65 @@
+#ifndef PLANT_H_
+#define PLANT_H_
+/// @file plant.h
+/// @brief A brushed DC motor driven by an H-bridge, with a current sensor and a quadrature encoder
+///	   Models the hardware the firmware talks to: the PWM duty cycle sets the motor voltage,
+///	   the current is read through the 10 bit ADC and the angle through the encoder counter.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief The physical parameters of the motor and its load (SI units)
+struct PlantParams {
+	double supply;		/// H-bridge supply voltage, V
+	double resistance;	/// armature resistance, ohm
+	double inductance;	/// armature inductance, H
+	double kt;		/// torque constant, N m/A (equal to the back emf constant, V s/rad)
+	double inertia;		/// rotor plus load inertia, kg m^2
+	double viscous;		/// viscous friction, N m s/rad
+	double coulomb;		/// Coulomb friction, N m
+	int counts;		/// encoder counts per revolution
+	double adc_noise;	/// peak current sensor noise, in ADC counts
+};
+
+/// @brief The state of a simulated motor
+struct Plant {
+	struct PlantParams p;
+	double current;		/// armature current, A
+	double speed;		/// rotor speed, rad/s
+	double angle;		/// rotor angle, rad
+	int encoder_zero;	/// the encoder count at the last reset
+	unsigned int rng;	/// state of the noise generator
+};
+
+/// @brief Fills in the parameters of the motor and load used in the lab
+void plant_defaults(struct PlantParams * p);
+
+/// @brief Reads parameters from a file of "name value" lines, such as those written by sysid
+///	   Names match the fields of struct PlantParams. Unknown names and '#' comments are ignored.
+/// @return 1 on success, 0 if the file cannot be opened
+int plant_load(struct PlantParams * p, const char * path);
+
+/// @brief Writes parameters in the format plant_load reads
+void plant_save(const struct PlantParams * p, FILE * out);
+
+/// @brief Puts the motor at rest at angle 0
+/// @param seed Seeds the sensor noise, so runs are repeatable
+void plant_init(struct Plant * m, const struct PlantParams * p, unsigned int seed);
+
+/// @brief Advances the motor
+/// @param duty The H-bridge duty cycle, from -1 to 1
+/// @param dt   The time step, s
+void plant_step(struct Plant * m, double duty, double dt);
+
+/// @brief Samples the current sensor as the ADC would
+/// @return the ADC count, from 0 to 1023
+short plant_adc(struct Plant * m);
+
+/// @brief Reads the encoder counter as core_encoder_read() would
+/// @return the encoder count, 32768 at the last reset
+int plant_encoder(const struct Plant * m);
+
+/// @brief Resets the encoder count to 32768 at the current angle
+void plant_encoder_reset(struct Plant * m);
+
+#endif
@@ -0,0 +1,399 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "NU32.h"
+#include "core.h"
+#include "current.h"
+#include "motion.h"
+#include "streaming.h"
+#include "sched.h"
+#include "excite.h"
+#include "param.h"
+#include "hal.h"
+#include "sim.h"
+
+/// @file regress.c
+/// @brief Runs the control loops through a fixed set of scenarios on the simulated motor and
+///	   compares what they did with golden traces checked in under golden/.
+///	   A trace holds one "r s u duty" line per sample: r, s and u as streaming_write() sends them
+///	   and duty as OC1RS - OC2RS after the tick the sample was taken in.  Current loop scenarios
+///	   take a sample every tick, motion loop scenarios every motion tick.
+///	   Each scenario runs in a fresh fork, so it starts from the same state whatever runs before.
+///
+///	   usage: regress [-d directory] [-t tolerance] [-u] [-p] [scenario]...
+///	   -t allows each value to differ from the golden trace by that much (default 0, bit exact).
+///	   -u writes the golden traces instead of checking them, after a deliberate change.
+///	   -p also prints the wall-clock time the interrupt service routines took on this host.  It
+///	   varies from run to run and is not compared with anything, so it is only a rough guide.
+///	   Without scenarios, all of them run.  The exit status is 0 if every scenario passed.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MAX_SAMPLES 4096	// the most samples of a scenario, BUFFER_SIZE in streaming.c
+#define MOTION_DIVIDER (SCHED_BASE_HZ/MOTION_HZ) // current loop ticks per motion loop tick
+
+/// @brief A scenario: what the loops are asked to do
+struct Scenario {
+	const char * name;
+	const char * about;
+	int motion;		// 1 if the motion loop streams the samples, 0 for the current loop
+	int samples;		// the number of samples
+	void (*run)(void);	// starts the loops and runs the simulation for every sample
+};
+
+/// @brief One sample of a trace
+struct Sample {
+	int r, s, u, duty;
+};
+
+static void tune_square(void);
+static void tune_prbs(void);
+static void hold(void);
+static void go_to(void);
+static void track(void);
+static void queue(void);
+static void pvt(void);
+static void pvt_limits(void);
+static void feedforward(void);
+static void velocity(void);
+
+static const struct Scenario scenarios[] = {
+	{"tune", "TUNE with the default square wave", 0, 1000, tune_square},
+	{"tune_prbs", "TUNE with a pseudo random binary sequence", 0, 2000, tune_prbs},
+	{"hold", "HOLD 90 degrees from rest", 1, 300, hold},
+	{"goto", "HOLD 0 degrees, then go to -135 and to 45", 1, 500, go_to},
+	{"track", "TRACK a smooth move and a sine, then hold the end", 1, 600, track},
+	{"queue", "QUEUE profiled moves, dwells and a trajectory back to back, then hold", 1, 600, queue},
+	{"pvt", "QUEUE PVT segments through waypoints without stopping, then hold", 1, 500, pvt},
+	{"pvt_limits", "QUEUE PVT segments, refusing those that would overshoot the angle range", 1, 400, pvt_limits},
+	{"feedforward", "QUEUE fast profiled moves with velocity and acceleration feedforward", 1, 400, feedforward},
+	{"velocity", "goto with the derivative term on the tracking loop velocity estimate", 1, 500, velocity},
+};
+#define NSCENARIOS (sizeof(scenarios)/sizeof(scenarios[0]))
+
+static struct Sample trace[MAX_SAMPLES];
+static int duties[MAX_SAMPLES];		// the duty of each sample, in the order they were taken
+static int nduties = 0;
+static int motion_scenario = 0;
+static int profile = 0;			// 1 to print the time the interrupts took
+static unsigned long long ticks = 0;	// current loop ticks since the scenario started
+
+/// @brief Records the duty after each tick that takes a sample
+static void record_duty(enum SimVector vector);
+
+/// @brief Runs a scenario and checks or updates its golden trace.  Called in a fresh process.
+/// @return 1 if it passed
+static int scenario_run(const struct Scenario * sc, const char * dir, int tolerance, int update);
+
+/// @brief Streams the samples the loops recorded into trace
+/// @return the number of samples read
+static int trace_collect(int samples);
+
+int main(int argc, char * argv[])
+{
+	const char * dir = "golden";
+	int tolerance = 0, update = 0, opt = 0, failed = 0;
+	size_t i = 0;
+
+	while ((opt = getopt(argc,argv,"d:t:up")) != -1)
+	{
+		switch (opt)
+		{
+			case 'd': dir = optarg; break;
+			case 't': tolerance = atoi(optarg); break;
+			case 'u': update = 1; break;
+			case 'p': profile = 1; break;
+			default:
+				fprintf(stderr,"usage: %s [-d directory] [-t tolerance] [-u] [-p] [scenario]...\n",argv[0]);
+				return 1;
+		}
+	}
+
+	for (i = 0; i != NSCENARIOS; ++i)
+	{
+		int selected = optind == argc, j = 0;
+		for (j = optind; j < argc; ++j)
+		{
+			selected |= strcmp(argv[j],scenarios[i].name) == 0;
+		}
+		if (!selected)
+		{
+			continue;
+		}
+
+		fflush(stdout);
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			int ok = scenario_run(&scenarios[i],dir,tolerance,update);
+			fflush(stdout);
+			_exit(ok ? 0 : 1);
+		}
+		int status = 1;
+		if (pid < 0 || waitpid(pid,&status,0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+		{
+			++failed;
+		}
+	}
+
+	printf("%d failed\n",failed);
+	return failed ? 1 : 0;
+}
+
+static void record_duty(enum SimVector vector)
+{
+	if (vector != SIM_TIMER_1)
+	{
+		return;
+	}
+	if ((!motion_scenario || ticks % MOTION_DIVIDER == 0) && nduties != MAX_SAMPLES)
+	{
+		duties[nduties++] = (int)OC1RS - (int)OC2RS;
+	}
+	++ticks;
+}
+
+static int scenario_run(const struct Scenario * sc, const char * dir, int tolerance, int update)
+{
+	struct Plant m;
+	struct PlantParams p;
+	plant_defaults(&p);
+	plant_init(&m,&p,1);
+	sim_start(&m);
+
+	// the scenario starts on a tick boundary with the scheduler freshly started,
+	// so the motion loop runs on ticks 0, 25, 50...
+	motion_scenario = sc->motion;
+	sim_isr_hook = record_duty;
+	streaming_begin(sc->samples);
+	sc->run();
+	sim_isr_hook = 0;
+	core_state = IDLE;
+
+	int n = trace_collect(sc->samples), i = 0;
+	for (i = 0; i != n; ++i)
+	{
+		trace[i].duty = i < nduties ? duties[i] : 0;
+	}
+
+	char path[300];
+	snprintf(path,sizeof(path),"%s/%s.txt",dir,sc->name);
+	int ok = n == sc->samples, mismatch = -1;
+	if (!ok)
+	{
+		printf("%s: streamed %d of %d samples\n",sc->name,n,sc->samples);
+	}
+	if (update && ok)
+	{
+		FILE * out = fopen(path,"w");
+		if (!out)
+		{
+			perror(path);
+			return 0;
+		}
+		fprintf(out,"# %s: %s\n# r s u duty\n",sc->name,sc->about);
+		for (i = 0; i != n; ++i)
+		{
+			fprintf(out,"%d %d %d %d\n",trace[i].r,trace[i].s,trace[i].u,trace[i].duty);
+		}
+		fclose(out);
+	}
+	else if (ok)
+	{
+		FILE * in = fopen(path,"r");
+		if (!in)
+		{
+			perror(path);
+			return 0;
+		}
+		char line[200];
+		struct Sample g;
+		i = 0;
+		while (fgets(line,sizeof(line),in) && mismatch < 0)
+		{
+			if (line[0] == '#' || sscanf(line,"%d %d %d %d",&g.r,&g.s,&g.u,&g.duty) != 4)
+			{
+				continue;
+			}
+			if (i == n || abs(g.r - trace[i].r) > tolerance || abs(g.s - trace[i].s) > tolerance
+				|| abs(g.u - trace[i].u) > tolerance || abs(g.duty - trace[i].duty) > tolerance)
+			{
+				mismatch = i;
+			}
+			++i;
+		}
+		fclose(in);
+		if (mismatch >= 0 && mismatch < n)
+		{
+			printf("%s: sample %d is %d %d %d %d, golden %d %d %d %d\n",sc->name,mismatch,
+				trace[mismatch].r,trace[mismatch].s,trace[mismatch].u,trace[mismatch].duty,
+				g.r,g.s,g.u,g.duty);
+		}
+		else if (mismatch >= 0 || i != n)
+		{
+			printf("%s: the golden trace has a different number of samples\n",sc->name);
+			mismatch = n;
+		}
+		ok = mismatch < 0;
+	}
+
+	printf("%-12s %-7s %4d samples",sc->name,update ? "updated" : ok ? "pass" : "FAIL",n);
+	if (profile)
+	{
+		const struct SimIsrStats * t1 = &sim_isr_stats[SIM_TIMER_1], * t2 = &sim_isr_stats[SIM_TIMER_2];
+		printf("  host time: tick isr %6.0f ns mean %7.0f max  deferred isr %6.0f ns mean %7.0f max",
+			t1->count ? t1->total/t1->count : 0.0,t1->max,t2->count ? t2->total/t2->count : 0.0,t2->max);
+	}
+	printf("\n");
+	return ok;
+}
+
+static int trace_collect(int samples)
+{
+	char * text = 0;
+	size_t size = 0;
+	hal_uart_out = open_memstream(&text,&size);
+	if (!hal_uart_out)
+	{
+		return 0;
+	}
+	streaming_write();
+	fclose(hal_uart_out);
+	hal_uart_out = 0;
+
+	int n = 0, offset = 0, used = 0;
+	unsigned int count = 0, vars = 0;
+	if (sscanf(text,"%u %u%n",&count,&vars,&offset) == 2)
+	{
+		struct Sample * t = trace;
+		while (n != samples && sscanf(text + offset,"%d %d %d%n",&t->r,&t->s,&t->u,&used) == 3)
+		{
+			offset += used;
+			++n;
+			++t;
+		}
+	}
+	free(text);
+	return n;
+}
+
+static void tune_square(void)
+{
+	current_excite_sscanf("square 200 0 50");
+	core_state = TUNE;
+	sim_run(1000.0/SCHED_BASE_HZ);
+}
+
+static void tune_prbs(void)
+{
+	current_excite_sscanf("prbs 300 0 3");
+	core_state = TUNE;
+	sim_run(2000.0/SCHED_BASE_HZ);
+}
+
+static void hold(void)
+{
+	motion_trajectory_reset(ANGLE,90);
+	core_state = HOLD;
+	sim_run(300.0/MOTION_HZ);
+}
+
+static void go_to(void)
+{
+	motion_trajectory_reset(ANGLE,0);
+	core_state = HOLD;
+	sim_run(50.0/MOTION_HZ);
+	motion_trajectory_reset(ANGLE,-135);
+	sim_run(250.0/MOTION_HZ);
+	motion_trajectory_reset(ANGLE,45);
+	sim_run(200.0/MOTION_HZ);
+}
+
+static void track(void)
+{
+	// a cubic move from 0 to 180 degrees in 1 s, then two periods of a 60 degree, 2 Hz sine
+	int i = 0;
+	for (i = 0; i != 200; ++i)
+	{
+		int x = i*1000/199; // thousandths of the move
+		motion_trajectory_set(180*(3*x*x - 2*x*x*x/1000)/1000000,i);
+	}
+	for (i = 0; i != 200; ++i)
+	{
+		motion_trajectory_set(180 + 60*excite_sine(i*(0xFFFFFFFFu/100))/32768,200 + i);
+	}
+	motion_trajectory_reset(LAST,0);
+	core_state = TRACK;
+	sim_run(600.0/MOTION_HZ);
+}
+
+static void queue(void)
+{
+	// two pick and place cycles between 0 and 120 degrees, a 2 Hz sine, then a triangular move back
+	int i = 0;
+	for (i = 0; i != 100; ++i)
+	{
+		motion_trajectory_set(30*excite_sine(i*(0xFFFFFFFFu/100))/32768,i);
+	}
+	for (i = 0; i != 2; ++i)
+	{
+		motion_queue_goto(120,600,6000);
+		motion_queue_dwell(100);
+		motion_queue_goto(0,600,6000);
+		motion_queue_dwell(100);
+	}
+	motion_queue_trajectory();
+	motion_queue_goto(-45,1000,1000);
+	motion_queue_hold();
+	sim_run(600.0/MOTION_HZ);
+}
+
+static void pvt(void)
+{
+	// out to 90 degrees and on to 180 without stopping, back to -30 through 60, and home
+	motion_queue_pvt(90000,300000,400);
+	motion_queue_pvt(180000,0,400);
+	motion_queue_pvt(60000,-400000,500);
+	motion_queue_pvt(-30000,0,300);
+	motion_queue_pvt(0,0,400);
+	motion_queue_hold();
+	sim_run(500.0/MOTION_HZ);
+}
+
+static void pvt_limits(void)
+{
+	// from rest the first dips to about -14800 degrees on its way back to 0 and the second
+	// is too long, so both are refused; the moves out to 90 and back run
+	int passed = !motion_queue_pvt(0,MOTION_MAX_PVT_SPEED,1000);
+	passed += !motion_queue_pvt(90000,0,MOTION_MAX_PVT_MS + 1);
+	passed += motion_queue_pvt(90000,600000,400) && motion_queue_pvt(0,0,600);
+	motion_queue_hold();
+	if (passed != 3)
+	{
+		printf("pvt_limits: %d of the 3 segments were refused or queued as expected\n",passed);
+	}
+	sim_run(400.0/MOTION_HZ);
+}
+
+static void feedforward(void)
+{
+	// the gains of the nominal motor: inertia, viscous and Coulomb friction over kt, per degree
+	param_set(param_find("m.ka"),"0.0056");
+	param_set(param_find("m.kv"),"0.0014");
+	param_set(param_find("m.kc"),"8");
+	motion_queue_goto(180,1500,30000);
+	motion_queue_dwell(250);
+	motion_queue_goto(0,1500,30000);
+	motion_queue_hold();
+	sim_run(400.0/MOTION_HZ);
+}
+
+static void velocity(void)
+{
+	param_set(param_find("m.vmode"),"2");
+	param_set(param_find("m.vhz"),"20");
+	go_to();
+}
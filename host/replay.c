@@ -0,0 +1,357 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "NU32.h"
+#include "core.h"
+#include "current.h"
+#include "motion.h"
+#include "param.h"
+#include "sched.h"
+#include "streaming.h"
+#include "hal.h"
+#include "sim.h"
+
+/// @file replay.c
+/// @brief Replays the sensor readings of a capture through the control loops and compares what
+///	   they do now with what they did when the capture was taken.
+///	   The capture is the text streaming_write() sends, "samples 3" then "r s u" lines.  Each s
+///	   is turned back into the ADC count (current loop) or the encoder count (motion loop) that
+///	   reads as s, and the loops run open loop on those readings: there is no motor, so a
+///	   different u does not change the next reading.  The replayed r and u are compared with
+///	   the recorded ones; a difference in r means the loops did not start where the capture did.
+///	   Time only advances from tick to tick, so a long capture replays in a fraction of a second.
+///
+///	   The capture must start when the state was entered, as the streaming commands of the menu do:
+///	   -l current replays a TUNE capture, with the tuning wave given by -w as 'i w' reads it;
+///	   -l motion replays a HOLD capture, or a TRACK capture whose reference changes over no more
+///	   samples than a trajectory holds; -l hold replays a HOLD capture during which new angles
+///	   were given, each of which starts the hold afresh as 'm h' does.  -k sets a parameter, such as -k i.kp=120, as the field
+///	   unit had it.  -o writes "r s u replayed_u" for every sample.
+///
+///	   usage: replay [-l current|motion|hold] [-w wave] [-k name=value]... [-t tolerance] [-o output] capture
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define CHUNK 4000		// samples replayed between reads of the stream, less than its buffer
+#define MAX_SETTINGS 32		// the most -k options
+#define MOTION_DIVIDER (SCHED_BASE_HZ/MOTION_HZ) // current loop ticks per motion loop tick
+#define TICK_CLOCKS (HAL_PBCLK/SCHED_BASE_HZ) // bus clocks per current loop tick
+
+/// @brief A sample of the capture, and what the replay made of it
+struct Sample {
+	int r, s, u;		// as recorded
+	int replay_r, replay_u;	// as replayed
+};
+
+/// @brief Finds the ADC count that current_amps_get() reads as amps
+/// @return 1 if there is one, 0 if the nearest count was used
+static int adc_for(int amps, short * adc);
+
+/// @brief Finds the encoder count that motion_angle() reads as angle
+/// @return 1 if there is one, 0 if the nearest count was used
+static int encoder_for(int angle, int * count);
+
+/// @brief Reads the next sample of the capture
+/// @return 1 on success, 0 at the end
+static int sample_read(FILE * in, struct Sample * s);
+
+/// @brief Sets up the reference of a motion capture: HOLD if it never changes, otherwise TRACK
+/// @return 1 on success, 0 if the reference changes over more samples than a trajectory holds
+static int motion_reference(FILE * in);
+
+/// @brief Reads what the loops streamed for the last n samples into the chunk
+/// @return the number of samples read
+static int replay_collect(struct Sample * chunk, int n);
+
+static int motion = 0;		// 1 to replay the motion loop, 0 the current loop
+static int holds = 0;		// 1 if the reference of a HOLD capture changes with new angles
+static int hold_angle = 0;	// the angle HOLD was last given
+
+int main(int argc, char * argv[])
+{
+	const char * wave = 0, * output = 0;
+	const char * settings[MAX_SETTINGS];
+	int nsettings = 0, tolerance = 0, opt = 0, i = 0;
+
+	while ((opt = getopt(argc,argv,"l:w:k:t:o:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'l':
+				holds = strcmp(optarg,"hold") == 0;
+				motion = holds || strcmp(optarg,"motion") == 0;
+				break;
+			case 'w': wave = optarg; break;
+			case 'k':
+				if (nsettings < MAX_SETTINGS)
+				{
+					settings[nsettings++] = optarg;
+				}
+				break;
+			case 't': tolerance = atoi(optarg); break;
+			case 'o': output = optarg; break;
+			default:
+				optind = argc;
+				break;
+		}
+	}
+	if (optind != argc - 1)
+	{
+		fprintf(stderr,"usage: %s [-l current|motion|hold] [-w wave] [-k name=value]... [-t tolerance] "
+			"[-o output] capture\n",argv[0]);
+		return 1;
+	}
+
+	FILE * in = fopen(argv[optind],"r");
+	FILE * out = output ? fopen(output,"w") : 0;
+	if (!in || (output && !out))
+	{
+		perror(!in ? argv[optind] : output);
+		return 1;
+	}
+
+	sim_start(0);
+	for (i = 0; i != nsettings; ++i)
+	{
+		char name[64];
+		const char * value = strchr(settings[i],'=');
+		int length = value ? value - settings[i] : 0;
+		if (!value || length >= (int)sizeof(name))
+		{
+			fprintf(stderr,"%s: not name=value\n",settings[i]);
+			return 1;
+		}
+		memcpy(name,settings[i],length);
+		name[length] = '\0';
+		if (!param_set(param_find(name),value + 1))
+		{
+			fprintf(stderr,"%s: no such parameter or invalid value\n",settings[i]);
+			return 1;
+		}
+	}
+	if (motion && !motion_reference(in))
+	{
+		fprintf(stderr,"the reference changes over more samples than a trajectory holds\n");
+		return 1;
+	}
+	if (!motion)
+	{
+		if (wave && !current_excite_sscanf(wave))
+		{
+			fprintf(stderr,"%s: invalid tuning wave\n",wave);
+			return 1;
+		}
+		core_state = TUNE;
+	}
+
+	// the loops start on tick 0, which is a motion tick
+	static struct Sample chunk[CHUNK];
+	long samples = 0, r_differ = 0, u_differ = 0, unreadable = 0, first = -1;
+	double sum2 = 0, largest = 0;
+	int n = 0, more = 1;
+	clock_t start = clock();
+	while (more)
+	{
+		for (n = 0; n != CHUNK && (more = sample_read(in,&chunk[n])); ++n)
+		{
+			;
+		}
+		if (n == 0)
+		{
+			break;
+		}
+
+		streaming_begin(n);
+		for (i = 0; i != n; ++i)
+		{
+			if (holds && chunk[i].r != hold_angle)
+			{
+				hold_angle = chunk[i].r;
+				motion_trajectory_reset(ANGLE,hold_angle);
+			}
+			int ok = motion ? encoder_for(chunk[i].s,&hal_encoder) : adc_for(chunk[i].s,&hal_adc);
+			unreadable += !ok;
+			sim_advance(motion ? MOTION_DIVIDER*TICK_CLOCKS : TICK_CLOCKS);
+		}
+		if (replay_collect(chunk,n) != n)
+		{
+			fprintf(stderr,"the loops streamed fewer samples than were replayed\n");
+			return 1;
+		}
+
+		for (i = 0; i != n; ++i)
+		{
+			const struct Sample * s = &chunk[i];
+			int du = s->replay_u - s->u;
+			if (abs(s->replay_r - s->r) > tolerance)
+			{
+				++r_differ;
+			}
+			if (abs(du) > tolerance)
+			{
+				++u_differ;
+				first = first < 0 ? samples + i : first;
+			}
+			sum2 += (double)du*du;
+			largest = abs(du) > largest ? abs(du) : largest;
+			if (out)
+			{
+				fprintf(out,"%d %d %d %d\n",s->r,s->s,s->u,s->replay_u);
+			}
+		}
+		samples += n;
+	}
+	double elapsed = (double)(clock() - start)/CLOCKS_PER_SEC;
+	core_state = IDLE;
+
+	double rate = motion ? SCHED_BASE_HZ/MOTION_DIVIDER : SCHED_BASE_HZ;
+	printf("samples %ld reference_differs %ld u_differs %ld first %ld max_du %g rms_du %g unreadable %ld\n",
+		samples,r_differ,u_differ,first,largest,samples ? sqrt(sum2/samples) : 0.0,unreadable);
+	fprintf(stderr,"replayed %.1f s of capture in %.3f s\n",samples/rate,elapsed);
+	if (out)
+	{
+		fclose(out);
+	}
+	fclose(in);
+	return r_differ || u_differ ? 1 : 0;
+}
+
+static int adc_for(int amps, short * adc)
+{
+	// current_amps_get() truncates, so amps is read from at most a couple of counts
+	int guess = 512 + (int)floor(amps*512/1500.0), count = 0, best = guess, best_error = 1 << 30;
+	for (count = guess - 2; count <= guess + 2; ++count)
+	{
+		short read = 1500*(((float)(count - 512))/512);
+		if (read == amps && count >= 0 && count <= 1023)
+		{
+			*adc = count;
+			return 1;
+		}
+		if (abs(read - amps) < best_error)
+		{
+			best = count;
+			best_error = abs(read - amps);
+		}
+	}
+	*adc = best < 0 ? 0 : best > 1023 ? 1023 : best;
+	return 0;
+}
+
+static int encoder_for(int angle, int * count)
+{
+	int guess = angle*396/360, c = 0, best = guess, best_error = 1 << 30;
+	for (c = guess - 2; c <= guess + 2; ++c)
+	{
+		int read = c*360/396; // motion_angle()
+		if (read == angle)
+		{
+			*count = 32768 + c;
+			return 1;
+		}
+		if (abs(read - angle) < best_error)
+		{
+			best = c;
+			best_error = abs(read - angle);
+		}
+	}
+	*count = 32768 + best;
+	return 0;
+}
+
+static int sample_read(FILE * in, struct Sample * s)
+{
+	char line[200];
+	while (fgets(line,sizeof(line),in))
+	{
+		char * p = line, * end = 0;
+		s->r = (int)strtol(p,&end,10);
+		s->s = (int)strtol(end,&p,10);
+		s->u = (int)strtol(p,&end,10);
+		if (end != p && line[0] != '#')
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int motion_reference(FILE * in)
+{
+	struct Sample s;
+	long n = 0, last_change = 0;
+	int first = 0, previous = 0;
+	while (sample_read(in,&s))
+	{
+		if (n == 0)
+		{
+			first = s.r;
+		}
+		else if (s.r != previous)
+		{
+			last_change = n;
+		}
+		previous = s.r;
+		++n;
+	}
+	rewind(in);
+
+	if (last_change == 0 || holds)
+	{
+		hold_angle = first;
+		motion_trajectory_reset(ANGLE,first);
+		core_state = HOLD;
+		return 1;
+	}
+
+	// TRACK follows the trajectory and then holds its last angle
+	long i = 0;
+	for (i = 0; i <= last_change && sample_read(in,&s); ++i)
+	{
+		if (!motion_trajectory_set(s.r,i))
+		{
+			return 0;
+		}
+	}
+	rewind(in);
+	motion_trajectory_reset(LAST,0);
+	core_state = TRACK;
+	return 1;
+}
+
+static int replay_collect(struct Sample * chunk, int n)
+{
+	char * text = 0;
+	size_t size = 0;
+	hal_uart_out = open_memstream(&text,&size);
+	if (!hal_uart_out)
+	{
+		return 0;
+	}
+	streaming_write();
+	fclose(hal_uart_out);
+	hal_uart_out = 0;
+
+	// strtol rather than sscanf, which measures the rest of the text on every call
+	int i = 0;
+	char * p = text, * end = 0;
+	strtoul(p,&end,10);
+	strtoul(end,&p,10);		// the sample count and the number of variables
+	for (i = 0; i != n; ++i)
+	{
+		chunk[i].replay_r = (int)strtol(p,&end,10);
+		strtol(end,&p,10);	// s, which the replay gave the loops
+		chunk[i].replay_u = (int)strtol(p,&end,10);
+		if (end == p)
+		{
+			break;
+		}
+		p = end;
+	}
+	free(text);
+	return i;
+}
@@ -0,0 +1,197 @@
+#include <string.h>
+#include <time.h>
+#include "NU32.h"
+#include "core.h"
+#include "current.h"
+#include "motion.h"
+#include "hal.h"
+#include "sim.h"
+
+/// @file sim.c
+/// @brief Implements the interrupt scheduler and the motor integration
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define STEP 160	// the motor integration step, in bus clocks (2 us)
+
+void Sched_Tick_Interrupt(void);
+void Sched_Deferred_Interrupt(void);
+
+void (*sim_isr_hook)(enum SimVector vector) = 0;
+struct SimIsrStats sim_isr_stats[2];
+
+// when the timers next expire, in bus clocks. 0 means the timer is off
+static unsigned long long t1_due = 0, t2_due = 0;
+
+/// @brief The period of timer 1 (a type A timer), in bus clocks
+static unsigned long long timer1_period(void);
+
+/// @brief The period of timer 2 (a type B timer), in bus clocks
+static unsigned long long timer2_period(void);
+
+/// @brief Runs pending, enabled interrupts in priority order
+static void dispatch(void);
+
+/// @brief Integrates the motor up to the given time
+static void integrate(unsigned long long until);
+
+/// @brief Runs an interrupt service routine and accounts for its time
+static void run_isr(enum SimVector vector, void (*isr)(void));
+
+void sim_start(struct Plant * m)
+{
+	hal_reset(m);
+	t1_due = t2_due = 0;
+	sim_stats_reset();
+	INTDisableInterrupts();
+	core_init();
+	current_init();
+	motion_init();
+	INTEnableSystemMultiVectoredInt();
+}
+
+void sim_advance(unsigned long long clocks)
+{
+	unsigned long long end = hal_clock + clocks;
+	while (hal_clock < end)
+	{
+		// timers that were just turned on start counting now
+		if (!T1CONbits.ON)
+		{
+			t1_due = 0;
+		}
+		else if (!t1_due)
+		{
+			t1_due = hal_clock + timer1_period();
+		}
+		if (!T2CONbits.ON)
+		{
+			t2_due = 0;
+		}
+		else if (!t2_due)
+		{
+			t2_due = hal_clock + timer2_period();
+		}
+
+		unsigned long long next = end;
+		if (t1_due && t1_due < next)
+		{
+			next = t1_due;
+		}
+		if (t2_due && t2_due < next)
+		{
+			next = t2_due;
+		}
+
+		integrate(next);
+		if (t1_due == hal_clock)
+		{
+			IFS0bits.T1IF = 1;
+			t1_due += timer1_period();
+		}
+		if (t2_due == hal_clock)
+		{
+			IFS0bits.T2IF = 1;
+			t2_due += timer2_period();
+		}
+		dispatch();
+	}
+}
+
+void sim_run(double seconds)
+{
+	sim_advance((unsigned long long)(seconds*HAL_PBCLK + 0.5));
+}
+
+void sim_stats_reset(void)
+{
+	memset(sim_isr_stats,0,sizeof(sim_isr_stats));
+}
+
+double sim_duty(void)
+{
+	if (PR3 == 0)
+	{
+		return 0.0;
+	}
+	return ((double)OC1RS - (double)OC2RS)/(PR3 + 1);
+}
+
+static unsigned long long timer1_period(void)
+{
+	static const unsigned int prescale[] = {1, 8, 64, 256};
+	return (unsigned long long)(PR1 + 1)*prescale[T1CONbits.TCKPS & 3];
+}
+
+static unsigned long long timer2_period(void)
+{
+	static const unsigned int prescale[] = {1, 2, 4, 8, 16, 32, 64, 256};
+	return (unsigned long long)(PR2 + 1)*prescale[T2CONbits.TCKPS & 7];
+}
+
+static void dispatch(void)
+{
+	// run the highest priority pending interrupt until none are left. An interrupt that does
+	// not clear its flag runs once per call, the next timer event runs it again
+	int ran_t1 = 0, ran_t2 = 0;
+	while (!hal_interrupts_off)
+	{
+		hal_latch();
+		int t1 = !ran_t1 && IFS0bits.T1IF && IEC0bits.T1IE;
+		int t2 = !ran_t2 && IFS0bits.T2IF && IEC0bits.T2IE;
+		if (t1 && (!t2 || IPC1bits.T1IP >= IPC2bits.T2IP))
+		{
+			run_isr(SIM_TIMER_1,Sched_Tick_Interrupt);
+			ran_t1 = 1;
+			hal_latch();
+			if (sim_isr_hook)
+			{
+				sim_isr_hook(SIM_TIMER_1);
+			}
+		}
+		else if (t2)
+		{
+			run_isr(SIM_TIMER_2,Sched_Deferred_Interrupt);
+			ran_t2 = 1;
+			hal_latch();
+			if (sim_isr_hook)
+			{
+				sim_isr_hook(SIM_TIMER_2);
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+}
+
+static void integrate(unsigned long long until)
+{
+	if (!hal_plant)
+	{
+		hal_clock = until; // replaying recorded readings, there is no motor to integrate
+		return;
+	}
+	while (hal_clock < until)
+	{
+		unsigned long long step = until - hal_clock < STEP ? until - hal_clock : STEP;
+		plant_step(hal_plant,sim_duty(),(double)step/HAL_PBCLK);
+		hal_clock += step;
+	}
+}
+
+static void run_isr(enum SimVector vector, void (*isr)(void))
+{
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC,&start);
+	isr();
+	clock_gettime(CLOCK_MONOTONIC,&end);
+
+	struct SimIsrStats * stats = &sim_isr_stats[vector];
+	double ns = (end.tv_sec - start.tv_sec)*1e9 + (end.tv_nsec - start.tv_nsec);
+	++stats->count;
+	stats->total += ns;
+	stats->max = ns > stats->max ? ns : stats->max;
+}
@@ -0,0 +1,56 @@
+#ifndef SIM_H_
+#define SIM_H_
+/// @file sim.h
+/// @brief Runs the firmware interrupts against a simulated motor
+///	   The interrupt scheduler follows the timer registers the firmware programs:
+///	   when a timer period elapses its interrupt flag is set, and pending interrupts, including
+///	   those raised in software, are dispatched in priority order like the PIC32
+///	   multi-vectored interrupt controller does.
+///	   Interrupt service routines run to completion instantly; the motor is integrated
+///	   between them using the duty cycle in OC1RS and OC2RS.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#include "plant.h"
+
+/// @brief The interrupt vectors the simulator dispatches
+enum SimVector {
+	SIM_TIMER_1,	/// Sched_Tick_Interrupt, which runs the current loop
+	SIM_TIMER_2	/// Sched_Deferred_Interrupt, which runs the motion loop
+};
+
+/// @brief If set, called after every interrupt service routine with its vector
+extern void (*sim_isr_hook)(enum SimVector vector);
+
+/// @brief How long the interrupt service routines of a vector took on the host
+struct SimIsrStats {
+	unsigned long long count;	/// the number of times the routine ran
+	double total, max;		/// the total and the longest time it took, ns
+};
+
+/// @brief The time spent in each vector, since sim_start() or the last sim_stats_reset().
+///	   The simulated clock does not advance while a routine runs, so this is the only
+///	   measure of the cost of the control code.
+extern struct SimIsrStats sim_isr_stats[2];
+
+/// @brief Clears sim_isr_stats
+void sim_stats_reset(void);
+
+/// @brief Resets the hardware, attaches it to the motor and initializes the firmware modules
+///	   the same way main() does, leaving core_state IDLE.
+///	   If m is 0 the sensors read hal_adc and hal_encoder and time passes without a motor.
+void sim_start(struct Plant * m);
+
+/// @brief Advances the simulation, running interrupts as they come due
+/// @param clocks The time to advance, in peripheral bus clock ticks (HAL_PBCLK per second)
+void sim_advance(unsigned long long clocks);
+
+/// @brief Advances the simulation
+/// @param seconds The time to advance
+void sim_run(double seconds);
+
+/// @brief The H-bridge duty cycle the firmware currently outputs, from -1 to 1
+double sim_duty(void);
+
+#endif
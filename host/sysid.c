@@ -0,0 +1,451 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "plant.h"
+
+/// @file sysid.c
+/// @brief Fits models of the motor to data captured with streaming_write() and writes the
+///	   parameters in the format plant_load() reads, so the simulator can run the motor on the bench.
+///	   A capture is the text the firmware sends: a "samples 3" header, then one "r s u" line per
+///	   sample.  Several captures may follow each other in one file.
+///	   Current loop captures (TUNE, -e) give the electrical models, with s the current in mA
+///	   and u the control effort the current loop sets the PWM from:
+///	     e1: L di/dt = V - R i, the back emf neglected, giving R and L;
+///	     e2: the same with the back emf of the rotor it drives, giving R, L, kt^2/J and b/J.
+///	   Motion loop captures (HOLD or TRACK, -m) give the mechanical models, with s the angle
+///	   in degrees and u the current reference in mA, which the current loop is assumed to follow:
+///	     m1: J dw/dt = kt i - b w with the speed taken as constant over a sample, giving kt/J and b/J;
+///	     m2: the same from the current to the angle, exact for a current held over each sample,
+///		 plus Coulomb friction, giving kt/J, b/J and coulomb/J.
+///	   Samples where the reference exceeds the range of the current sensor, or the rotor is
+///	   held by friction, are left out.  A capture of a trajectory (TRACK) with large, varied
+///	   moves identifies the rotor far better than one of HOLD.
+///	   Each model is an ARX model fitted by least squares.  The samples are folded into the
+///	   triangular factor of a QR decomposition as they are read, so memory does not grow with the
+///	   length of a capture.  The discrete model is then mapped back to the physical parameters.
+///	   Parameters no capture determines, such as the supply voltage, the torque constant and the
+///	   encoder counts, come from the base parameters (-p, or the defaults).
+///
+///	   usage: sysid [-p base] [-o output] [-e capture]... [-m capture]... [-E hz] [-M hz]
+///	   -E and -M are the current and motion loop rates, 5000 and 200 Hz by default.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MAX_REGRESSORS 5	// the most regressors of a model
+#define MAX_FILES 16		// the most captures of each kind
+#define FULL_DUTY 1999		// as current.c
+#define MAX_AMPS 2000		// the largest current reference, as current_amps_set()
+#define SENSOR_AMPS 1.5		// the full scale of the current sensor, see current_amps_get()
+
+/// @brief A least squares fit, accumulated one sample at a time
+struct Lsq {
+	int p;						// the number of regressors
+	double r[MAX_REGRESSORS + 1][MAX_REGRESSORS + 1]; // R of the QR decomposition of [X y]
+	long n;						// the number of samples
+	double sum, sum2;				// the sum of y and of y^2
+};
+
+/// @brief The samples a model needs: the latest three of the current capture
+struct History {
+	int n;			// samples in this capture so far, up to 3
+	double y[3], u[3];	// the sensor and the input, [2] the latest
+};
+
+/// @brief Starts a fit with p regressors
+static void lsq_init(struct Lsq * l, int p);
+
+/// @brief Adds a sample: y = theta . x + error
+static void lsq_add(struct Lsq * l, const double * x, double y);
+
+/// @brief Solves for the coefficients
+/// @param theta [out] The coefficients
+/// @param fit   [out] The fraction of the variance of y the model explains
+/// @return 1 on success, 0 if the inputs did not excite every regressor
+static int lsq_solve(const struct Lsq * l, double * theta, double * fit);
+
+/// @brief Reads a capture, calling sample() for each line of it
+/// @return 1 on success, 0 if the file cannot be opened
+static int capture_read(const char * path, void (*sample)(int start, int r, int s, int u));
+
+/// @brief Adds a sample of a current loop capture to the electrical fits
+static void electrical_sample(int start, int r, int s, int u);
+
+/// @brief Adds a sample of a motion loop capture to the mechanical fits
+static void mechanical_sample(int start, int r, int s, int u);
+
+/// @brief Pushes a sample into a history
+static void history_push(struct History * h, int start, double y, double u);
+
+static struct PlantParams base;
+static double te = 1.0/5000, tm = 1.0/200;	// the sample periods
+static struct History he, hm;
+static struct Lsq e1, e2, m1, m2;
+
+int main(int argc, char * argv[])
+{
+	const char * electrical[MAX_FILES], * mechanical[MAX_FILES];
+	const char * base_path = 0, * output = 0;
+	int ne = 0, nm = 0, opt = 0, i = 0;
+
+	while ((opt = getopt(argc,argv,"p:o:e:m:E:M:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'p': base_path = optarg; break;
+			case 'o': output = optarg; break;
+			case 'e':
+				if (ne < MAX_FILES)
+				{
+					electrical[ne++] = optarg;
+				}
+				break;
+			case 'm':
+				if (nm < MAX_FILES)
+				{
+					mechanical[nm++] = optarg;
+				}
+				break;
+			case 'E': te = 1.0/atof(optarg); break;
+			case 'M': tm = 1.0/atof(optarg); break;
+			default:
+				fprintf(stderr,"usage: %s [-p base] [-o output] [-e capture]... [-m capture]... "
+					"[-E hz] [-M hz]\n",argv[0]);
+				return 1;
+		}
+	}
+	if (!ne && !nm)
+	{
+		fprintf(stderr,"nothing to fit: give current loop (-e) or motion loop (-m) captures\n");
+		return 1;
+	}
+
+	plant_defaults(&base);
+	if (base_path && !plant_load(&base,base_path))
+	{
+		perror(base_path);
+		return 1;
+	}
+
+	lsq_init(&e1,3);
+	lsq_init(&e2,5);
+	lsq_init(&m1,2);
+	lsq_init(&m2,4);
+	for (i = 0; i != ne; ++i)
+	{
+		if (!capture_read(electrical[i],electrical_sample))
+		{
+			return 1;
+		}
+	}
+	for (i = 0; i != nm; ++i)
+	{
+		if (!capture_read(mechanical[i],mechanical_sample))
+		{
+			return 1;
+		}
+	}
+
+	struct PlantParams p = base;
+	double theta[MAX_REGRESSORS], fit = 0;
+	char notes[4][200];
+	int have_r = 0, have_e2 = 0, have_m = 0;
+	double kt2_j = 0, b_j = 0, kt_j = 0, mb_j = 0, c_j = 0;
+	memset(notes,0,sizeof(notes));
+
+	// e1: i[k+1] = a i[k] + b V[k] + c, with a = exp(-T R/L) and b = (1 - a)/R
+	if (ne && lsq_solve(&e1,theta,&fit) && theta[0] > 0 && theta[0] < 1 && theta[1] > 0)
+	{
+		double a = theta[0], r = (1 - a)/theta[1];
+		p.resistance = r;
+		p.inductance = -te*r/log(a);
+		have_r = 1;
+		sprintf(notes[0],"e1 samples %ld fit %.4f resistance %g inductance %g",e1.n,fit,
+			p.resistance,p.inductance);
+	}
+	else if (ne)
+	{
+		sprintf(notes[0],"e1 samples %ld failed",e1.n);
+	}
+
+	// e2: i[k+1] = a1 i[k] + a2 i[k-1] + b1 V[k] + b2 V[k-1] + c, the zero order hold equivalent of
+	// I/V = (s + b/J)/(L (s - p1)(s - p2)).  The residues of the discrete poles give L and b/J,
+	// the sum and product of the poles then give R and kt^2/J
+	double disc = 0;
+	if (ne && lsq_solve(&e2,theta,&fit) && (disc = theta[0]*theta[0] + 4*theta[1]) > 0)
+	{
+		double z[2] = {(theta[0] + sqrt(disc))/2, (theta[0] - sqrt(disc))/2}, s[2], m[2];
+		int ok = z[0] > 0 && z[0] < 1 && z[1] > 0 && z[1] < 1;
+		for (i = 0; ok && i != 2; ++i)
+		{
+			double g = (theta[2]*z[i] + theta[3])/(z[i] - z[1 - i]);
+			s[i] = log(z[i])/te;
+			m[i] = g/(z[i] - 1); // the residue of G(s)/s at s[i]
+		}
+		if (ok)
+		{
+			// the residue is (s[i] + b/J)/(L s[i] (s[i] - s[j])), linear in L and b/J
+			m[0] *= s[0]*(s[0] - s[1]);
+			m[1] *= s[1]*(s[1] - s[0]);
+			double l = (s[0] - s[1])/(m[0] - m[1]);
+			double beta = l*m[0] - s[0];
+			double r = -l*(s[0] + s[1]) - l*beta;
+			double kappa = l*s[0]*s[1] - r*beta;
+			ok = l > 0 && r > 0 && kappa > 0 && beta >= 0;
+			if (ok)
+			{
+				p.resistance = r;
+				p.inductance = l;
+				kt2_j = kappa;
+				b_j = beta;
+				have_r = have_e2 = 1;
+			}
+		}
+		if (ok)
+		{
+			sprintf(notes[1],"e2 samples %ld fit %.4f resistance %g inductance %g kt^2/J %g b/J %g",
+				e2.n,fit,p.resistance,p.inductance,kt2_j,b_j);
+		}
+	}
+	if (ne && !have_e2)
+	{
+		sprintf(notes[1],"e2 samples %ld failed",e2.n);
+	}
+
+	// m1: d[k+1] = a d[k] + b i[k], d the angle moved over a sample.  a = exp(-T b/J) and
+	// b = T (1 - a) (kt/J)/(b/J), where -ln(a)/(1 - a) tends to 1 as the friction vanishes
+	if (nm && lsq_solve(&m1,theta,&fit) && theta[0] > 0 && theta[0] <= 1 && theta[1] > 0)
+	{
+		double a = theta[0], ratio = a < 1 ? -log(a)/(1 - a) : 1;
+		kt_j = ratio*theta[1]/(tm*tm);
+		mb_j = -log(a)/tm;
+		have_m = 1;
+		sprintf(notes[2],"m1 samples %ld fit %.4f kt/J %g b/J %g",m1.n,fit,kt_j,mb_j);
+	}
+	else if (nm)
+	{
+		sprintf(notes[2],"m1 samples %ld failed",m1.n);
+	}
+
+	// m2: d[k+1] = a d[k] + b1 i[k] + b2 i[k-1] + c sign(d[k]).  The steady state gain of the
+	// two input taps is that of b in m1, and the friction acts like a constant current.
+	// In a capture of a closed loop the second tap is nearly a combination of the angles the
+	// controller saw, which makes b1 + b2 sensitive to the encoder quantisation, so m1 gives
+	// kt/J and b/J when it can and m2 adds the friction
+	if (nm && lsq_solve(&m2,theta,&fit) && theta[0] > 0 && theta[0] <= 1 && theta[1] + theta[2] > 0)
+	{
+		double a = theta[0], ratio = a < 1 ? -log(a)/(1 - a) : 1;
+		double kt_j2 = ratio*(theta[1] + theta[2])/(tm*tm), mb_j2 = -log(a)/tm;
+		c_j = theta[3] < 0 ? -ratio*theta[3]/(tm*tm) : 0;
+		if (!have_m)
+		{
+			kt_j = kt_j2;
+			mb_j = mb_j2;
+			have_m = 1;
+		}
+		sprintf(notes[3],"m2 samples %ld fit %.4f kt/J %g b/J %g coulomb/J %g",m2.n,fit,kt_j2,mb_j2,c_j);
+	}
+	else if (nm)
+	{
+		sprintf(notes[3],"m2 samples %ld failed",m2.n);
+	}
+
+	// The fits only see kt through kt/J or kt^2/J, so kt comes from the base parameters (the data
+	// sheet) and sets the scale of J.  The mechanical fits see the rotor directly; in e2 it is a
+	// small effect on the current, which friction and sensor noise easily swamp
+	if (have_m)
+	{
+		p.inertia = p.kt/kt_j;
+	}
+	else if (have_e2)
+	{
+		p.inertia = p.kt*p.kt/kt2_j;
+	}
+	if (have_m)
+	{
+		p.viscous = mb_j*p.inertia;
+		p.coulomb = c_j*p.inertia;
+	}
+	else if (have_e2)
+	{
+		p.viscous = b_j*p.inertia;
+	}
+
+	FILE * out = output ? fopen(output,"w") : stdout;
+	if (!out)
+	{
+		perror(output);
+		return 1;
+	}
+	fprintf(out,"# sysid\n");
+	for (i = 0; i != 4; ++i)
+	{
+		if (notes[i][0])
+		{
+			fprintf(stderr,"%s\n",notes[i]);
+			fprintf(out,"# %s\n",notes[i]);
+		}
+	}
+	plant_save(&p,out);
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+	return have_r || have_m ? 0 : 1;
+}
+
+static void lsq_init(struct Lsq * l, int p)
+{
+	memset(l,0,sizeof(*l));
+	l->p = p;
+}
+
+static void lsq_add(struct Lsq * l, const double * x, double y)
+{
+	// rotate the row [x y] into R, one Givens rotation per column
+	double v[MAX_REGRESSORS + 1];
+	int j = 0, k = 0;
+	memcpy(v,x,l->p*sizeof(double));
+	v[l->p] = y;
+	for (j = 0; j != l->p; ++j)
+	{
+		if (v[j] == 0.0)
+		{
+			continue;
+		}
+		double h = hypot(l->r[j][j],v[j]), c = l->r[j][j]/h, s = v[j]/h;
+		l->r[j][j] = h;
+		for (k = j + 1; k <= l->p; ++k)
+		{
+			double t = c*l->r[j][k] + s*v[k];
+			v[k] = c*v[k] - s*l->r[j][k];
+			l->r[j][k] = t;
+		}
+	}
+	l->r[l->p][l->p] = hypot(l->r[l->p][l->p],v[l->p]); // the norm of the residual
+	++l->n;
+	l->sum += y;
+	l->sum2 += y*y;
+}
+
+static int lsq_solve(const struct Lsq * l, double * theta, double * fit)
+{
+	double largest = 0;
+	int j = 0, k = 0;
+	for (j = 0; j != l->p; ++j)
+	{
+		largest = fabs(l->r[j][j]) > largest ? fabs(l->r[j][j]) : largest;
+	}
+	if (l->n <= l->p || largest == 0.0)
+	{
+		return 0;
+	}
+
+	for (j = l->p - 1; j >= 0; --j)
+	{
+		if (fabs(l->r[j][j]) < 1e-12*largest)
+		{
+			return 0; // this regressor never varied independently of the others
+		}
+		double t = l->r[j][l->p];
+		for (k = j + 1; k != l->p; ++k)
+		{
+			t -= l->r[j][k]*theta[k];
+		}
+		theta[j] = t/l->r[j][j];
+	}
+
+	double variance = l->sum2 - l->sum*l->sum/l->n;
+	double residual = l->r[l->p][l->p]*l->r[l->p][l->p];
+	*fit = variance > 0 ? 1 - residual/variance : 0;
+	return 1;
+}
+
+static int capture_read(const char * path, void (*sample)(int start, int r, int s, int u))
+{
+	FILE * in = fopen(path,"r");
+	if (!in)
+	{
+		perror(path);
+		return 0;
+	}
+
+	char line[200];
+	int start = 1, r = 0, s = 0, u = 0;
+	while (fgets(line,sizeof(line),in))
+	{
+		int fields = sscanf(line,"%d %d %d",&r,&s,&u);
+		if (fields == 2)
+		{
+			start = 1; // the header of the next capture: its first sample does not follow on
+		}
+		else if (fields == 3)
+		{
+			sample(start,r,s,u);
+			start = 0;
+		}
+	}
+	fclose(in);
+	return 1;
+}
+
+static void history_push(struct History * h, int start, double y, double u)
+{
+	if (start)
+	{
+		h->n = 0;
+	}
+	h->y[0] = h->y[1];
+	h->y[1] = h->y[2];
+	h->y[2] = y;
+	h->u[0] = h->u[1];
+	h->u[1] = h->u[2];
+	h->u[2] = u;
+	h->n = h->n < 3 ? h->n + 1 : 3;
+}
+
+static void electrical_sample(int start, int r, int s, int u)
+{
+	// the voltage the current loop applies over the next sample, as set_u() and the PWM compute it
+	int newu = u >= 2000 ? FULL_DUTY : u <= -2000 ? -FULL_DUTY : u;
+	double volts = ((FULL_DUTY*newu)/2000)/(FULL_DUTY + 1.0)*base.supply;
+	(void)r;
+
+	history_push(&he,start,s/1000.0,volts);
+	if (he.n >= 2)
+	{
+		double x[] = {he.y[1], he.u[1], 1};
+		lsq_add(&e1,x,he.y[2]);
+	}
+	if (he.n == 3)
+	{
+		double x[] = {he.y[1], he.y[0], he.u[1], he.u[0], 1};
+		lsq_add(&e2,x,he.y[2]);
+	}
+}
+
+static void mechanical_sample(int start, int r, int s, int u)
+{
+	double amps = (u > MAX_AMPS ? MAX_AMPS : u < -MAX_AMPS ? -MAX_AMPS : u)/1000.0;
+	(void)r;
+
+	history_push(&hm,start,s*M_PI/180,amps);
+	if (hm.n == 3)
+	{
+		double d0 = hm.y[1] - hm.y[0], d1 = hm.y[2] - hm.y[1];
+		if (d0 == 0.0 && d1 == 0.0)
+		{
+			return; // a rotor held by friction tells nothing about its inertia
+		}
+		if (fabs(hm.u[1]) > SENSOR_AMPS || fabs(hm.u[0]) > SENSOR_AMPS)
+		{
+			return; // the current loop cannot follow a reference beyond the range of its sensor
+		}
+		double x1[] = {d0, hm.u[1]};
+		double x2[] = {d0, hm.u[1], hm.u[0], (d0 > 0) - (d0 < 0)};
+		lsq_add(&m1,x1,d1);
+		lsq_add(&m2,x2,d1);
+	}
+}
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+#include "command.h"
+
+/// @file trace_decode.c
+/// @brief Renders an event trace dumped by the diagnostic menu ('d' 'v') as a timeline
+///	   Reads the dump from stdin, or from the file given as the only argument.
+///	   Times are in ms since the oldest entry.  The core timer wraps every 107 s, so
+///	   gaps longer than that between two entries cannot be told apart from shorter ones.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define CORE_HZ 40000000.0	// the core timer frequency
+
+static const char * states[] = {"IDLE", "PWM", "TUNE", "TRACK", "HOLD", "QUEUE"};
+
+/// @brief Get the name of a core_state
+static const char * state_name(int state);
+
+/// @brief Writes a description of the arguments of an entry to buffer
+static void describe(const struct TraceEntry * e, char * buffer);
+
+int main(int argc, char * argv[])
+{
+	FILE * in = stdin;
+	if (argc == 2 && !(in = fopen(argv[1],"r")))
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	else if (argc > 2)
+	{
+		fprintf(stderr,"usage: %s [dump]\n",argv[0]);
+		return 1;
+	}
+
+	char line[100], text[100];
+	unsigned int n = 0, i = 0;
+	if (!fgets(line,sizeof(line),in) || sscanf(line,"%u",&n) != 1)
+	{
+		fprintf(stderr,"expected the number of entries\n");
+		return 1;
+	}
+
+	struct TraceEntry e, prev;
+	double t = 0;
+	printf("%12s %6s  %-16s %s\n","time_ms","seq","event","details");
+	for (i = 0; i != n; ++i)
+	{
+		unsigned int event = 0, seq = 0, a = 0, b = 0;
+		if (!fgets(line,sizeof(line),in)
+			|| sscanf(line,"%8x%4x%4x%8x%8x",&e.stamp,&event,&seq,&a,&b) != 5)
+		{
+			fprintf(stderr,"entry %u is malformed\n",i);
+			return 1;
+		}
+		e.event = event;
+		e.seq = seq;
+		e.a = (int)a;
+		e.b = (int)b;
+
+		if (i != 0)
+		{
+			t += (unsigned int)(e.stamp - prev.stamp)/CORE_HZ*1000;
+			if ((unsigned short)(e.seq - prev.seq) != 1)
+			{
+				printf("%12s %6s  %u entries missing\n","","",(unsigned short)(e.seq - prev.seq - 1));
+			}
+		}
+		describe(&e,text);
+		printf("%12.3f %6u  %s\n",t,e.seq,text);
+		prev = e;
+	}
+	return 0;
+}
+
+static const char * state_name(int state)
+{
+	return state >= 0 && state < (int)(sizeof(states)/sizeof(states[0])) ? states[state] : "?";
+}
+
+static void describe(const struct TraceEntry * e, char * buffer)
+{
+	switch (e->event)
+	{
+		case TRACE_STATE:
+			sprintf(buffer,"%-16s %s -> %s","state",state_name(e->a),state_name(e->b));
+			break;
+		case TRACE_VOLTAGE_SAT:
+			sprintf(buffer,"%-16s effort %d limited to %d","voltage_sat",e->a,e->b);
+			break;
+		case TRACE_CURRENT_SAT:
+			sprintf(buffer,"%-16s %d mA limited to %d mA","current_sat",e->a,e->b);
+			break;
+		case TRACE_MOTION_CLAMP:
+			sprintf(buffer,"%-16s integral %d clamped to %d","motion_clamp",e->a,e->b);
+			break;
+		case TRACE_STREAM_OVERFLOW:
+			sprintf(buffer,"%-16s %d overflows after %d samples","stream_overflow",e->b,e->a);
+			break;
+		case TRACE_FLASH_PACK:
+			sprintf(buffer,"%-16s status %d, stalled %d us","flash_pack",e->a,e->b);
+			break;
+		case TRACE_COMMAND:
+			if (e->a == COMMAND_SYNC)
+			{
+				sprintf(buffer,"%-16s opcode 0x%02x","frame",e->b);
+			}
+			else if (e->b)
+			{
+				sprintf(buffer,"%-16s %c %c","command",e->a,e->b);
+			}
+			else
+			{
+				sprintf(buffer,"%-16s %c","command",e->a);
+			}
+			break;
+		default:
+			sprintf(buffer,"%-16u %d %d",e->event,e->a,e->b);
+			break;
+	}
+}
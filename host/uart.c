@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include "NU32.h"
+#include "load.h"
+#include "hal.h"
+
+/// @file uart.c
+/// @brief Host implementation of the NU32 serial port on standard input and output
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+volatile int hal_uart_waiting = 0;
+
+void NU32_ReadUART1(char * message, int maxLength)
+{
+	message[0] = '\0';
+	load_idle_begin();
+	hal_uart_waiting = 1;
+	if (fgets(message,maxLength,stdin))
+	{
+		message[strcspn(message,"\r\n")] = '\0';
+	}
+	hal_uart_waiting = 0;
+	load_idle_end();
+}
+
+FILE * hal_uart_out = 0;
+
+void NU32_WriteUART1(const char * string)
+{
+	FILE * out = hal_uart_out ? hal_uart_out : stdout;
+	fputs(string,out);
+	if (out == stdout)
+	{
+		fflush(out); // the other end is waiting for it; a capture is read once it is closed
+	}
+}
+
+void NU32_ReadBytesUART1(char * data, int n)
+{
+	load_idle_begin();
+	hal_uart_waiting = 1;
+	size_t got = fread(data,1,n,stdin);
+	memset(data + got,0,n - got); // the input ended
+	hal_uart_waiting = 0;
+	load_idle_end();
+}
+
+void NU32_WriteBytesUART1(const char * data, int n)
+{
+	FILE * out = hal_uart_out ? hal_uart_out : stdout;
+	fwrite(data,1,n,out);
+	if (out == stdout)
+	{
+		fflush(out);
+	}
+}
+
+int NU32_PollUART1(char * data)
+{
+	// stdin must be unbuffered, or bytes read ahead into its buffer would go unnoticed
+	struct pollfd in = {fileno(stdin), POLLIN, 0};
+	if (poll(&in,1,0) != 1 || !(in.revents & (POLLIN | POLLHUP)))
+	{
+		return 0;
+	}
+	int c = fgetc(stdin);
+	if (c == EOF)
+	{
+		return 0;
+	}
+	*data = c;
+	return 1;
+}
@@ -0,0 +1,198 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "velocity.h"
+
+/// @file velocity_bench.c
+/// @brief Measures the noise and the lag of the velocity estimators of velocity.c on the angle
+///	   the motion loop reads: the encoder count converted to whole degrees as motion_angle()
+///	   does, sampled at the motion loop rate.
+///	   The noise is the RMS error of the estimate while the motor turns at each of a few
+///	   constant speeds, from a slow crawl to a fast move, from a random angle once the estimator
+///	   has settled.  The kd column is the RMS current the noise over all the speeds puts
+///	   through the derivative term.  The lag is the mean error while the speed ramps at a constant
+///	   acceleration, over that acceleration: how far behind the estimate runs.  The time is
+///	   what an update costs on this machine, to compare with the period of the loop.
+///	   One line is printed per estimator and bandwidth.
+///
+///	   usage: velocity_bench [-r rate] [-c counts] [-k kd] [-a acceleration] [-s seed] [hz]...
+///	   The bandwidths default to 5, 10, 20 and 40 Hz.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MAX_BANDS 16		// the most bandwidths
+#define NSPEEDS 4		// the speeds the noise is measured at
+#define SETTLE 2.0		// seconds an estimator is given before it is measured
+#define MEASURE 10.0		// seconds each speed is measured for
+#define RAMP 1.0		// seconds the speed ramps for
+#define TIMING 1000000		// updates timed per estimator
+
+static const double speeds[NSPEEDS] = {10, 45, 180, 720};	// in degrees/s
+static const char * names[VELOCITY_MODES] = {"difference", "filter", "pll", "edges"};
+
+static double rate = 200;	// the loop rate, in Hz
+static int counts = 396;	// encoder counts per revolution
+static int kd = 20000;		// the derivative gain, as m.kd
+static double accel = 2000;	// the acceleration of the ramp, in degrees/s^2
+static unsigned int rng = 1;
+
+/// @brief Get the angle the motion loop reads at a true angle, in degrees << 16
+static int sense(double angle);
+
+/// @brief Draws a number uniformly from 0 to 1
+static double uniform(void);
+
+/// @brief Measures one estimator
+/// @param noise [out] The RMS error at each speed, then over all of them, in degrees/s
+/// @param lag   [out] The mean error on the ramp over the acceleration, in s
+/// @param ns    [out] The time an update takes, in ns
+static void measure(const struct VelocityGains * g, double * noise, double * lag, double * ns);
+
+/// @brief Seconds on a monotonic clock
+static double now(void);
+
+int main(int argc, char * argv[])
+{
+	double bands[MAX_BANDS] = {5, 10, 20, 40};
+	int nbands = 4, opt = 0, i = 0, mode = 0;
+
+	while ((opt = getopt(argc,argv,"r:c:k:a:s:")) != -1)
+	{
+		switch (opt)
+		{
+			case 'r': rate = atof(optarg); break;
+			case 'c': counts = atoi(optarg); break;
+			case 'k': kd = atoi(optarg); break;
+			case 'a': accel = atof(optarg); break;
+			case 's': rng = (unsigned int)strtoul(optarg,0,0); break;
+			default:
+				fprintf(stderr,"usage: %s [-r rate] [-c counts] [-k kd] [-a acceleration] [-s seed] [hz]...\n",
+					argv[0]);
+				return 1;
+		}
+	}
+	if (rate <= 0 || counts <= 0)
+	{
+		fprintf(stderr,"the rate and the counts must be positive\n");
+		return 1;
+	}
+	if (optind < argc)
+	{
+		nbands = 0;
+		for (i = optind; i < argc && nbands != MAX_BANDS; ++i)
+		{
+			bands[nbands++] = atof(argv[i]);
+		}
+	}
+	rng = rng ? rng : 1;
+
+	printf("%-10s %5s","estimator","hz");
+	for (i = 0; i != NSPEEDS; ++i)
+	{
+		printf(" %6g d/s",speeds[i]);
+	}
+	printf(" %8s %8s %7s\n","kd mA","lag ms","ns");
+	for (mode = 0; mode != VELOCITY_MODES; ++mode)
+	{
+		for (i = 0; i != (mode == VELOCITY_DIFFERENCE ? 1 : nbands); ++i)
+		{
+			struct VelocityGains g;
+			double noise[NSPEEDS + 1], lag, ns;
+			int j = 0;
+			velocity_gains(&g,mode,bands[i],1/rate);
+			measure(&g,noise,&lag,&ns);
+			if (mode == VELOCITY_DIFFERENCE)
+			{
+				printf("%-10s %5s",names[mode],"-");
+			}
+			else
+			{
+				printf("%-10s %5g",names[mode],bands[i]);
+			}
+			for (j = 0; j != NSPEEDS; ++j)
+			{
+				printf(" %10.2f",noise[j]);
+			}
+			// the derivative term is kd*edot/100, with edot in degrees per tick
+			printf(" %8.1f %8.2f %7.1f\n",kd*noise[NSPEEDS]/rate/100,lag*1000,ns);
+		}
+	}
+	return 0;
+}
+
+static int sense(double angle)
+{
+	int count = (int)floor(angle*counts/360);
+	return count*360/counts*65536;
+}
+
+static double uniform(void)
+{
+	rng = rng*1664525u + 1013904223u;
+	return (rng >> 8)/(double)(1u << 24);
+}
+
+static void measure(const struct VelocityGains * g, double * noise, double * lag, double * ns)
+{
+	struct Velocity v;
+	unsigned int settle = (unsigned int)(SETTLE*rate), ticks = (unsigned int)(MEASURE*rate), t = 0;
+	int speed = 0;
+	double total = 0;
+	for (speed = 0; speed != NSPEEDS; ++speed)
+	{
+		double start = 360*uniform(), sum = 0;
+		velocity_reset(&v);
+		for (t = 0; t != settle + ticks; ++t)
+		{
+			double estimate = velocity_update(&v,g,sense(start + speeds[speed]*t/rate))*rate/65536;
+			if (t >= settle)
+			{
+				double e = estimate - speeds[speed];
+				sum += e*e;
+			}
+		}
+		noise[speed] = sqrt(sum/ticks);
+		total += sum;
+	}
+	noise[NSPEEDS] = sqrt(total/(NSPEEDS*ticks));
+
+	// the speed ramps up from rest, and the estimate is given the first half of the ramp to catch up
+	unsigned int ramp = (unsigned int)(RAMP*rate);
+	double start = 360*uniform(), error = 0;
+	velocity_reset(&v);
+	for (t = 0; t != ramp; ++t)
+	{
+		double time = t/rate;
+		double estimate = velocity_update(&v,g,sense(start + accel*time*time/2))*rate/65536;
+		if (t >= ramp/2)
+		{
+			error += accel*time - estimate;
+		}
+	}
+	*lag = error/(ramp - ramp/2)/accel;
+
+	// a slow turn, so every estimator takes its usual path
+	int x[256];
+	for (t = 0; t != 256; ++t)
+	{
+		x[t] = sense(speeds[1]*t/rate);
+	}
+	volatile int sink = 0;
+	velocity_reset(&v);
+	double begin = now();
+	for (t = 0; t != TIMING; ++t)
+	{
+		sink += velocity_update(&v,g,x[t & 255]);
+	}
+	*ns = (now() - begin)/TIMING*1e9;
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec*1e-9;
+}
@@ -0,0 +1,126 @@
+#include "NU32.h"
+#include "load.h"
+#include "sched.h"
+#include "streaming.h"
+
+/// @file load.c
+/// @brief Implements CPU load and idle time accounting
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define MEASURED 3	// LOAD_TICK, LOAD_DEFERRED and LOAD_IDLE are measured, the foreground is the rest
+
+struct Sample {
+	unsigned int stamp;		// core timer count when the sample was taken
+	unsigned int busy[MEASURED];	// load_total of each measured context
+};
+
+static volatile unsigned int busy[MEASURED];	// total time per context, in core timer ticks
+static struct Sample samples[LOAD_WINDOW + 1];	// ring of the most recent samples
+static int newest = 0, nsamples = 0;
+static volatile int streaming = 0;
+
+static unsigned int idle_start = 0, idle_isr = 0;	// set by the outermost load_idle_begin
+static unsigned int idle_depth = 0;			// the idle waits begun and not yet ended
+
+/// @brief The sampling task, run LOAD_HZ times per second
+static void load_sample(void);
+
+void load_init(void)
+{
+	int i = 0;
+	for (i = 0; i != MEASURED; ++i)
+	{
+		busy[i] = 0;
+	}
+	newest = nsamples = 0;
+	streaming = 0;
+	sched_register("load",load_sample,sched_base_hz()/LOAD_HZ,1,SCHED_DEFERRED);
+}
+
+unsigned int load_total(enum LoadContext context)
+{
+	return busy[context];
+}
+
+void load_add(enum LoadContext context, unsigned int ticks)
+{
+	busy[context] += ticks;
+}
+
+void load_idle_begin(void)
+{
+	// a wait inside a wait, such as the serial port inside a wait for samples, is part of it
+	if (idle_depth++ != 0)
+	{
+		return;
+	}
+	idle_isr = busy[LOAD_TICK] + busy[LOAD_DEFERRED];
+	idle_start = _CP0_GET_COUNT();
+}
+
+void load_idle_end(void)
+{
+	if (idle_depth == 0 || --idle_depth != 0)
+	{
+		return;
+	}
+	unsigned int elapsed = _CP0_GET_COUNT() - idle_start;
+	unsigned int isr = busy[LOAD_TICK] + busy[LOAD_DEFERRED] - idle_isr;
+	busy[LOAD_IDLE] += elapsed - isr;
+}
+
+unsigned int load_foreground_clock(void)
+{
+	return _CP0_GET_COUNT() - busy[LOAD_TICK] - busy[LOAD_DEFERRED];
+}
+
+void load_utilisation(unsigned int * permille)
+{
+	struct Sample first, last;
+	int i = 0;
+
+	// the sampling task may run while we copy
+	unsigned int status = INTDisableInterrupts();
+	int back = nsamples - 1 < LOAD_WINDOW ? nsamples - 1 : LOAD_WINDOW;
+	last = samples[newest];
+	first = samples[(newest + LOAD_WINDOW + 1 - (back > 0 ? back : 0)) % (LOAD_WINDOW + 1)];
+	INTRestoreInterrupts(status);
+
+	unsigned int elapsed = last.stamp - first.stamp, measured = 0;
+	for (i = 0; i != MEASURED; ++i)
+	{
+		unsigned int ticks = last.busy[i] - first.busy[i];
+		permille[i] = elapsed ? (unsigned int)((unsigned long long)ticks*1000/elapsed) : 0;
+		measured += permille[i];
+	}
+	permille[LOAD_FOREGROUND] = measured < 1000 ? 1000 - measured : 0;
+}
+
+void load_stream(int on)
+{
+	streaming = on;
+}
+
+static void load_sample(void)
+{
+	int i = 0;
+	newest = (newest + 1) % (LOAD_WINDOW + 1);
+	samples[newest].stamp = _CP0_GET_COUNT();
+	for (i = 0; i != MEASURED; ++i)
+	{
+		samples[newest].busy[i] = busy[i];
+	}
+	if (nsamples <= LOAD_WINDOW)
+	{
+		++nsamples;
+	}
+
+	if (streaming)
+	{
+		unsigned int permille[LOAD_CONTEXTS];
+		load_utilisation(permille);
+		streaming_record(permille[LOAD_TICK],permille[LOAD_DEFERRED],permille[LOAD_IDLE]);
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef LOAD_H_
+#define LOAD_H_
+/// @file load.h
+/// @brief Accounts for where the CPU time goes: the scheduler interrupts, the foreground
+///	   (menu and streaming) and idle waiting.  Time is measured with the core timer.
+///	   Time spent in an interrupt that preempts a measured section is not counted twice.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define LOAD_HZ 10		/// how often the utilisation is sampled
+#define LOAD_WINDOW 10		/// the utilisation is reported over this many samples (1 s)
+
+/// @brief The contexts the CPU time is divided into
+enum LoadContext {
+		LOAD_TICK,		/// the priority 7 scheduler tick (current loop)
+		LOAD_DEFERRED,		/// the priority 6 deferred tasks (motion loop, diagnostics)
+		LOAD_IDLE,		/// the foreground waiting for the serial port or for stream data
+		LOAD_FOREGROUND,	/// everything else the foreground does
+		LOAD_CONTEXTS
+	       };
+
+/// @brief Registers the sampling task with the scheduler
+/// @pre   sched_init() has been called
+void load_init(void);
+
+/// @brief Get the total time spent in a context so far
+/// @param context LOAD_TICK, LOAD_DEFERRED or LOAD_IDLE
+/// @return the total time, in core timer ticks. Wraps around.
+unsigned int load_total(enum LoadContext context);
+
+/// @brief Adds time to a context.  The scheduler calls this at the end of its interrupts.
+/// @param context LOAD_TICK, LOAD_DEFERRED or LOAD_IDLE
+/// @param ticks   The time spent, in core timer ticks, not including interrupts that preempted it
+void load_add(enum LoadContext context, unsigned int ticks);
+
+/// @brief Marks the start of an idle wait in the foreground.  Waits nest: only the time
+///	   from the outermost load_idle_begin() to its load_idle_end() is counted.
+void load_idle_begin(void);
+
+/// @brief Marks the end of an idle wait in the foreground
+void load_idle_end(void);
+
+/// @brief Get a clock that only runs while the foreground does: the core timer less the time
+///	   spent in the interrupts.  The difference of two readings is what the foreground code
+///	   between them cost, however often it was preempted.
+/// @return the clock, in core timer ticks. Wraps around.
+unsigned int load_foreground_clock(void);
+
+/// @brief Get the utilisation over the last LOAD_WINDOW samples
+/// @param permille [out] The share of time spent in each context, in tenths of a percent.
+///		    Must hold LOAD_CONTEXTS values.
+void load_utilisation(unsigned int * permille);
+
+/// @brief Start streaming the utilisation: every sample calls
+///	   streaming_record(tick, deferred, idle), in tenths of a percent
+/// @param on 1 to start, 0 to stop
+void load_stream(int on);
+
+#endif
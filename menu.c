@@ -1,13 +1,30 @@
+#include <math.h>
 #include "menu.h"
 #include "core.h"
 #include "current.h"
 #include "streaming.h"
 #include "motion.h"
+#include "param.h"
+#include "sched.h"
+#include "load.h"
+#include "trace.h"
+#include "command.h"
+#include "response.h"
 #include "NU32.h"
 
 static char buffer[200]; // used for storing incoming and outgoing requests
 static const unsigned int BUF_SIZE = sizeof(buffer)/sizeof(buffer[0]);
 
+#define MIN_CURRENT_US 50	// the current loop may run at most as fast as the 20 kHz PWM
+#define MAX_CURRENT_US 6000	// the longest base tick timer 1 can produce is 6.5 ms
+#define MAX_MOTION_US 1000000	// keeps the motion period in core timer ticks well within 32 bits
+#define MAX_SWEEP_POINTS 100	// the most frequencies a sweep may measure
+#define AUTOTUNE_TIMEOUT 10	// seconds an auto-tune may take to produce its limit cycles
+#define WAIT_MARGIN 1		// seconds a run may take beyond its expected length before it is given up
+
+static unsigned int upload_samples = 0;	// trajectory samples parsed by 'm l' since 'd c' was last sent
+static unsigned int upload_ticks = 0;	// the foreground time parsing them took, in core timer ticks
+
 static const char assert_fail[] = "\a%s:%d Assertion failed. %s "; // format string for failed assertions
 
 /// @brief The sub-menu related to current control
@@ -22,6 +39,31 @@ static void motion_menu(void);
 static void diagnostic_menu(void);
 
 
+/// @brief The sub-menu for getting, setting and listing named parameters
+static void param_menu(void);
+
+
+/// @brief Runs a sine sweep with one of the loops
+///	   Reads "f_start f_stop points amplitude cycles" and replies with the number of points, then
+///	   one "hz gain phase" line per frequency as soon as it has been measured.
+///	   The frequencies are spaced logarithmically.
+/// @param state  The state in which the loop injects the sine, entered once the first frequency has begun
+/// @param period The period of the loop, in core timer ticks.  Frequencies up to a quarter of its rate are allowed.
+/// @param begin, done, result The frequency response functions of the loop
+static void sweep(enum State state, unsigned int period, float (*begin)(float, int, unsigned int),
+		  int (*done)(void), void (*result)(float *, float *));
+
+
+/// @brief Waits for a run of the loops to finish, counting the wait as idle time
+/// @param done    The function that checks whether the run is over
+/// @param seconds The longest the run may take
+/// @return 1 if the run finished, 0 if it timed out
+static int wait_done(int (*done)(void), float seconds);
+
+/// @brief Checks whether both loops have recorded their tracking metrics
+static int metrics_done(void);
+
+
 /// @brief Sends a response back to the PC
 ///	   The response to send is stored in buffer.
 ///	   "\r\n" will be sent regardless of whether buf ends with "\r\n"
@@ -32,7 +74,22 @@ void menu_run(void)
 	core_gains_load();
 	while(1)
 	{
-		NU32_ReadUART1(buffer,BUF_SIZE);	//we expect the next character to be the menu command
+		// a binary frame starts with a byte no menu command starts with, and gets its own reply
+		NU32_ReadBytesUART1(buffer,1);
+		if (buffer[0] == (char)COMMAND_SYNC)
+		{
+			command_frame();
+			continue;
+		}
+		if (buffer[0] == '\r' || buffer[0] == '\n')
+		{
+			buffer[0] = '\0';			// an empty line
+		}
+		else
+		{
+			NU32_ReadUART1(buffer + 1,BUF_SIZE - 1);	//the rest of the line holding the menu command
+		}
+		trace_record(TRACE_COMMAND,buffer[0],0);
 		switch (buffer[0])
 		{
 			case 'i':
@@ -50,6 +107,11 @@ void menu_run(void)
 				diagnostic_menu();
 				break;
 			}
+			case 'p':
+			{
+				param_menu();
+				break;
+			}
 			case 's':
 			{
 				core_gains_save();
@@ -90,11 +152,12 @@ void menu_run(void)
 static void current_menu(void)
 {
 	NU32_ReadUART1(buffer,BUF_SIZE);
+	trace_record(TRACE_COMMAND,'i',buffer[0]);
 	switch (buffer[0])
 	{
 		case 'k':	// get and set the controller gains
 		{
-			core_state = IDLE;	// don't change the gains while we could potentially be executing a controller
+			// the gains are double buffered, so they can be changed while the controller runs
 
 			// get the current gains as a string and write them to serial
 			current_gains_sprintf(buffer);
@@ -102,7 +165,10 @@ static void current_menu(void)
 
 			// receive the new gains from serial and set them
 			NU32_ReadUART1(buffer,BUF_SIZE);
-			current_gains_sscanf(buffer);
+			if (!current_gains_sscanf(buffer))
+			{
+				NU32_WriteUART1("\acurrent_menu:k Invalid gains, they are unchanged");
+			}
 			break;
 		}
 		case 'r':  
@@ -115,10 +181,81 @@ static void current_menu(void)
 			streaming_begin(nsamps); 		// setup data streaming
 
 			core_state = TUNE;			// start tuning mode
-			streaming_write();			// write the data as it is generated
+			command_serve(streaming_poll);		// write the data as it is generated, serving frames meanwhile
 			core_state = IDLE;			// stop moving
 			break;
 		}
+		case 'm': // run the tuning wave and report its tracking metrics instead of streaming it
+		{
+			unsigned int nsamps = 50;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%u",&nsamps);
+
+			core_state = IDLE;
+			current_metrics_begin(nsamps);
+			core_state = TUNE;
+			int done = wait_done(current_metrics_done,(float)nsamps*current_period()/(SYS_FREQ/2) + WAIT_MARGIN);
+			core_state = IDLE;
+			if (!done)
+			{
+				NU32_WriteUART1("\acurrent_menu:m Timed out");
+				break;
+			}
+			current_metrics_sprintf(buffer);
+			send_response(buffer);
+			break;
+		}
+		case 'w': // get and set the tuning wave, as "type amplitude offset period"
+		{
+			// types: square, sine, chirp, prbs, multisine.  The period is in current loop ticks.
+			current_excite_sprintf(buffer);
+			send_response(buffer);
+
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			if (!current_excite_sscanf(buffer))
+			{
+				NU32_WriteUART1("\acurrent_menu:w Invalid tuning wave");
+			}
+			break;
+		}
+		case 'a': // auto-tune kp and ki with a relay, given "amplitude hysteresis cycles save"
+		{
+			// the amplitude is in control effort units, the hysteresis in mA.
+			// Replies "ku tu_us kp ki".  If save is 1 the new gains are saved to flash.
+			int amplitude = 0, hysteresis = 0, cycles = 0, save = 0;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%d %d %d %d",&amplitude,&hysteresis,&cycles,&save);
+			if (amplitude <= 0 || amplitude > 2000 || hysteresis < 0 || cycles < 1)
+			{
+				NU32_WriteUART1("\acurrent_menu:a Invalid auto-tune settings");
+				break;
+			}
+
+			core_state = IDLE;
+			current_autotune_begin(amplitude,hysteresis,cycles);
+			core_state = TUNE;
+			wait_done(current_autotune_done,AUTOTUNE_TIMEOUT);
+			core_state = IDLE;
+			if (!current_autotune_finish(buffer))
+			{
+				NU32_WriteUART1("\acurrent_menu:a No limit cycle, the gains are unchanged");
+				break;
+			}
+			send_response(buffer);
+			if (save)
+			{
+				core_gains_save();
+			}
+			break;
+		}
+		case 'f': // measure the frequency response of the current loop with a sine sweep
+		{
+			core_state = IDLE;
+			sweep(TUNE,current_period(),current_response_begin,current_response_done,current_response_result);
+			core_state = IDLE;
+			current_response_stop();
+			break;
+		}
 		case 'b':
 		{
 			current_pwm_set(0);
@@ -141,19 +278,21 @@ static void current_menu(void)
 static void motion_menu(void)
 {
 	NU32_ReadUART1(buffer,BUF_SIZE);
-	static  int length = 0; //keep track of the loaded motion trajectory length
+	trace_record(TRACE_COMMAND,'m',buffer[0]);
+	int length = motion_trajectory_length(); // the loaded motion trajectory length, also loaded by frames
 	switch(buffer[0])
 	{
 		case 'k':
 		{
-			core_state = IDLE;
-			
 			// get the motion controller gains as a string and write them to serial
 			motion_gains_sprintf(buffer);
 			send_response(buffer);
 
 			NU32_ReadUART1(buffer,BUF_SIZE);
-			motion_gains_sscanf(buffer);
+			if (!motion_gains_sscanf(buffer))
+			{
+				NU32_WriteUART1("\amotion_menu:k Invalid gains, they are unchanged");
+			}
 			break;
 		}
 		case 'l': // load trajectory
@@ -166,6 +305,10 @@ static void motion_menu(void)
 			{
 				; // trajectory loading aborted, do nothing
 			}
+			else if (motion_trajectory_queued())
+			{
+				NU32_WriteUART1("\amotion_menu:l The queue is running the trajectory");
+			}
 			else if (!motion_trajectory_set(0,new_length-1))
 			{
 				sprintf(buffer,"\amotion_menu:l Trajectory too long");
@@ -180,9 +323,12 @@ static void motion_menu(void)
 				for(i = 0; i != length; ++i)
 				{
 					NU32_ReadUART1(buffer,BUF_SIZE);
+					unsigned int start = load_foreground_clock();
 					sscanf(buffer,"%d",&angle);
 					motion_trajectory_set(angle,i);
+					upload_ticks += load_foreground_clock() - start;
 				}
+				upload_samples += length;
 			}
 			break;
 		}
@@ -203,11 +349,88 @@ static void motion_menu(void)
 				motion_trajectory_reset(LAST,0);//start the trajectory from the beginning, hold at the end
 				streaming_begin(length+xtra);	// setup the number of data samples	
 				core_state = TRACK;		// track the trajectory
-				streaming_write();		// stream the data to the PC
-				core_state = HOLD;		// hold the last position
+				command_serve(streaming_poll);	// stream the data to the PC
+				if (core_state == TRACK)	// unless a frame stopped it
+				{
+					core_state = HOLD;	// hold the last position
+				}
+			}
+			break;
+		}
+		case 'y': // execute the trajectory and report its tracking metrics instead of streaming it
+		{
+			// replies with the metrics of the motion loop, then of the current loop over the same run
+			int xtra = 0;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%d",&xtra);
+			if (length <= 0)
+			{
+				NU32_WriteUART1("\aCannot Execute, No Trajectory Loaded");
+			}
+			else
+			{
+				unsigned int nsamples = length + (xtra > 0 ? xtra : 0);
+				motion_trajectory_reset(LAST,0);
+				// the loops record in HOLD too, so they start recording on the tick that starts tracking
+				unsigned int status = INTDisableInterrupts();
+				motion_metrics_begin(nsamples);
+				current_metrics_begin(nsamples*(motion_period()/current_period()));
+				core_state = TRACK;
+				INTRestoreInterrupts(status);
+				int done = wait_done(metrics_done,(float)nsamples*motion_period()/(SYS_FREQ/2) + WAIT_MARGIN);
+				core_state = HOLD;
+				if (!done)
+				{
+					NU32_WriteUART1("\amotion_menu:y Timed out");
+					break;
+				}
+				motion_metrics_sprintf(buffer);
+				send_response(buffer);
+				current_metrics_sprintf(buffer);
+				NU32_WriteUART1(buffer);
+			}
+			break;
+		}
+		case 'a': // auto-tune kp, ki and kd with a relay about the current angle, given "amplitude hysteresis cycles save"
+		{
+			// the amplitude is in mA, the hysteresis in degrees.
+			// Replies "ku tu_us kp ki kd".  If save is 1 the new gains are saved to flash.
+			// Holds the starting angle with the new gains afterwards.
+			int amplitude = 0, hysteresis = 0, cycles = 0, save = 0;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%d %d %d %d",&amplitude,&hysteresis,&cycles,&save);
+			if (amplitude <= 0 || amplitude > 2000 || hysteresis < 0 || cycles < 1)
+			{
+				NU32_WriteUART1("\amotion_menu:a Invalid auto-tune settings");
+				break;
+			}
+
+			int start = motion_angle();
+			motion_trajectory_reset(ANGLE,start);
+			motion_autotune_begin(amplitude,hysteresis,cycles);
+			core_state = HOLD;
+			wait_done(motion_autotune_done,AUTOTUNE_TIMEOUT);
+			int tuned = motion_autotune_finish(buffer);
+			motion_trajectory_reset(ANGLE,start);
+			if (!tuned)
+			{
+				NU32_WriteUART1("\amotion_menu:a No limit cycle, the gains are unchanged");
+				break;
+			}
+			send_response(buffer);
+			if (save)
+			{
+				core_gains_save();
 			}
 			break;
 		}
+		case 'f': // measure the frequency response of the motion loop with a sine sweep about the current angle
+		{
+			motion_trajectory_reset(NOW,0);
+			sweep(HOLD,motion_period(),motion_response_begin,motion_response_done,motion_response_result);
+			motion_response_stop();
+			break;
+		}
 		case 'h': // hold the current position
 		{
 			int nsamples = 0;
@@ -218,7 +441,7 @@ static void motion_menu(void)
 			motion_trajectory_reset(NOW,0); // hold at the current angle
 			streaming_begin(nsamples);  // setup the number of data samples to stream
 			core_state = HOLD;	    // begin holding
-			streaming_write();	    // stream the data to the PC
+			command_serve(streaming_poll); // stream the data to the PC
 			break;
 		}
 		case 'g': // goto a position
@@ -247,8 +470,69 @@ static void motion_menu(void)
 				//begin streaming and start the goto
 				streaming_begin(nsamples);
 				core_state = HOLD;
-				streaming_write();
+				command_serve(streaming_poll);
+			}
+			break;
+		}
+		case 'q': // append segments to the motion queue, one per line, ended by a number of samples to stream
+		{
+			// "g angle speed accel" goes to angle (degrees) at up to speed (deg/s) and accel (deg/s^2),
+			// "d ms" dwells, "t" runs the loaded trajectory, "h" holds until the next segment,
+			// "p position velocity ms" reaches position (millidegrees) at velocity (millidegrees/s)
+			// ms later along a cubic.
+			// The first segment starts the queue if the motor is idle or holding.  Once the samples
+			// are streamed, replies "depth underruns completed" (see motion_queue_status()).
+			int nsamples = 0, ok = 1;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			while (buffer[0] != '\0' && strchr("gdthp",buffer[0]))
+			{
+				int angle = 0, speed = 0, accel = 0, position = 0, velocity = 0;
+				unsigned int ms = 0;
+				if (ok && buffer[0] == 'g')
+				{
+					ok = sscanf(buffer + 1,"%d %d %d",&angle,&speed,&accel) == 3
+						&& motion_queue_goto(angle,speed,accel);
+				}
+				else if (ok && buffer[0] == 'd')
+				{
+					ok = sscanf(buffer + 1,"%u",&ms) == 1 && motion_queue_dwell(ms);
+				}
+				else if (ok && buffer[0] == 'p')
+				{
+					ok = sscanf(buffer + 1,"%d %d %u",&position,&velocity,&ms) == 3
+						&& motion_queue_pvt(position,velocity,ms);
+				}
+				else if (ok && buffer[0] == 't')
+				{
+					ok = motion_queue_trajectory();
+				}
+				else if (ok)
+				{
+					ok = motion_queue_hold();
+				}
+				NU32_ReadUART1(buffer,BUF_SIZE);	// the next segment, or the number of samples
+			}
+			sscanf(buffer,"%d",&nsamples);
+			if (!ok)
+			{
+				// the segments after the one that failed were read but not queued
+				NU32_WriteUART1("\amotion_menu:q Invalid segment, full queue or busy motor");
+				break;
+			}
+			if (nsamples > 0 && core_state != QUEUE)
+			{
+				NU32_WriteUART1("\amotion_menu:q The queue is not running");
+				break;
+			}
+			if (nsamples > 0)
+			{
+				streaming_begin(nsamples);
+				command_serve(streaming_poll);
 			}
+			unsigned int depth = 0, underruns = 0, completed = 0;
+			motion_queue_status(&depth,&underruns,&completed);
+			sprintf(buffer,"%u %u %u\r\n",depth,underruns,completed);
+			NU32_WriteUART1(buffer);
 			break;
 		}
 		case 's': // stop trajectory
@@ -267,6 +551,7 @@ static void motion_menu(void)
 static void diagnostic_menu(void)
 {
 	NU32_ReadUART1(buffer,BUF_SIZE);
+	trace_record(TRACE_COMMAND,'d',buffer[0]);
 	switch(buffer[0])
 	{
 		case 'e':
@@ -322,6 +607,111 @@ static void diagnostic_menu(void)
 			NU32_WriteUART1(buffer);
 			break;
 		}
+		case 'j': // report the scheduler tasks and their timing since the last report
+		{
+			// "ntasks base_hz", then per task
+			// "name level divider phase runs max_jitter max_time late overruns"
+			// where the times are in core timer ticks (25 ns)
+			struct SchedStats stats;
+			int i = 0, n = sched_count();
+			sprintf(buffer,"%d %u\r\n",n,sched_base_hz());
+			NU32_WriteUART1(buffer);
+			for(i = 0; i != n; ++i)
+			{
+				sched_stats(i,&stats);
+				sprintf(buffer,"%s %d %u %u %u %u %u %u %u\r\n",stats.name,stats.level,stats.divider,
+					stats.phase,stats.runs,stats.max_jitter,stats.max_time,stats.late,stats.overruns);
+				NU32_WriteUART1(buffer);
+			}
+			sched_stats_reset();
+			break;
+		}
+		case 'v': // dump the event trace, oldest entry first
+		{
+			// "n", then one entry per line as 32 hex digits: stamp, event, seq, a, b
+			// (8, 4, 4, 8 and 8 digits).  host/trace_decode renders it as a timeline.
+			struct TraceEntry e;
+			unsigned int i = 0, n = 0;
+			trace_enable(0); // keep the trace still while it is sent
+			n = trace_count();
+			sprintf(buffer,"%u\r\n",n);
+			NU32_WriteUART1(buffer);
+			for(i = 0; i != n; ++i)
+			{
+				trace_entry(i,&e);
+				sprintf(buffer,"%08x%04x%04x%08x%08x\r\n",e.stamp,e.event,e.seq,e.a,e.b);
+				NU32_WriteUART1(buffer);
+			}
+			trace_enable(1);
+			break;
+		}
+		case 'u': // report the cpu utilisation, or stream it given a number of samples
+		{
+			// "tick deferred foreground idle" over the last second, in tenths of a percent.
+			// Streamed samples are "tick deferred idle", one every 1/LOAD_HZ s.
+			int nsamples = 0;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%d",&nsamples);
+			if (nsamples <= 0)
+			{
+				unsigned int permille[LOAD_CONTEXTS];
+				load_utilisation(permille);
+				sprintf(buffer,"%u %u %u %u\r\n",permille[LOAD_TICK],permille[LOAD_DEFERRED],
+					permille[LOAD_FOREGROUND],permille[LOAD_IDLE]);
+				NU32_WriteUART1(buffer);
+			}
+			else if (core_state != IDLE && core_state != PWM)
+			{
+				// the control loops are streaming their own data
+				NU32_WriteUART1("\adiagnostic_menu:u Cannot stream while the controllers are running");
+			}
+			else
+			{
+				streaming_begin(nsamples);
+				load_stream(1);
+				command_serve(streaming_poll);
+				load_stream(0);
+			}
+			break;
+		}
+		case 'c': // report the cost of parsing uploads and formatting streams since the last report
+		{
+			// "upload_samples upload_ticks stream_samples stream_ticks": the trajectory samples
+			// 'm l' parsed and the streamed samples formatted, with the foreground time they took
+			// in core timer ticks (25 ns), not counting the time spent waiting for the serial port
+			unsigned int stream_samples = 0, stream_ticks = 0;
+			streaming_cost(&stream_samples,&stream_ticks);
+			sprintf(buffer,"%u %u %u %u\r\n",upload_samples,upload_ticks,stream_samples,stream_ticks);
+			NU32_WriteUART1(buffer);
+			upload_samples = upload_ticks = 0;
+			break;
+		}
+		case 't': // set the loop periods, given as "current_us motion_us"
+		{
+			// The gains act per tick, so they need retuning after the periods change.
+			// The motion period must be a multiple of the current period.
+			unsigned int current_us = 0, motion_us = 0;
+			int motion = sched_find("motion");
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%u %u",&current_us,&motion_us);
+			if (current_us < MIN_CURRENT_US || current_us > MAX_CURRENT_US
+				|| motion_us < current_us || motion_us > MAX_MOTION_US || motion_us % current_us != 0)
+			{
+				NU32_WriteUART1("\adiagnostic_menu:t Invalid loop periods");
+			}
+			else if (motion < 0 || !sched_base_set(1000000/current_us)
+				|| !sched_divider_set(motion,motion_us/current_us,0))
+			{
+				NU32_WriteUART1("\adiagnostic_menu:t Cannot set the loop periods");
+			}
+			else
+			{
+				motion_period_changed();	// the velocity estimator is tuned per tick
+				sprintf(buffer,"%u %u\r\n",1000000/sched_base_hz(),(sched_period(motion) + 20)/40);
+				NU32_WriteUART1(buffer);
+			}
+			break;
+		}
 		default:
 		{
 			NU32_WriteUART1("\adiagnostic_menu: Unrecognized Command.");
@@ -330,6 +720,100 @@ static void diagnostic_menu(void)
 	}
 }
 
+static void param_menu(void)
+{
+	NU32_ReadUART1(buffer,BUF_SIZE);
+	trace_record(TRACE_COMMAND,'p',buffer[0]);
+	switch(buffer[0])
+	{
+		case 'l': // list all parameters, one "name type value min max" per line
+		{
+			int i = 0, n = param_count();
+			sprintf(buffer,"%d\r\n",n);
+			NU32_WriteUART1(buffer);
+			for(i = 0; i != n; ++i)
+			{
+				param_describe(i,buffer);
+				send_response(buffer);
+			}
+			break;
+		}
+		case 'g': // get a parameter by name
+		{
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			if (!param_sprintf(param_find(buffer),buffer))
+			{
+				NU32_WriteUART1("\aparam_menu:g Unknown parameter");
+			}
+			else
+			{
+				send_response(buffer);
+			}
+			break;
+		}
+		case 's': // set a parameter, given as "name value"
+		{
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			char * value = strchr(buffer,' ');
+			if (!value)
+			{
+				NU32_WriteUART1("\aparam_menu:s Expected a name and a value");
+				break;
+			}
+			*value = '\0';
+			++value;
+			if (!param_set(param_find(buffer),value))
+			{
+				NU32_WriteUART1("\aparam_menu:s Unknown parameter or value out of range");
+			}
+			break;
+		}
+		case 'n': // list the profiles, one "index name" per line, "-" for empty profiles
+		{
+			char name[PROFILE_NAME_LEN + 1];
+			int i = 0;
+			sprintf(buffer,"%d %d\r\n",MAX_PROFILES,param_profile_active());
+			NU32_WriteUART1(buffer);
+			for(i = 0; i != MAX_PROFILES; ++i)
+			{
+				if (!param_profile_name(i,name))
+				{
+					strcpy(name,"-");
+				}
+				sprintf(buffer,"%d %s\r\n",i,name);
+				NU32_WriteUART1(buffer);
+			}
+			break;
+		}
+		case 'w': // write all parameters to a profile, given as "index name"
+		{
+			int profile = -1, n = 0;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%d %n",&profile,&n);
+			if (!param_profile_save(profile,n > 0 && buffer[n] != '\0' ? buffer + n : 0))
+			{
+				NU32_WriteUART1("\aparam_menu:w Invalid profile");
+			}
+			break;
+		}
+		case 'a': // activate a profile. The gains change between control ticks, so there is no need to stop
+		{
+			int profile = -1;
+			NU32_ReadUART1(buffer,BUF_SIZE);
+			sscanf(buffer,"%d",&profile);
+			if (!param_profile_load(profile))
+			{
+				NU32_WriteUART1("\aparam_menu:a Invalid or empty profile");
+			}
+			break;
+		}
+		default:
+		{
+			NU32_WriteUART1("\aparam_menu: Unrecognized Command.");
+			break;
+		}
+	}
+}
 
 void send_response(const char * buf)
 {
@@ -341,3 +825,58 @@ void send_response(const char * buf)
 		NU32_WriteUART1("\r\n");
 	}
 }
+
+static void sweep(enum State state, unsigned int period, float (*begin)(float, int, unsigned int),
+		  int (*done)(void), void (*result)(float *, float *))
+{
+	float f_start = 0, f_stop = 0, fmax = (SYS_FREQ/2)/4.0f/period;
+	int points = 0, amplitude = 0, cycles = 0, i = 0;
+	NU32_ReadUART1(buffer,BUF_SIZE);
+	sscanf(buffer,"%f %f %d %d %d",&f_start,&f_stop,&points,&amplitude,&cycles);
+	if (!(f_start > 0 && f_stop >= f_start && f_stop <= fmax) || points < 1 || points > MAX_SWEEP_POINTS
+		|| amplitude <= 0 || cycles < 1)
+	{
+		sprintf(buffer,"\asweep: Invalid sweep, frequencies must lie in (0, %.1f] Hz",fmax);
+		NU32_WriteUART1(buffer);
+		return;
+	}
+
+	sprintf(buffer,"%d\r\n",points);
+	NU32_WriteUART1(buffer);
+	for (i = 0; i != points; ++i)
+	{
+		float hz = points == 1 ? f_start : f_start*powf(f_stop/f_start,(float)i/(points - 1));
+		float gain = 0, phase = 0;
+		hz = begin(hz,amplitude,cycles);
+		core_state = state;
+		if (!wait_done(done,(RESPONSE_SETTLE + cycles)/hz + WAIT_MARGIN))
+		{
+			NU32_WriteUART1("\asweep: Timed out");
+			return;
+		}
+		result(&gain,&phase);
+		sprintf(buffer,"%f %f %f\r\n",hz,gain,phase);
+		NU32_WriteUART1(buffer);
+	}
+}
+
+static int wait_done(int (*done)(void), float seconds)
+{
+	// the elapsed time is summed, so the wait may outlast a wrap of the core timer
+	unsigned long long limit = (unsigned long long)(seconds*(SYS_FREQ/2)), elapsed = 0;
+	unsigned int last = _CP0_GET_COUNT();
+	load_idle_begin();
+	while (!done() && elapsed < limit)
+	{
+		unsigned int now = _CP0_GET_COUNT();
+		elapsed += now - last;
+		last = now;
+	}
+	load_idle_end();
+	return done();
+}
+
+static int metrics_done(void)
+{
+	return motion_metrics_done() && current_metrics_done();
+}
@@ -0,0 +1,103 @@
+#include <math.h>
+#include "NU32.h"
+#include "metrics.h"
+
+/// @file metrics.c
+/// @brief Implements the tracking metrics
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define CORE_TICKS_PER_US 40	// the core timer runs at SYS_FREQ/2
+
+/// @brief Ends the current step, keeping its settling time if it is the longest so far
+static void step_end(struct Metrics * m);
+
+void metrics_begin(struct Metrics * m, unsigned int nsamples, int band)
+{
+	unsigned int status = INTDisableInterrupts();
+	m->samples = 0;
+	m->band = band;
+	m->sum_sq = 0;
+	m->sum_abs = 0;
+	m->max_error = 0;
+	m->saturated = 0;
+	m->last_r = 0;
+	m->dir = 0;
+	m->step_at = 0;
+	m->settle_at = 0;
+	m->overshoot = 0;
+	m->settling = 0;
+	m->nsamples = nsamples;
+	INTRestoreInterrupts(status);
+}
+
+void metrics_update(struct Metrics * m, int r, int s, int saturated)
+{
+	if (m->samples == m->nsamples)
+	{
+		return;
+	}
+
+	int e = r - s, mag = e < 0 ? -e : e;
+	m->sum_sq += (long long)e*e;
+	m->sum_abs += mag;
+	if (mag > m->max_error)
+	{
+		m->max_error = mag;
+	}
+	if (saturated)
+	{
+		++m->saturated;
+	}
+
+	int dr = r - (m->samples == 0 ? s : m->last_r);
+	if (dr > m->band || dr < -m->band)
+	{
+		step_end(m);
+		m->dir = dr > 0 ? 1 : -1;
+		m->step_at = m->samples;
+		m->settle_at = m->samples;
+	}
+	m->last_r = r;
+
+	if (m->dir != 0)
+	{
+		int over = (s - r)*m->dir;
+		if (over > m->overshoot)
+		{
+			m->overshoot = over;
+		}
+		if (mag > m->band)
+		{
+			m->settle_at = m->samples + 1;
+		}
+	}
+	++m->samples;
+}
+
+int metrics_done(const struct Metrics * m)
+{
+	return m->samples == m->nsamples;
+}
+
+void metrics_sprintf(const struct Metrics * m, unsigned int period, char * buffer)
+{
+	struct Metrics end = *m;
+	step_end(&end);
+
+	unsigned int n = end.samples ? end.samples : 1;
+	unsigned int rms = (unsigned int)(sqrt((double)end.sum_sq/n) + 0.5);
+	unsigned int iae = (unsigned int)(end.sum_abs*period/(CORE_TICKS_PER_US*1000));
+	unsigned int us = period/CORE_TICKS_PER_US;
+	sprintf(buffer,"%u %u %d %u %d %u %u",end.samples,rms,end.max_error,iae,end.overshoot,
+		end.settling*us,end.saturated*us);
+}
+
+static void step_end(struct Metrics * m)
+{
+	if (m->dir != 0 && m->settle_at - m->step_at > m->settling)
+	{
+		m->settling = m->settle_at - m->step_at;
+	}
+}
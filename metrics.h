@@ -0,0 +1,58 @@
+#ifndef METRICS_H_
+#define METRICS_H_
+/// @file metrics.h
+/// @brief Tracking metrics of a control loop, updated on every tick of a run so that
+///	   a run can be judged from one line instead of streaming every sample.
+///	   Each loop owns a struct Metrics and updates it from its interrupt; every update is O(1).
+///	   A step is a change of the reference by more than the settling band between two ticks,
+///	   so ramps and other smooth references produce no steps.  Overshoot and settling time
+///	   are the worst over all the steps of the run.  The first sample of a run is a step
+///	   from the measured value to the reference.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief The running statistics of one run.  The fields are private to metrics.c.
+struct Metrics {
+	volatile unsigned int nsamples;	// the length of the run, in ticks
+	volatile unsigned int samples;	// the ticks recorded so far
+	int band;			// the error band for settling
+	unsigned long long sum_sq;	// the sum of the squared errors
+	unsigned long long sum_abs;	// the sum of the absolute errors
+	int max_error;			// the largest absolute error
+	unsigned int saturated;		// the ticks spent in saturation
+	int last_r;			// the reference on the previous tick
+	int dir;			// the direction of the last step, 0 before the first
+	unsigned int step_at;		// the tick of the last step
+	unsigned int settle_at;		// the tick after the last error outside the band since the last step
+	int overshoot;			// the largest excursion past the reference after a step
+	unsigned int settling;		// the longest settling time, in ticks
+};
+
+/// @brief Starts a run
+/// @param m        The metrics
+/// @param nsamples The number of ticks in the run.  Updates after that are ignored.
+/// @param band     The settling band, in the units of the loop
+void metrics_begin(struct Metrics * m, unsigned int nsamples, int band);
+
+/// @brief Records one tick of the run.  Called from the control loop interrupt.
+/// @param m         The metrics
+/// @param r         The reference
+/// @param s         The sensor reading
+/// @param saturated 1 if the control effort was saturated on this tick
+void metrics_update(struct Metrics * m, int r, int s, int saturated);
+
+/// @brief Checks whether the run is over
+/// @return 1 once nsamples ticks have been recorded
+int metrics_done(const struct Metrics * m);
+
+/// @brief Writes the results of a run to the buffer
+///	   The format is "samples rms max_error iae overshoot settling_us saturated_us",
+///	   where the errors are in the units of the loop and iae is in units*ms
+/// @param m      The metrics
+/// @param period The period of the loop, in core timer ticks
+/// @param buffer [out] The results are written here
+/// @pre   The buffer has a minimum length of 100 characters
+void metrics_sprintf(const struct Metrics * m, unsigned int period, char * buffer);
+
+#endif
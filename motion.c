@@ -1,31 +1,127 @@
+#include <math.h>
 #include "motion.h"
 #include "core.h"
 #include "NU32.h"
 #include "current.h"
 #include "streaming.h"
+#include "param.h"
+#include "sched.h"
+#include "trace.h"
+#include "metrics.h"
+#include "response.h"
+#include "relay.h"
+#include "queue.h"
+#include "velocity.h"
+#include "gains.h"
 
 #define MAX_TRAJ_LEN 1000
+#define MOTION_PHASE 0		// the scheduler tick within the motion period on which the loop runs
+#define MAX_KP 20000		// the largest gains
+#define MAX_KI 20000
+#define MAX_KD 100000
+#define MAX_KV 10.0f		// the largest feedforward gains, in mA per deg/s, per deg/s^2 and mA
+#define MAX_KA 1.0f
+#define MAX_KC 2000
+#define MAX_VHZ 1000		// the highest bandwidth of the velocity estimator, in Hz
+#define CORE_HZ (SYS_FREQ/2)	// the core timer frequency
+#define MAX_QUEUE_SPEED (1 << 30) // the largest speed and acceleration of a queued goto, in degrees << QUEUE_SHIFT per tick
 
 //TODO: define variables for:
 //		gains (you define what gains you will use)
 //		and anything else you may need to run trajectories
 static int kp = 700, ki = 10, kd = 20000;
-static int eprev = 0, eint = 0, edot = 0, u = 0;
+static float kv = 0, ka = 0;	// feedforward of the reference velocity and acceleration, in mA per deg/s and per deg/s^2
+static int kc = 0;		// feedforward of the sign of the reference velocity, in mA
+static int vmode = VELOCITY_DIFFERENCE;	// how the derivative term estimates the velocity of the motor, an enum VelocityMode
+static int vhz = 20;		// the bandwidth of the velocity estimator, in Hz
+
+// The gains used by the ISR are double buffered (see gains.h): kp, ki and kd are
+// the working copies, and motion_gains_commit() publishes them.
+struct Gains {
+	int kp, ki, kd;
+	int kv, ka, kc;		// kv and ka << 16
+	struct VelocityGains velocity;
+};
+static volatile struct Gains gains[2] = {{700,10,20000},{700,10,20000}};
+static volatile unsigned int gains_seq = 0;	// the number of commits, gains_seq & 1 is the active set
+static struct GainsFollower follower = {0,10};	// the gains the ISR ran with on its last tick
+static int eprev = 0, eint = 0, edot = 0, u = 0; // eprev and edot in degrees << QUEUE_SHIFT
+static int rprev = 0;		     // the reference on the last tick, in degrees << QUEUE_SHIFT
+static volatile int restart = 1;     // 1 to start the derivative term again on the next tick
+static struct Velocity velocity;     // estimates the velocity of the motor for the derivative term
+static int eint_clamped = 0;	     // so only the start of a clamp is traced
+static struct Metrics metrics;	     // the tracking metrics of the current run
+static int band = 2;		     // the settling band of the metrics, in degrees
+static struct Response response;     // the frequency response measurement
+static volatile int responding = 0;  // 1 if HOLD adds the sine of response to the hold angle
+static struct Relay relay;	     // the relay auto-tune experiment
+static volatile int tuning = 0;	     // 1 if HOLD runs the relay instead of the PID controller
 static int traj_length = 0;          // The length of the current trajectory
 static int trajectory[MAX_TRAJ_LEN]; // The current trajectory
 static int curr_traj = 0; 	     // The current trajectory index
 static int hold_angle = 0;	     // The angle to maintain in the HOLD state, in degrees
+static int motion_task = -1;	     // The scheduler task that runs the motion control loop
+static struct Queue queue;	     // the segments the QUEUE state runs
+
+/// @brief The motion control loop
+///	   Runs in the priority 6 deferred interrupt of the scheduler (see sched.h), MOTION_HZ times per second
+static void motion_control(void);
+
+/// @brief Runs the PID controller for one tick
+///	   The proportional and derivative terms see the fraction of a degree of the reference, so a
+///	   profile from the queue turns into a smooth effort rather than one that steps with every
+///	   degree.  With a reference in whole degrees the arithmetic is that of integer degrees.
+///	   Unless the estimator is VELOCITY_DIFFERENCE, the derivative term is the change of the
+///	   reference less the estimated velocity of the motor, so only the measurement is filtered.
+/// @param g The gains
+/// @param r The reference angle, in degrees << QUEUE_SHIFT
+/// @param s The measured angle, in degrees
+/// @return the control effort, in mA
+static int motion_pid(const volatile struct Gains * g, int r, int s);
+
+/// @brief Get the current that drives the motor along the reference without waiting for an
+///	   error: inertia times acceleration, viscous and Coulomb friction times velocity
+/// @param g The gains
+/// @param v The velocity of the reference, in degrees << QUEUE_SHIFT per tick
+/// @param a The acceleration of the reference, in degrees << QUEUE_SHIFT per tick per tick
+/// @return the feedforward current, in mA
+static int motion_feedforward(const volatile struct Gains * g, int v, int a);
+
+/// @brief Get the velocity and acceleration of the trajectory at an index by central differences
+/// @param v [out] The velocity, in degrees << QUEUE_SHIFT per tick
+/// @param a [out] The acceleration, in degrees << QUEUE_SHIFT per tick per tick
+static void trajectory_derivatives(int index, int * v, int * a);
 
-static void timer2_init(void);
+/// @brief Appends a segment to the queue, starting the QUEUE state if the motor is idle or holding
+/// @return 1 on success, 0 if the queue is full or the motor is doing something else
+static int motion_queue_push(const struct Segment * segment);
+
+/// @brief Checks whether a PVT segment stays within MOTION_MAX_ANGLE between its ends
+/// @param start The reference it starts from, in degrees << QUEUE_SHIFT
+/// @param v0    The velocity it starts at, in degrees << QUEUE_SHIFT per tick
+/// @return 1 if it does, or if it goes no further out than it starts
+static int motion_pvt_in_range(int start, int v0, const struct Segment * segment);
+
+/// @brief Converts a rate per second, or per second squared if squared is 1, to degrees << QUEUE_SHIFT per tick
+static int motion_queue_rate(int per_second, int squared);
+
+/// @brief Publishes the gains and the coefficients of the velocity estimator, worked out for
+///	   the present period, to the ISR by flipping the gain buffers
+static void motion_gains_commit(void);
 
 //TODO: define the motion ISR.
 //	It should have a similar form to the current.c ISR.
 //	Use streaming_record() to send the reference, sensor and control effort to the PC
 //	when you are in the TRACK or HOLD states.
 
-void __ISR(_TIMER_2_VECTOR,IPL6SOFT) Motion_Control_Interrupt(void) {
+static void motion_control(void) {
     
     LATEINV = 0b10;
+
+	// pick up gains committed since the last tick, keeping the integral term continuous
+	unsigned int seq = gains_seq;
+	const volatile struct Gains * g = &gains[seq & 1];
+	eint = gains_follow(&follower,seq,g->ki,eint);
     
     switch (core_state)
 	{
@@ -35,27 +131,14 @@ void __ISR(_TIMER_2_VECTOR,IPL6SOFT) Motion_Control_Interrupt(void) {
 		}
         case TRACK:
 		{
-            int r, s, e;
+            int r, s, v, a;
             r = trajectory[curr_traj];
             s = motion_angle();
-            e = r-s;
-            edot = (e - eprev);
-            eint = eint + e;
-            
-            if (eint > 200) {
-                eint = 200;
-            }
-            else if (eint < -200) {
-                eint = -200;
-            }
-            else {
-                eint = eint;
-            }
-            
-            u = (kp*e + ki*eint + kd*edot)/100;  // calculate the control (current)
+            trajectory_derivatives(curr_traj,&v,&a);
+            u = motion_pid(g,r << QUEUE_SHIFT,s) + motion_feedforward(g,v,a); // calculate the control (current)
             current_amps_set(u);                // send the current to the motor
+            metrics_update(&metrics,r,s,u > 2000 || u < -2000);
             streaming_record(r,s,u);
-            eprev = e;
             if (curr_traj == traj_length-1) {
                 break;
             }
@@ -72,27 +155,22 @@ void __ISR(_TIMER_2_VECTOR,IPL6SOFT) Motion_Control_Interrupt(void) {
 		}
 		case HOLD:
 		{
-            int r, s, e;
+            int r, s;
             r = hold_angle;
-            s = motion_angle();
-            e = r-s;
-            edot = (e - eprev);
-            eint = eint + e;
-            
-            if (eint > 200) {
-                eint = 200;
+            if (responding) {
+                r = r + response_reference(&response);
             }
-            else if (eint < -200) {
-                eint = -200;
+            s = motion_angle();
+            if (responding) {
+                response_update(&response,s - hold_angle);
             }
-            else {
-                eint = eint;
+            u = motion_pid(g,r << QUEUE_SHIFT,s); // calculate the control (current)
+            if (tuning) {
+                u = relay_step(&relay,s);
             }
-            
-            u = (kp*e + ki*eint + kd*edot)/100;  // calculate the control (current)
             current_amps_set(u);                // send the current to the motor
+            metrics_update(&metrics,r,s,u > 2000 || u < -2000);
             streaming_record(r,s,u);
-            eprev = e;
             //TODO:
 			// make sure that the motion control loop gets the current
 			// it has requested via current_amps_set()
@@ -101,12 +179,76 @@ void __ISR(_TIMER_2_VECTOR,IPL6SOFT) Motion_Control_Interrupt(void) {
             curr_traj = 0;
             break;
 		}
+		case QUEUE: // follow the queued segments, holding where the last one ended when it runs dry
+		{
+			int reference = queue_step(&queue), s = motion_angle();
+			int r = (reference + (1 << (QUEUE_SHIFT - 1))) >> QUEUE_SHIFT;
+			u = motion_pid(g,reference,s) + motion_feedforward(g,queue_velocity(&queue),queue_acceleration(&queue));
+			current_amps_set(u);
+			metrics_update(&metrics,r,s,u > 2000 || u < -2000);
+			streaming_record(r,s,u);
+			break;
+		}
 		default:
 		{
 			break;
 		}
     }
-    IFS0bits.T2IF = 0;
+}
+
+static int motion_pid(const volatile struct Gains * g, int r, int s)
+{
+	int e = r - (s << QUEUE_SHIFT), unclamped;
+	if (restart)
+	{
+		rprev = r;
+		velocity_reset(&velocity);
+		restart = 0;
+	}
+	int v = velocity_update(&velocity,&g->velocity,s << QUEUE_SHIFT);
+	edot = g->velocity.mode == VELOCITY_DIFFERENCE ? e - eprev : r - rprev - v;
+	rprev = r;
+	eint = eint + ((e + (1 << (QUEUE_SHIFT - 1))) >> QUEUE_SHIFT); // whole degrees, so the clamp and ki keep their scale
+	unclamped = eint;
+	if (eint > 200)
+	{
+		eint = 200;
+	}
+	else if (eint < -200)
+	{
+		eint = -200;
+	}
+	if (eint != unclamped && !eint_clamped)
+	{
+		trace_record(TRACE_MOTION_CLAMP,unclamped,eint);
+	}
+	eint_clamped = eint != unclamped;
+	eprev = e;
+	return ((long long)g->kp*e + (long long)g->ki*eint*(1 << QUEUE_SHIFT) + (long long)g->kd*edot)/(100 << QUEUE_SHIFT);
+}
+
+static int motion_feedforward(const volatile struct Gains * g, int v, int a)
+{
+	// per second rather than per tick, in degrees << 8, so the gains survive a change of period
+	long long rate = CORE_HZ/motion_period();
+	long long vs = (long long)v*rate >> (QUEUE_SHIFT - 8), as = (long long)a*rate*rate >> (QUEUE_SHIFT - 8);
+	int ff = (int)((g->kv*vs + g->ka*as) >> 24);
+	if (v > 0)
+	{
+		ff += g->kc;
+	}
+	else if (v < 0)
+	{
+		ff -= g->kc;
+	}
+	return ff;
+}
+
+static void trajectory_derivatives(int index, int * v, int * a)
+{
+	int before = index > 0 ? index - 1 : index, after = index < traj_length - 1 ? index + 1 : index;
+	*v = after == before ? 0 : ((trajectory[after] - trajectory[before]) << QUEUE_SHIFT)/(after - before);
+	*a = after - before == 2 ? (trajectory[after] - 2*trajectory[index] + trajectory[before]) << QUEUE_SHIFT : 0;
 }
 
 void motion_init(void)
@@ -115,15 +257,9 @@ void motion_init(void)
 	//	frequency on the scope.  
 	//	The effect of the nScope bug will be very large here so you will
 	//	probably see a period that appears too short even when your frequency is correct
-	T2CONbits.TCS = 0;
-	T2CONbits.TCKPS = 0b011;
-	PR2 = 49999;
-	TMR2 = 0;
-	IPC2bits.T2IP = 6;
-	IPC2bits.T2IS = 0;
-	IFS0bits.T2IF = 0;
-	IEC0bits.T2IE = 1;
-	T2CONbits.ON  = 1;
+	// the motion loop runs right after a current loop tick, so it never lands
+	// just before one, and at a lower priority than the current loop
+	motion_task = sched_register("motion",motion_control,SCHED_BASE_HZ/MOTION_HZ,MOTION_PHASE,SCHED_DEFERRED);
     //TODO:
 	//setup a timer to interrupt at 200Hz.  This is your motion control loop
 	//it should be at a lower priority than the current loop
@@ -134,13 +270,100 @@ void motion_init(void)
 
     core_encoder_reset();
 	//TODO: TO save your gains to flash when the save command is issued
-	//use core_register_int and core_register_float as appropriate.
+	//use param_register_int and param_register_float as appropriate.
 	//setup E1 for digital output
-    core_register_int(&kp);
-	core_register_int(&ki);
-    core_register_int(&kd);
+    param_notify(param_register_int("m.kp",&kp,0,MAX_KP),motion_gains_commit);
+	param_notify(param_register_int("m.ki",&ki,0,MAX_KI),motion_gains_commit);
+    param_notify(param_register_int("m.kd",&kd,0,MAX_KD),motion_gains_commit);
+	param_notify(param_register_float("m.kv",&kv,0,MAX_KV),motion_gains_commit);
+	param_notify(param_register_float("m.ka",&ka,0,MAX_KA),motion_gains_commit);
+	param_notify(param_register_int("m.kc",&kc,0,MAX_KC),motion_gains_commit);
+	param_notify(param_register_int("m.vmode",&vmode,0,VELOCITY_MODES - 1),motion_gains_commit);
+	param_notify(param_register_int("m.vhz",&vhz,1,MAX_VHZ),motion_gains_commit);
+	param_register_int("m.band",&band,0,360);
+}
+
+
+unsigned int motion_period(void)
+{
+	return sched_period(motion_task);
+}
+
+void motion_period_changed(void)
+{
+	motion_gains_commit();
+}
+
+void motion_metrics_begin(unsigned int nsamples)
+{
+	metrics_begin(&metrics,nsamples,band);
+}
+
+int motion_metrics_done(void)
+{
+	return metrics_done(&metrics);
+}
+
+void motion_metrics_sprintf(char * buffer)
+{
+	metrics_sprintf(&metrics,motion_period(),buffer);
+}
+
+float motion_response_begin(float hz, int amplitude, unsigned int cycles)
+{
+	float actual = response_begin(&response,hz,motion_period(),amplitude,cycles);
+	responding = 1;
+	return actual;
+}
+
+int motion_response_done(void)
+{
+	return response_done(&response);
+}
+
+void motion_response_result(float * gain, float * phase)
+{
+	response_result(&response,gain,phase);
+}
+
+void motion_response_stop(void)
+{
+	responding = 0;
 }
 
+void motion_autotune_begin(int amplitude, int hysteresis, unsigned int cycles)
+{
+	relay_begin(&relay,hold_angle,amplitude,hysteresis,cycles);
+	tuning = 1;
+}
+
+int motion_autotune_done(void)
+{
+	return relay_done(&relay);
+}
+
+int motion_autotune_finish(char * buffer)
+{
+	float ku = 0, tu = 0;
+	tuning = 0;
+	if (!relay_result(&relay,&ku,&tu))
+	{
+		return 0;
+	}
+
+	// Ziegler-Nichols PID: Kp = 0.6 Ku, Ti = Tu/2, Td = Tu/8.  The controller is
+	// u = (kp*e + ki*sum(e) + kd*de)/100, so ki is Kp/Ti and kd is Kp*Td per tick.
+	float newkp = 0.6f*ku;
+	kp = (int)(100*newkp + 0.5f);
+	ki = (int)(100*newkp*2/tu + 0.5f);
+	kd = (int)(100*newkp*tu/8 + 0.5f);
+	kp = kp > MAX_KP ? MAX_KP : kp;
+	ki = ki > MAX_KI ? MAX_KI : ki;
+	kd = kd > MAX_KD ? MAX_KD : kd;
+	motion_gains_commit();
+	sprintf(buffer,"%f %u %d %d %d",ku,(unsigned int)(tu*motion_period()/40),kp,ki,kd);
+	return 1;
+}
 
 int motion_angle()
 {	
@@ -183,6 +406,16 @@ int motion_trajectory_set(int angle, unsigned int index)
     return check;
 }
 
+int motion_trajectory_length(void)
+{
+	return traj_length;
+}
+
+int motion_trajectory_queued(void)
+{
+	return queue_holds(&queue,SEGMENT_SAMPLES);
+}
+
 void motion_trajectory_reset(enum ResetMode mode,int angle)
 {	
 	if (mode == NOW) {
@@ -196,6 +429,7 @@ void motion_trajectory_reset(enum ResetMode mode,int angle)
     }
     eprev = 0;
     eint = 0;
+    restart = 1;
     curr_traj = 0;
     //TODO: see motion.h
     //	based on the mode you will need to
@@ -210,6 +444,150 @@ void motion_trajectory_reset(enum ResetMode mode,int angle)
 	//	to 0
 }
 
+int motion_queue_goto(int angle, int speed, int accel)
+{
+	struct Segment segment = {SEGMENT_GOTO};
+	if (angle < -MOTION_MAX_ANGLE || angle > MOTION_MAX_ANGLE || speed < 1 || accel < 1)
+	{
+		return 0;
+	}
+	segment.angle = angle;
+	segment.speed = motion_queue_rate(speed,0);
+	segment.accel = motion_queue_rate(accel,1);
+	return motion_queue_push(&segment);
+}
+
+int motion_queue_dwell(unsigned int ms)
+{
+	struct Segment segment = {SEGMENT_DWELL};
+	segment.ticks = (unsigned int)((unsigned long long)ms*(CORE_HZ/1000)/motion_period());
+	return motion_queue_push(&segment);
+}
+
+int motion_queue_trajectory(void)
+{
+	struct Segment segment = {SEGMENT_SAMPLES};
+	if (traj_length <= 0)
+	{
+		return 0;
+	}
+	segment.ticks = traj_length;
+	segment.samples = trajectory;
+	return motion_queue_push(&segment);
+}
+
+int motion_queue_pvt(int position, int velocity, unsigned int ms)
+{
+	struct Segment segment = {SEGMENT_PVT};
+	if (position < -1000*MOTION_MAX_ANGLE || position > 1000*MOTION_MAX_ANGLE
+		|| velocity < -MOTION_MAX_PVT_SPEED || velocity > MOTION_MAX_PVT_SPEED || ms > MOTION_MAX_PVT_MS)
+	{
+		return 0;
+	}
+	segment.position = (int)(((long long)position << QUEUE_SHIFT)/1000);
+	segment.velocity = (int)((long long)velocity*(1 << QUEUE_SHIFT)*motion_period()/(CORE_HZ*1000LL));
+	segment.ticks = (unsigned int)((unsigned long long)ms*(CORE_HZ/1000)/motion_period());
+	segment.ticks = segment.ticks ? segment.ticks : 1;
+
+	// The segment starts where the queue ends, at the velocity of the PVT segment before it,
+	// or at rest if the queue runs dry first.  Out of the queue it starts where the motor is.
+	int start = 0, v0 = 0;
+	if (core_state == QUEUE)
+	{
+		start = queue_end(&queue,&v0);
+	}
+	else
+	{
+		start = (core_state == HOLD ? hold_angle : motion_angle()) << QUEUE_SHIFT;
+	}
+	if (!motion_pvt_in_range(start,v0,&segment) || !motion_pvt_in_range(start,0,&segment))
+	{
+		return 0;
+	}
+	return motion_queue_push(&segment);
+}
+
+static int motion_pvt_in_range(int start, int v0, const struct Segment * segment)
+{
+	// p(t) = a t^3 + b t^2 + c t as queue.c follows it, with t from 0 to 1 over the segment;
+	// the ends are in range, so only the turning points between them can be out
+	double d = (double)segment->position - start, c = (double)v0*segment->ticks;
+	double v1 = (double)segment->velocity*segment->ticks;
+	double a = c + v1 - 2*d, b = 3*d - 2*c - v1, t[2] = {-1, -1};
+	if (a != 0)
+	{
+		// p'(t) = 3a t^2 + 2b t + c
+		double disc = b*b - 3*a*c;
+		if (disc >= 0)
+		{
+			t[0] = (-b - sqrt(disc))/(3*a);
+			t[1] = (-b + sqrt(disc))/(3*a);
+		}
+	}
+	else if (b != 0)
+	{
+		t[0] = -c/(2*b);
+	}
+
+	double limit = (double)MOTION_MAX_ANGLE*(1 << QUEUE_SHIFT);
+	limit = fabs((double)start) > limit ? fabs((double)start) : limit;
+	int i = 0;
+	for (i = 0; i != 2; ++i)
+	{
+		if (t[i] > 0 && t[i] < 1 && fabs(start + ((a*t[i] + b)*t[i] + c)*t[i]) > limit)
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int motion_queue_hold(void)
+{
+	struct Segment segment = {SEGMENT_HOLD};
+	return motion_queue_push(&segment);
+}
+
+void motion_queue_status(unsigned int * depth, unsigned int * underruns, unsigned int * completed)
+{
+	*depth = queue_depth(&queue);
+	*underruns = queue.underruns;
+	*completed = queue.completed;
+}
+
+static int motion_queue_push(const struct Segment * segment)
+{
+	if (core_state == QUEUE)
+	{
+		return queue_push(&queue,segment);
+	}
+	if (core_state != IDLE && core_state != HOLD)
+	{
+		return 0;
+	}
+	// start from the angle being held, so the motor does not move until the first segment does
+	queue_clear(&queue,core_state == HOLD ? hold_angle : motion_angle());
+	if (core_state == IDLE)
+	{
+		eprev = 0;
+		eint = 0;
+		restart = 1;
+	}
+	queue_push(&queue,segment);
+	core_state = QUEUE;
+	return 1;
+}
+
+static int motion_queue_rate(int per_second, int squared)
+{
+	float rate = (float)per_second*(1 << QUEUE_SHIFT)*motion_period()/CORE_HZ;
+	if (squared)
+	{
+		rate = rate*motion_period()/CORE_HZ;
+	}
+	return rate < 1 ? 1 : rate > MAX_QUEUE_SPEED ? MAX_QUEUE_SPEED : (int)(rate + 0.5f);
+}
+
 void motion_gains_sprintf(char * buffer)
 {	
 	//TODO: this is like the current_gains_sprintf,
@@ -219,9 +597,36 @@ void motion_gains_sprintf(char * buffer)
     sprintf(buffer,"%d %d %d",kp,ki,kd);
 }
 
-void motion_gains_sscanf(const char * buffer)
+int motion_gains_sscanf(const char * buffer)
 {
     //TODO: read the gains from the buffer using sscanf and store them
     //in the variables you defined to hold the
-    sscanf(buffer,"%d %d %d",&kp,&ki,&kd);
+	int newkp = 0, newki = 0, newkd = 0;
+	// the same bounds as the m.kp, m.ki and m.kd parameters
+	if (sscanf(buffer,"%d %d %d",&newkp,&newki,&newkd) != 3 || newkp < 0 || newkp > MAX_KP
+		|| newki < 0 || newki > MAX_KI || newkd < 0 || newkd > MAX_KD)
+	{
+		return 0;
+	}
+	kp = newkp;
+	ki = newki;
+	kd = newkd;
+	motion_gains_commit();
+	return 1;
+}
+
+static void motion_gains_commit(void)
+{
+	unsigned int next = gains_seq + 1;
+	gains[next & 1].kp = kp;
+	gains[next & 1].ki = ki;
+	gains[next & 1].kd = kd;
+	gains[next & 1].kv = (int)(kv*65536 + 0.5f);
+	gains[next & 1].ka = (int)(ka*65536 + 0.5f);
+	gains[next & 1].kc = kc;
+	// the coefficients are per tick, so motion_period_changed() commits them again
+	struct VelocityGains v;
+	velocity_gains(&v,vmode,vhz,(float)motion_period()/CORE_HZ);
+	gains[next & 1].velocity = v;
+	gains_seq = next;
 }
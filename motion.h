@@ -6,9 +6,75 @@
 /// @version 1.0
 /// @date 2014-03-01
 
+#define MOTION_HZ 200		/// the rate of the motion control loop until the period is changed, in Hz
+#define MOTION_MAX_ANGLE 10000	/// the largest angle a queued segment may go to, in degrees
+#define MOTION_MAX_PVT_SPEED 100000000 /// the largest velocity of a PVT segment, in millidegrees per second
+#define MOTION_MAX_PVT_MS 60000	/// the longest PVT segment, in ms
+
 /// @brief Initialize the motion control module
 void motion_init(void);
 
+/// @brief Get the period of the motion control loop
+/// @return the period of the motion control loop, in core timer ticks
+unsigned int motion_period(void);
+
+/// @brief Works out the coefficients that depend on the period again and publishes them with
+///	   the gains.  Call after changing the period of the motion control loop.
+void motion_period_changed(void);
+
+/// @brief Starts recording the tracking metrics of the motion loop (see metrics.h)
+///	   The motion loop records a tick in the TRACK, HOLD and QUEUE states.
+/// @param nsamples The number of ticks to record
+void motion_metrics_begin(unsigned int nsamples);
+
+/// @brief Checks whether the motion loop has recorded all the ticks of its metrics run
+/// @return 1 if the run is over
+int motion_metrics_done(void);
+
+/// @brief Writes the tracking metrics of the motion loop to the buffer, in degrees
+/// @param buffer [out] "samples rms max_error iae overshoot settling_us saturated_us"
+/// @pre   The buffer has a minimum length of 100 characters
+void motion_metrics_sprintf(char * buffer);
+
+/// @brief Starts a relay auto-tune of the motion loop (see relay.h)
+///	   From now on the HOLD state drives the motor with a relay about the hold angle instead of the
+///	   PID controller.  The current loop keeps tracking the current the relay asks for.
+/// @param amplitude  The output of the relay, in mA
+/// @param hysteresis The hysteresis of the relay, in degrees
+/// @param cycles     The number of limit cycles to measure
+void motion_autotune_begin(int amplitude, int hysteresis, unsigned int cycles);
+
+/// @brief Checks whether the relay experiment is over
+/// @return 1 if it is over
+int motion_autotune_done(void);
+
+/// @brief Ends the relay experiment and, if it produced a limit cycle, sets kp, ki and kd from
+///	   the ultimate gain and period with the Ziegler-Nichols PID rule
+/// @param buffer [out] "ku tu_us kp ki kd"
+/// @pre   The buffer has a minimum length of 100 characters
+/// @return 1 if the gains were set, 0 if no limit cycle was measured
+int motion_autotune_finish(char * buffer);
+
+/// @brief Starts measuring the frequency response of the motion loop at one frequency (see response.h)
+///	   From now on the HOLD state tracks a sine about the hold angle.
+/// @param hz        The frequency, in Hz
+/// @param amplitude The amplitude of the sine, in degrees
+/// @param cycles    The number of periods to measure
+/// @return the frequency actually used, in Hz
+float motion_response_begin(float hz, int amplitude, unsigned int cycles);
+
+/// @brief Checks whether the frequency response measurement is over
+/// @return 1 if it is over
+int motion_response_done(void);
+
+/// @brief Get the result of the frequency response measurement
+/// @param gain  [out] The measured angle over the reference, about the hold angle
+/// @param phase [out] The phase of the measured angle relative to the reference, in degrees
+void motion_response_result(float * gain, float * phase);
+
+/// @brief Makes the HOLD state track the hold angle again
+void motion_response_stop(void);
+
 /// @brief Get the angle of the motor 
 /// @return the angle of the motor, in degrees
 int motion_angle(void);
@@ -25,6 +91,58 @@ int motion_angle(void);
 ///		you can also set the error integral to zero
 int motion_trajectory_set(int angle, unsigned int index);
 
+/// @brief Get the length of the trajectory
+/// @return the number of angles in the trajectory, 0 if none has been set
+int motion_trajectory_length(void);
+
+/// @brief Checks whether the motion queue holds or is running the trajectory, which may then
+///	   not be changed
+/// @return 1 if it is
+int motion_trajectory_queued(void);
+
+
+/// @brief Appends a goto to the motion queue (see queue.h).  Appending to the queue starts the
+///	   QUEUE state if the motor is idle or holding, from the angle it holds; the segments then
+///	   run back to back.  End a sequence with a hold, or its end counts as an underrun.
+/// @param angle The target, in degrees, at most MOTION_MAX_ANGLE either way
+/// @param speed The top speed, in degrees per second, at least 1
+/// @param accel The acceleration and deceleration, in degrees per second squared, at least 1
+/// @return 1 on success, 0 if an argument is out of range, the queue is full, or the motor is
+///	    doing something other than idling, holding or running the queue
+int motion_queue_goto(int angle, int speed, int accel);
+
+/// @brief Appends a dwell at the reference to the motion queue
+/// @param ms How long to stay, in ms
+/// @return 1 on success, 0 as motion_queue_goto()
+int motion_queue_dwell(unsigned int ms);
+
+/// @brief Appends the trajectory to the motion queue, one angle per tick as the TRACK state
+///	   runs it.  The angles are read as the segment runs, so a new trajectory cannot be
+///	   loaded until it is over (see motion_trajectory_queued()).
+/// @return 1 on success, 0 if no trajectory is loaded or as motion_queue_goto()
+int motion_queue_trajectory(void);
+
+/// @brief Appends a PVT segment to the motion queue: a cubic from the reference, at the
+///	   velocity the previous PVT segment ended with (0 after any other segment), to position
+///	   at velocity ms later.  The cubic may overshoot its ends, and is refused if it would
+///	   pass MOTION_MAX_ANGLE whether it starts at that velocity or at rest.
+/// @param position The position at the end, in millidegrees, at most 1000*MOTION_MAX_ANGLE either way
+/// @param velocity The velocity at the end, in millidegrees per second, at most MOTION_MAX_PVT_SPEED either way
+/// @param ms       The duration, in ms, at least one motion tick and at most MOTION_MAX_PVT_MS
+/// @return 1 on success, 0 if the cubic leaves the angle range or as motion_queue_goto()
+int motion_queue_pvt(int position, int velocity, unsigned int ms);
+
+/// @brief Appends a hold to the motion queue: the reference stays until the next segment is
+///	   appended, without counting an underrun
+/// @return 1 on success, 0 as motion_queue_goto()
+int motion_queue_hold(void);
+
+/// @brief Get the progress of the motion queue since it last started
+/// @param depth     [out] The segments that have not finished, the one running included
+/// @param underruns [out] The segments that ended with no segment queued after them
+/// @param completed [out] The segments that have finished
+void motion_queue_status(unsigned int * depth, unsigned int * underruns, unsigned int * completed);
+
 
 /// modes for how to reset the motion controller
 // an enumeration is essentially just a list of constants
@@ -66,6 +184,9 @@ void motion_gains_sprintf(char * buffer);
 /// @param buffer String containing the gains as numbers separated by ' ' (spaces)
 /// @post  The gains that you need for motion control should be set according to
 ///	   values read from the buffer
-void motion_gains_sscanf(const char * buffer);
+///	   The controller may keep running: the new gains take effect together at its next tick.
+/// @return 1 on success, 0 if the buffer does not hold three gains within the bounds of m.kp,
+///	    m.ki and m.kd, in which case the gains are unchanged
+int motion_gains_sscanf(const char * buffer);
 
 #endif
@@ -0,0 +1,467 @@
+#include "NU32.h"
+#include "param.h"
+#include "dee_emulation_pic32.h" /// emulates an eeprom using program flash
+
+/// @file param.c
+/// @brief Implements the parameter registry and its flash storage
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define HASH_SIZE 64		/// slots in the name lookup table, a power of two larger than MAX_PARAMS
+#define PARAM_MAGIC 0xBEEF	/// marks the flash header and every profile that has been saved
+#define LEGACY_MAGIC 0xDEAD	/// marks gains saved by firmware older than the profiles
+
+// Flash layout: address 0 holds PARAM_MAGIC and address 1 the active profile.
+// Profile p occupies PROFILE_WORDS words starting at PROFILE_BASE + p*PROFILE_WORDS:
+// PARAM_MAGIC, the number of saved parameters, the name, then one
+// (name hash, value) pair of words per parameter.
+#define ADDR_MAGIC 0
+#define ADDR_ACTIVE 1
+#define PROFILE_BASE 2
+#define NAME_WORDS (PROFILE_NAME_LEN/4)
+#define PROFILE_WORDS (3 + NAME_WORDS + 2*MAX_PARAMS)
+#define OFF_MAGIC 0
+#define OFF_COUNT 1
+#define OFF_NAME 2
+#define OFF_PAIRS (2 + NAME_WORDS)
+
+// Older firmware wrote LEGACY_MAGIC at address 0 and then the values of
+// legacy_names at addresses 1 on.  param_load() moves them into profile 0 once.
+#define LEGACY_PARAMS 5
+static const char * legacy_names[LEGACY_PARAMS] = {"i.kp", "i.ki", "m.kp", "m.ki", "m.kd"};
+
+#if PROFILE_BASE + MAX_PROFILES*PROFILE_WORDS > DATA_EE_SIZE
+#error "The parameter profiles do not fit in the emulated eeprom"
+#endif
+
+struct Param {
+	const char * name;	// the name of the parameter
+	unsigned int hash;	// the hash of the name
+	enum ParamType type;	// the type of the value
+	void * value;		// points to the variable holding the parameter
+	int imin, imax;		// bounds for PARAM_INT
+	float fmin, fmax;	// bounds for PARAM_FLOAT
+	void (*commit)(void);	// called after the value changes, may be 0
+};
+
+static struct Param params[MAX_PARAMS];
+static int nparams = 0;
+
+// maps a hash slot to an index into params, or -1 if the slot is empty
+// open addressing with linear probing
+static signed char table[HASH_SIZE];
+static int table_ready = 0;
+
+/// @brief FNV-1a hash of a string
+static unsigned int hash_name(const char * name);
+
+/// @brief Finds the index of the parameter with the given hash
+/// @return the index, or -1 if there is none
+static int find_hash(unsigned int hash);
+
+/// @brief Checks whether the raw value read from flash lies within the bounds of p
+static int in_bounds(const struct Param * p, unsigned int data);
+
+/// @brief Sets the staged values with the control loops held off, then calls their commits
+/// @param staged The raw value of each parameter
+/// @param valid  Nonzero for each parameter whose staged value is set
+static void apply(const unsigned int * staged, const char * valid);
+
+/// @brief Loads gains saved in the legacy layout and saves them again as profile 0
+/// @return 0 if the flash does not hold the legacy layout
+static int legacy_load(void);
+
+/// @brief Adds a parameter to the registry
+/// @return the index of the parameter or -1 on failure
+static int add(const char * name, enum ParamType type, void * value);
+
+int param_register_int(const char * name, int * value, int min, int max)
+{
+	int index = add(name, PARAM_INT, value);
+	if (index >= 0)
+	{
+		params[index].imin = min;
+		params[index].imax = max;
+	}
+	return index;
+}
+
+int param_register_float(const char * name, float * value, float min, float max)
+{
+	int index = add(name, PARAM_FLOAT, value);
+	if (index >= 0)
+	{
+		params[index].fmin = min;
+		params[index].fmax = max;
+	}
+	return index;
+}
+
+void param_notify(int index, void (*commit)(void))
+{
+	if (index >= 0 && index < nparams)
+	{
+		params[index].commit = commit;
+	}
+}
+
+int param_find(const char * name)
+{
+	int index = find_hash(hash_name(name));
+	if (index >= 0 && strcmp(params[index].name, name) != 0)
+	{
+		index = -1; // a different name with the same hash
+	}
+	return index;
+}
+
+int param_count(void)
+{
+	return nparams;
+}
+
+int param_set(int index, const char * text)
+{
+	if (index < 0 || index >= nparams)
+	{
+		return 0;
+	}
+
+	struct Param * p = &params[index];
+	if (p->type == PARAM_INT)
+	{
+		int i = 0;
+		if (sscanf(text,"%d",&i) != 1 || i < p->imin || i > p->imax)
+		{
+			return 0;
+		}
+		*(int *)p->value = i;
+	}
+	else
+	{
+		float f = 0;
+		if (sscanf(text,"%f",&f) != 1 || !(f >= p->fmin && f <= p->fmax))
+		{
+			return 0;
+		}
+		*(float *)p->value = f;
+	}
+
+	if (p->commit)
+	{
+		p->commit();
+	}
+	return 1;
+}
+
+int param_sprintf(int index, char * buffer)
+{
+	if (index < 0 || index >= nparams)
+	{
+		return 0;
+	}
+
+	if (params[index].type == PARAM_INT)
+	{
+		sprintf(buffer,"%d",*(int *)params[index].value);
+	}
+	else
+	{
+		sprintf(buffer,"%f",*(float *)params[index].value);
+	}
+	return 1;
+}
+
+int param_describe(int index, char * buffer)
+{
+	if (index < 0 || index >= nparams)
+	{
+		return 0;
+	}
+
+	struct Param * p = &params[index];
+	if (p->type == PARAM_INT)
+	{
+		sprintf(buffer,"%s i %d %d %d",p->name,*(int *)p->value,p->imin,p->imax);
+	}
+	else
+	{
+		sprintf(buffer,"%s f %f %f %f",p->name,*(float *)p->value,p->fmin,p->fmax);
+	}
+	return 1;
+}
+
+void param_save(void)
+{
+	param_profile_save(param_profile_active(),0);
+}
+
+void param_load(void)
+{
+	if (legacy_load())
+	{
+		return;
+	}
+	param_profile_load(param_profile_active());
+}
+
+int param_profile_active(void)
+{
+	unsigned int magic = 0, active = 0;
+	DataEERead(&magic,ADDR_MAGIC);
+	DataEERead(&active,ADDR_ACTIVE);
+	if (magic != PARAM_MAGIC || active >= MAX_PROFILES)
+	{
+		active = 0; // nothing saved yet
+	}
+	return active;
+}
+
+int param_profile_name(int profile, char * name)
+{
+	name[0] = '\0';
+	if (profile < 0 || profile >= MAX_PROFILES)
+	{
+		return 0;
+	}
+
+	unsigned int base = PROFILE_BASE + profile*PROFILE_WORDS;
+	unsigned int magic = 0, words[NAME_WORDS];
+	DataEERead(&magic,base + OFF_MAGIC);
+	if (magic != PARAM_MAGIC)
+	{
+		return 0;
+	}
+
+	int i = 0;
+	for (i = 0; i != NAME_WORDS; ++i)
+	{
+		DataEERead(&words[i],base + OFF_NAME + i);
+	}
+	memcpy(name,words,PROFILE_NAME_LEN);
+	name[PROFILE_NAME_LEN] = '\0';
+	return 1;
+}
+
+int param_profile_save(int profile, const char * name)
+{
+	if (profile < 0 || profile >= MAX_PROFILES)
+	{
+		return 0;
+	}
+
+	unsigned int base = PROFILE_BASE + profile*PROFILE_WORDS;
+	unsigned int words[NAME_WORDS];
+	char old_name[PROFILE_NAME_LEN + 1];
+	if (!name) // keep the name the profile already has
+	{
+		param_profile_name(profile,old_name);
+		name = old_name;
+	}
+	memset(words,0,sizeof(words));
+	memcpy(words,name,strlen(name) < PROFILE_NAME_LEN ? strlen(name) : PROFILE_NAME_LEN);
+
+	INTDisableInterrupts();
+	DataEEWrite(PARAM_MAGIC,ADDR_MAGIC);
+	DataEEWrite(profile,ADDR_ACTIVE);
+	DataEEWrite(PARAM_MAGIC,base + OFF_MAGIC);
+	DataEEWrite(nparams,base + OFF_COUNT);
+
+	int i = 0;
+	for (i = 0; i != NAME_WORDS; ++i)
+	{
+		DataEEWrite(words[i],base + OFF_NAME + i);
+	}
+
+	for (i = 0; i != nparams; ++i)
+	{
+		DataEEWrite(params[i].hash,base + OFF_PAIRS + 2*i);
+		DataEEWrite(*(unsigned int *)params[i].value,base + OFF_PAIRS + 2*i + 1);
+	}
+	INTEnableInterrupts();
+	return 1;
+}
+
+int param_profile_load(int profile)
+{
+	if (profile < 0 || profile >= MAX_PROFILES)
+	{
+		return 0;
+	}
+
+	unsigned int base = PROFILE_BASE + profile*PROFILE_WORDS;
+	unsigned int data = 0, count = 0;
+	DataEERead(&data,base + OFF_MAGIC);
+	DataEERead(&count,base + OFF_COUNT);
+	if (data != PARAM_MAGIC || count > MAX_PARAMS)
+	{
+		return 0; // this profile has never been saved
+	}
+
+	// Read the whole profile with the controllers still running, then
+	// apply it in one go so no control tick sees a half-applied set of gains
+	unsigned int staged[MAX_PARAMS];
+	char valid[MAX_PARAMS];
+	memset(valid,0,sizeof(valid));
+
+	unsigned int i = 0, hash = 0;
+	for (i = 0; i != count; ++i)
+	{
+		DataEERead(&hash,base + OFF_PAIRS + 2*i);
+		DataEERead(&data,base + OFF_PAIRS + 2*i + 1);
+
+		int index = find_hash(hash);
+		if (index >= 0 && in_bounds(&params[index],data)) // skip parameters that no longer exist
+		{
+			staged[index] = data;
+			valid[index] = 1;
+		}
+	}
+
+	apply(staged,valid);
+
+	if (profile != param_profile_active())
+	{
+		INTDisableInterrupts();
+		DataEEWrite(PARAM_MAGIC,ADDR_MAGIC);
+		DataEEWrite(profile,ADDR_ACTIVE);
+		INTEnableInterrupts();
+	}
+	return 1;
+}
+
+static void apply(const unsigned int * staged, const char * valid)
+{
+	void (*commits[MAX_PARAMS])(void);
+	int ncommits = 0, j = 0, k = 0;
+	INTDisableInterrupts();
+	for (j = 0; j != nparams; ++j)
+	{
+		if (valid[j])
+		{
+			*(unsigned int *)params[j].value = staged[j];
+
+			// remember each commit function once, they are called after all values are in place
+			for (k = 0; k != ncommits && commits[k] != params[j].commit; ++k)
+			{
+				;
+			}
+			if (k == ncommits && params[j].commit)
+			{
+				commits[ncommits++] = params[j].commit;
+			}
+		}
+	}
+
+	for (k = 0; k != ncommits; ++k)
+	{
+		commits[k]();
+	}
+	INTEnableInterrupts();
+}
+
+static int legacy_load(void)
+{
+	unsigned int magic = 0;
+	DataEERead(&magic,ADDR_MAGIC);
+	if (magic != LEGACY_MAGIC)
+	{
+		return 0;
+	}
+
+	// the legacy words overlap the header and profile 0, so all are read before anything is saved
+	unsigned int staged[MAX_PARAMS], data = 0;
+	char valid[MAX_PARAMS];
+	memset(valid,0,sizeof(valid));
+
+	int i = 0;
+	for (i = 0; i != LEGACY_PARAMS; ++i)
+	{
+		int index = param_find(legacy_names[i]);
+		DataEERead(&data,i + 1);
+		if (index >= 0 && in_bounds(&params[index],data))
+		{
+			staged[index] = data;
+			valid[index] = 1;
+		}
+	}
+	apply(staged,valid);
+	param_profile_save(0,"");
+	return 1;
+}
+
+static int in_bounds(const struct Param * p, unsigned int data)
+{
+	if (p->type == PARAM_INT)
+	{
+		int v = (int)data;
+		return v >= p->imin && v <= p->imax;
+	}
+	else
+	{
+		float v = 0;
+		memcpy(&v,&data,sizeof(v));
+		return v >= p->fmin && v <= p->fmax;
+	}
+}
+
+static unsigned int hash_name(const char * name)
+{
+	unsigned int hash = 2166136261u;
+	while (*name != '\0')
+	{
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+		++name;
+	}
+	return hash;
+}
+
+static int find_hash(unsigned int hash)
+{
+	if (!table_ready)
+	{
+		return -1;
+	}
+
+	unsigned int slot = hash & (HASH_SIZE - 1);
+	while (table[slot] >= 0)
+	{
+		if (params[(int)table[slot]].hash == hash)
+		{
+			return table[slot];
+		}
+		slot = (slot + 1) & (HASH_SIZE - 1);
+	}
+	return -1;
+}
+
+static int add(const char * name, enum ParamType type, void * value)
+{
+	if (!table_ready)
+	{
+		memset(table,-1,sizeof(table));
+		table_ready = 1;
+	}
+
+	unsigned int hash = hash_name(name);
+	if (!value || nparams == MAX_PARAMS || find_hash(hash) >= 0)
+	{
+		return -1; // the registry is full or the name (hash) is already taken
+	}
+
+	unsigned int slot = hash & (HASH_SIZE - 1);
+	while (table[slot] >= 0)
+	{
+		slot = (slot + 1) & (HASH_SIZE - 1);
+	}
+	table[slot] = nparams;
+
+	params[nparams].name = name;
+	params[nparams].hash = hash;
+	params[nparams].type = type;
+	params[nparams].value = value;
+	params[nparams].commit = 0;
+	return nparams++;
+}
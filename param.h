@@ -0,0 +1,113 @@
+#ifndef PARAM_H_
+#define PARAM_H_
+/// @file param.h
+/// @brief A registry of named, typed and bounded parameters (gains and other tunables)
+///	   Modules register their tunables by name during initialization.  The registry
+///	   can then get, set and list them generically, and save and load them from flash.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief The maximum number of parameters that can be registered
+#define MAX_PARAMS 32
+
+/// @brief The number of parameter profiles that can be stored in flash
+#define MAX_PROFILES 8
+
+/// @brief The maximum length of a profile name, a multiple of 4
+#define PROFILE_NAME_LEN 12
+
+/// @brief The type of a registered parameter
+enum ParamType {
+		PARAM_INT,	/// the parameter is an int
+		PARAM_FLOAT	/// the parameter is a float
+	       };
+
+/// @brief Registers a named integer parameter
+///	   This should be called during initialization.
+///	   Subsequently, the parameter can be accessed by name and saved to and loaded from flash.
+/// @param name  The name of the parameter, such as "i.kp".  The string must remain valid forever.
+/// @param value Pointer to the variable holding the parameter
+/// @param min   The smallest value the parameter may be set to
+/// @param max   The largest value the parameter may be set to
+/// @return the index of the parameter, or -1 if the registry is full or the name is taken
+int param_register_int(const char * name, int * value, int min, int max);
+
+/// @brief Registers a named float parameter
+/// @see param_register_int
+int param_register_float(const char * name, float * value, float min, float max);
+
+/// @brief Registers a function that publishes a parameter after it changes.
+///	   Modules that double buffer their gains for an interrupt use this to flip buffers
+///	   once a new value has been written. Several parameters may share one function.
+/// @param index  The index of the parameter, as returned when it was registered
+/// @param commit The function to call after the parameter is set or loaded from flash
+void param_notify(int index, void (*commit)(void));
+
+/// @brief Finds a parameter by its name
+/// @param name The name of the parameter
+/// @return the index of the parameter, or -1 if no such parameter is registered
+int param_find(const char * name);
+
+/// @brief Get the number of registered parameters
+/// @return the number of registered parameters. Valid indices are 0 to param_count() - 1
+int param_count(void);
+
+/// @brief Sets a parameter from its textual representation
+/// @param index The index of the parameter
+/// @param text  The new value, as a decimal number
+/// @return 1 on success, 0 if the index is invalid, the text cannot be parsed or the value is out of bounds
+/// @post  On failure the parameter is unchanged. On success its commit function has been called.
+int param_set(int index, const char * text);
+
+/// @brief Writes the value of a parameter to the buffer
+/// @param index The index of the parameter
+/// @param buffer [out] The value is written here as a decimal number
+/// @pre   The buffer has a minimum length of 100 characters
+/// @return 1 on success, 0 if the index is invalid
+int param_sprintf(int index, char * buffer);
+
+/// @brief Writes a description of a parameter to the buffer
+///	   The format is "name type value min max" where type is 'i' or 'f'
+/// @param index The index of the parameter
+/// @param buffer [out] The description is written here
+/// @pre   The buffer has a minimum length of 100 characters
+/// @return 1 on success, 0 if the index is invalid
+int param_describe(int index, char * buffer);
+
+/// @brief Saves all registered parameters to the active profile in flash
+///	   Each value is stored alongside the hash of its name, so the order of registration may change
+///	   between firmware versions without scrambling the saved values.
+void param_save(void);
+
+/// @brief Loads all registered parameters from the active profile in flash
+///	   Parameters that were never saved, or whose saved value is out of bounds, are left unchanged.
+void param_load(void);
+
+/// @brief Get the active profile. This is the profile that param_save and param_load use,
+///	   and it is remembered in flash across resets.
+/// @return the index of the active profile, between 0 and MAX_PROFILES - 1
+int param_profile_active(void);
+
+/// @brief Get the name of a profile
+/// @param profile The index of the profile
+/// @param name [out] The name of the profile. Must hold PROFILE_NAME_LEN + 1 characters.
+/// @return 1 if the profile has been saved, 0 if it is empty or the index is invalid
+int param_profile_name(int profile, char * name);
+
+/// @brief Saves all registered parameters to a profile and makes it the active profile
+/// @param profile The index of the profile
+/// @param name    The name of the profile, truncated to PROFILE_NAME_LEN characters.
+///		   If 0, the profile keeps its existing name.
+/// @return 1 on success, 0 if the index is invalid
+int param_profile_save(int profile, const char * name);
+
+/// @brief Loads all parameters from a profile and makes it the active profile.
+///	   The profile is read from flash while the controllers keep running, and the new values
+///	   are then applied all at once between control ticks, so there is no need to go to IDLE.
+/// @param profile The index of the profile
+/// @return 1 on success, 0 if the profile is empty or the index is invalid
+/// @post  On failure no parameters are changed
+int param_profile_load(int profile);
+
+#endif
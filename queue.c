@@ -0,0 +1,264 @@
+#include "NU32.h"
+#include "queue.h"
+
+/// @file queue.c
+/// @brief Implements the motion segment queue
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief Starts running a segment from the present reference
+static void segment_begin(struct Queue * q, const volatile struct Segment * s);
+
+/// @brief Get the position of the running goto after q->tick ticks, relative to its start
+static int goto_position(const struct Queue * q);
+
+/// @brief Get the position of the running PVT segment after q->tick ticks, relative to its start
+static int pvt_position(const struct Queue * q);
+
+/// @brief Get the integer square root of n, rounded up
+static unsigned int sqrt_ceil(unsigned long long n);
+
+void queue_clear(struct Queue * q, int angle)
+{
+	unsigned int status = INTDisableInterrupts();
+	q->head = q->tail = 0;
+	q->running = 0;
+	q->tick = 0;
+	q->start = q->position = angle << QUEUE_SHIFT;
+	q->velocity = 0;
+	q->acceleration = 0;
+	q->pvt_velocity = 0;
+	q->underruns = 0;
+	q->completed = 0;
+	INTRestoreInterrupts(status);
+}
+
+int queue_push(struct Queue * q, const struct Segment * s)
+{
+	unsigned int head = q->head;
+	if (head - q->tail == QUEUE_LENGTH)
+	{
+		return 0;
+	}
+	// the loop only reads a segment once head counts it, and head is a single store
+	volatile struct Segment * slot = &q->segments[head % QUEUE_LENGTH];
+	slot->type = s->type;
+	slot->angle = s->angle;
+	slot->speed = s->speed;
+	slot->accel = s->accel;
+	slot->ticks = s->ticks;
+	slot->position = s->position;
+	slot->velocity = s->velocity;
+	slot->samples = s->samples;
+	q->head = head + 1; // publish
+	return 1;
+}
+
+int queue_step(struct Queue * q)
+{
+	if (q->running && q->run.type == SEGMENT_HOLD && q->head != q->tail)
+	{
+		q->running = 0;
+		++q->completed;
+	}
+	if (!q->running && q->head != q->tail)
+	{
+		segment_begin(q,&q->segments[q->tail % QUEUE_LENGTH]);
+		++q->tail;
+	}
+
+	int previous = q->position;
+	if (q->running && q->run.type != SEGMENT_HOLD)
+	{
+		++q->tick;
+		if (q->run.type == SEGMENT_GOTO)
+		{
+			q->position = q->start + goto_position(q);
+		}
+		else if (q->run.type == SEGMENT_SAMPLES)
+		{
+			q->position = q->run.samples[q->tick - 1] << QUEUE_SHIFT;
+		}
+		else if (q->run.type == SEGMENT_PVT)
+		{
+			q->position = q->start + pvt_position(q);
+		}
+		if (q->tick >= q->run.ticks)
+		{
+			q->running = 0;
+			++q->completed;
+			if (q->head == q->tail)
+			{
+				++q->underruns;
+			}
+			// the next PVT segment carries on at this velocity, unless the reference stops here
+			q->pvt_velocity = q->run.type == SEGMENT_PVT && q->head != q->tail ? q->run.velocity : 0;
+		}
+	}
+	q->acceleration = q->position - previous - q->velocity;
+	q->velocity = q->position - previous;
+	return q->position;
+}
+
+int queue_velocity(const struct Queue * q)
+{
+	return q->velocity;
+}
+
+int queue_acceleration(const struct Queue * q)
+{
+	return q->acceleration;
+}
+
+unsigned int queue_depth(const struct Queue * q)
+{
+	return q->head - q->tail + q->running;
+}
+
+int queue_end(const struct Queue * q, int * velocity)
+{
+	unsigned int status = INTDisableInterrupts();
+	const volatile struct Segment * s = 0;
+	unsigned int i = 0;
+	for (i = q->head; i != q->tail && !s; --i)
+	{
+		// dwells and holds leave the reference where the segment before them did
+		const volatile struct Segment * p = &q->segments[(i - 1) % QUEUE_LENGTH];
+		s = p->type == SEGMENT_DWELL || p->type == SEGMENT_HOLD ? 0 : p;
+	}
+	int end = q->position;
+	if (!s && q->running && q->run.type != SEGMENT_DWELL && q->run.type != SEGMENT_HOLD)
+	{
+		s = &q->run;
+	}
+	if (s && s->type == SEGMENT_GOTO)
+	{
+		end = s->angle << QUEUE_SHIFT;
+	}
+	else if (s && s->type == SEGMENT_PVT)
+	{
+		end = s->position;
+	}
+	else if (s && s->type == SEGMENT_SAMPLES)
+	{
+		end = s->samples[s->ticks - 1] << QUEUE_SHIFT;
+	}
+
+	// the last segment appended, or the one running if none is waiting
+	s = q->head != q->tail ? &q->segments[(q->head - 1) % QUEUE_LENGTH] : q->running ? &q->run : 0;
+	*velocity = s && s->type == SEGMENT_PVT ? s->velocity : 0;
+	INTRestoreInterrupts(status);
+	return end;
+}
+
+int queue_holds(const struct Queue * q, enum SegmentType type)
+{
+	// A tick of the loop cannot be interrupted by the foreground, and only the foreground
+	// writes the slots.  A segment taken off after tail is read is still in its slot, and one
+	// taken off before is in run, so nothing is missed.
+	unsigned int i = 0;
+	for (i = q->tail; i != q->head; ++i)
+	{
+		if (q->segments[i % QUEUE_LENGTH].type == type)
+		{
+			return 1;
+		}
+	}
+	return q->running && q->run.type == type;
+}
+
+static void segment_begin(struct Queue * q, const volatile struct Segment * s)
+{
+	// the foreground does not write a segment head counts, so the copy is consistent
+	q->run.type = s->type;
+	q->run.angle = s->angle;
+	q->run.speed = s->speed;
+	q->run.accel = s->accel;
+	q->run.ticks = s->ticks;
+	q->run.position = s->position;
+	q->run.velocity = s->velocity;
+	q->run.samples = s->samples;
+	q->running = 1;
+	q->tick = 0;
+	q->start = q->position;
+	if (q->run.type == SEGMENT_PVT)
+	{
+		// p(t) = a t^3 + b t^2 + c t from p(0) = 0, p'(0) = T v0 to p(1) = d, p'(1) = T v1
+		long long d = (long long)q->run.position - q->start;
+		long long v0 = (long long)q->pvt_velocity*q->run.ticks, v1 = (long long)q->run.velocity*q->run.ticks;
+		q->cubic[0] = v0 + v1 - 2*d;
+		q->cubic[1] = 3*d - 2*v0 - v1;
+		q->cubic[2] = v0;
+		return;
+	}
+	q->pvt_velocity = 0;
+	if (q->run.type != SEGMENT_GOTO)
+	{
+		return;
+	}
+
+	// Ramps of n ticks up to a top speed v and back, with c ticks at v in between, cover
+	// v*(n + c), so v follows from the distance once n and c are whole numbers of ticks.
+	// n >= speed/accel and n*n >= distance/accel keep v/n within the acceleration.
+	long long distance = ((long long)q->run.angle << QUEUE_SHIFT) - q->start;
+	unsigned long long d = distance < 0 ? -distance : distance;
+	unsigned int ramp = (q->run.speed + q->run.accel - 1)/q->run.accel, cruise = 0;
+	if (d >= (unsigned long long)q->run.speed*ramp)
+	{
+		cruise = (d + q->run.speed - 1)/q->run.speed - ramp;
+	}
+	else
+	{
+		ramp = sqrt_ceil((d + q->run.accel - 1)/q->run.accel);
+	}
+	q->distance = distance;
+	q->ramp = ramp ? ramp : 1;
+	q->cruise = cruise;
+	q->run.ticks = 2*q->ramp + cruise;
+}
+
+static int goto_position(const struct Queue * q)
+{
+	long long n = q->ramp, c = q->cruise, k = q->tick;
+	if (k <= n)
+	{
+		return q->distance*k*k/(2*n*(n + c));
+	}
+	if (k <= n + c)
+	{
+		return q->distance*(2*k - n)/(2*(n + c));
+	}
+	k = 2*n + c - k;
+	return q->distance - q->distance*k*k/(2*n*(n + c));
+}
+
+static int pvt_position(const struct Queue * q)
+{
+	// t in 16 bits, which is exactly 1 on the last tick
+	long long t = ((long long)q->tick << 16)/q->run.ticks;
+	return ((((q->cubic[0]*t >> 16) + q->cubic[1])*t >> 16) + q->cubic[2])*t >> 16;
+}
+
+static unsigned int sqrt_ceil(unsigned long long n)
+{
+	unsigned long long root = 0, bit = 1ULL << 62;
+	while (bit > n)
+	{
+		bit >>= 2;
+	}
+	while (bit)
+	{
+		if (n >= root + bit)
+		{
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return n ? root + 1 : root;
+}
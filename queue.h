@@ -0,0 +1,99 @@
+#ifndef QUEUE_H_
+#define QUEUE_H_
+/// @file queue.h
+/// @brief A queue of motion segments that a control loop runs back to back
+///	   The foreground appends segments while the loop takes them off the other end, one tick
+///	   at a time, so a sequence of moves runs without waiting for the host between them.
+///	   Positions are kept in degrees << QUEUE_SHIFT, so slow moves still advance every tick.
+///	   A goto follows a trapezoidal velocity profile with whole ticks of acceleration, cruise
+///	   and deceleration, evaluated exactly from the tick count so it ends on its target.
+///	   A PVT segment is the cubic Hermite polynomial from the reference, and the velocity the
+///	   previous PVT segment ended with, to a position and velocity a number of ticks later.  Its
+///	   coefficients are worked out when it begins; each tick then evaluates the cubic in Horner
+///	   form with the time as a fraction of the segment in 16 bits, so it too ends on its target.
+///	   When a segment ends with nothing queued after it the reference stays where it is and
+///	   an underrun is counted, unless the segment was a hold, which waits for the next one.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define QUEUE_LENGTH 32		/// the most segments waiting to run
+#define QUEUE_SHIFT 16		/// positions are in degrees << QUEUE_SHIFT
+
+/// @brief What a segment does
+enum SegmentType {
+		SEGMENT_GOTO,		/// moves to angle with a trapezoidal profile
+		SEGMENT_DWELL,		/// stays at the reference for ticks ticks
+		SEGMENT_SAMPLES,	/// follows samples, one angle per tick, for ticks ticks
+		SEGMENT_HOLD,		/// stays at the reference until the next segment is queued
+		SEGMENT_PVT		/// reaches position and velocity in ticks ticks
+		};
+
+/// @brief A segment
+struct Segment {
+	enum SegmentType type;
+	int angle;			/// SEGMENT_GOTO: the target, in degrees
+	int speed;			/// SEGMENT_GOTO: the top speed, in degrees << QUEUE_SHIFT per tick, at least 1
+	int accel;			/// SEGMENT_GOTO: the acceleration, in degrees << QUEUE_SHIFT per tick per tick, at least 1
+	unsigned int ticks;		/// SEGMENT_DWELL, SEGMENT_SAMPLES and SEGMENT_PVT: the length, SEGMENT_PVT at least 1
+	int position;			/// SEGMENT_PVT: the position at the end, in degrees << QUEUE_SHIFT
+	int velocity;			/// SEGMENT_PVT: the velocity at the end, in degrees << QUEUE_SHIFT per tick
+	const int * samples;		/// SEGMENT_SAMPLES: the angles, in degrees
+};
+
+/// @brief A queue.  The fields are private to queue.c.
+struct Queue {
+	volatile struct Segment segments[QUEUE_LENGTH];	// volatile so the writes cannot move past the write to head
+	volatile unsigned int head;	// the number of segments appended
+	volatile unsigned int tail;	// the number of segments taken off by the loop
+	struct Segment run;		// the segment running
+	volatile int running;		// 1 while run has ticks left, or is a hold
+	unsigned int tick;		// the ticks of run done
+	int start;			// the reference when run began
+	int position;			// the reference
+	int velocity;			// the change of the reference on the last tick
+	int acceleration;		// the change of velocity on the last tick
+	int pvt_velocity;		// the velocity the last segment ended with if it was a PVT segment, else 0
+	long long distance;		// SEGMENT_GOTO: the distance to go, signed
+	unsigned int ramp;		// SEGMENT_GOTO: the ticks of acceleration, and of deceleration
+	unsigned int cruise;		// SEGMENT_GOTO: the ticks at top speed
+	long long cubic[3];		// SEGMENT_PVT: the coefficients of t^3, t^2 and t, for t from 0 to 1
+	volatile unsigned int underruns;	// segments that ended with nothing queued after them
+	volatile unsigned int completed;	// segments that ran to the end
+};
+
+/// @brief Empties the queue and resets its counters
+/// @param q     The queue
+/// @param angle The reference the first segment starts from, in degrees
+void queue_clear(struct Queue * q, int angle);
+
+/// @brief Appends a segment.  Called from the foreground while the loop may be running.
+/// @return 1 on success, 0 if the queue is full
+int queue_push(struct Queue * q, const struct Segment * s);
+
+/// @brief Runs the queue for one tick.  Called from the control loop interrupt.
+/// @return the reference for this tick, in degrees << QUEUE_SHIFT
+int queue_step(struct Queue * q);
+
+/// @brief Get the change of the reference on the last tick
+/// @return the velocity of the reference, in degrees << QUEUE_SHIFT per tick
+int queue_velocity(const struct Queue * q);
+
+/// @brief Get the change of the velocity of the reference on the last tick
+/// @return the acceleration of the reference, in degrees << QUEUE_SHIFT per tick per tick
+int queue_acceleration(const struct Queue * q);
+
+/// @brief Get the number of segments that have not finished, the one running included
+unsigned int queue_depth(const struct Queue * q);
+
+/// @brief Get where the segments appended so far leave the reference.  Called from the foreground.
+/// @param velocity [out] The velocity a PVT segment appended now starts at unless the queue
+///		    runs dry first, in degrees << QUEUE_SHIFT per tick: 0 unless it follows a PVT segment
+/// @return the reference, in degrees << QUEUE_SHIFT
+int queue_end(const struct Queue * q, int * velocity);
+
+/// @brief Checks whether a segment of a type is queued or running.  Called from the foreground.
+/// @return 1 if there is one
+int queue_holds(const struct Queue * q, enum SegmentType type);
+
+#endif
@@ -0,0 +1,78 @@
+#include "NU32.h"
+#include "relay.h"
+
+/// @file relay.c
+/// @brief Implements the relay feedback experiment
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define PI 3.14159265f
+
+void relay_begin(struct Relay * r, int setpoint, int amplitude, int hysteresis, unsigned int cycles)
+{
+	unsigned int status = INTDisableInterrupts();
+	r->setpoint = setpoint;
+	r->amplitude = amplitude;
+	r->hysteresis = hysteresis;
+	r->output = amplitude;
+	r->measure = cycles ? cycles : 1;
+	r->cycles = RELAY_SETTLE + r->measure;
+	r->tick = 0;
+	r->rising = 0;
+	r->ymax = r->ymin = setpoint;
+	r->sum_period = 0;
+	r->sum_swing = 0;
+	INTRestoreInterrupts(status);
+}
+
+int relay_step(struct Relay * r, int y)
+{
+	if (r->cycles == 0)
+	{
+		return 0;
+	}
+
+	int e = r->setpoint - y;
+	++r->tick;
+	r->ymax = y > r->ymax ? y : r->ymax;
+	r->ymin = y < r->ymin ? y : r->ymin;
+	if (e < -r->hysteresis)
+	{
+		r->output = -r->amplitude;
+	}
+	else if (e > r->hysteresis && r->output < 0) // a rising switch ends a cycle
+	{
+		r->output = r->amplitude;
+		if (r->rising)
+		{
+			if (r->cycles <= r->measure) // settled
+			{
+				r->sum_period += r->tick;
+				r->sum_swing += r->ymax - r->ymin;
+			}
+			--r->cycles;
+		}
+		r->rising = 1;
+		r->tick = 0;
+		r->ymax = r->ymin = y;
+	}
+	return r->cycles ? r->output : 0;
+}
+
+int relay_done(const struct Relay * r)
+{
+	return r->cycles == 0;
+}
+
+int relay_result(const struct Relay * r, float * ku, float * tu)
+{
+	if (r->cycles != 0 || r->sum_swing <= 0)
+	{
+		return 0;
+	}
+	float a = (float)r->sum_swing/r->measure/2;
+	*ku = 4*r->amplitude/(PI*a);
+	*tu = (float)r->sum_period/r->measure;
+	return 1;
+}
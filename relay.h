@@ -0,0 +1,56 @@
+#ifndef RELAY_H_
+#define RELAY_H_
+/// @file relay.h
+/// @brief Relay feedback experiment for auto-tuning a control loop
+///	   A relay with hysteresis replaces the controller: its output is +amplitude while the
+///	   measurement is below the setpoint by more than the hysteresis and -amplitude while it is
+///	   above it by more than the hysteresis.  This drives the loop into a limit cycle at about
+///	   its ultimate period.  Every rising switch of the relay ends a cycle, whose period and
+///	   peak to peak measurement are accumulated, so each tick costs a few comparisons.
+///	   The ultimate gain follows from the describing function of the relay, 4*amplitude/(pi*a),
+///	   where a is the amplitude of the limit cycle.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define RELAY_SETTLE 2		/// the cycles the limit cycle is given to settle before measuring
+
+/// @brief A relay experiment.  The fields are private to relay.c.
+struct Relay {
+	int setpoint;			// the measurement the relay switches about
+	int amplitude;			// the output of the relay
+	int hysteresis;			// the error needed to switch the relay
+	int output;			// the output on this tick
+	volatile unsigned int cycles;	// the cycles left to settle and measure
+	unsigned int measure;		// the cycles to measure
+	unsigned int tick;		// ticks since the last rising switch
+	int rising;			// 1 once the first rising switch has happened
+	int ymax, ymin;			// the extremes of the measurement in this cycle
+	unsigned int sum_period;	// the sum of the measured periods, in ticks
+	int sum_swing;			// the sum of the measured peak to peak swings
+};
+
+/// @brief Starts an experiment
+/// @param r          The experiment
+/// @param setpoint   The measurement the relay switches about
+/// @param amplitude  The output of the relay, in the units of the control effort
+/// @param hysteresis The error needed to switch, in the units of the measurement
+/// @param cycles     The number of cycles to measure, at least 1
+void relay_begin(struct Relay * r, int setpoint, int amplitude, int hysteresis, unsigned int cycles);
+
+/// @brief Runs the relay for one tick.  Called from the control loop interrupt.
+/// @param y The measurement
+/// @return the control effort, 0 once the experiment is done
+int relay_step(struct Relay * r, int y);
+
+/// @brief Checks whether the experiment is over
+/// @return 1 if it is over
+int relay_done(const struct Relay * r);
+
+/// @brief Get the ultimate gain and period measured by the experiment
+/// @param ku [out] The ultimate gain, in effort per unit of measurement
+/// @param tu [out] The ultimate period, in ticks
+/// @return 1 on success, 0 if the experiment is not over or did not oscillate
+int relay_result(const struct Relay * r, float * ku, float * tu);
+
+#endif
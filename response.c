@@ -0,0 +1,88 @@
+#include <math.h>
+#include "NU32.h"
+#include "response.h"
+#include "excite.h"
+
+/// @file response.c
+/// @brief Implements the frequency response measurement
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define CORE_HZ (SYS_FREQ/2)		// the core timer frequency
+#define PI 3.14159265f
+
+float response_begin(struct Response * r, float hz, unsigned int period, int amplitude, unsigned int cycles)
+{
+	excite_sine(0); // fills the lookup table here rather than in the interrupt
+
+	unsigned int status = INTDisableInterrupts();
+	float rate = (float)CORE_HZ/period;
+	r->phase = 0;
+	r->step = (unsigned int)(hz/rate*4294967296.0f + 0.5f);
+	r->amplitude = amplitude;
+	r->measure = cycles ? cycles : 1;
+	r->periods = RESPONSE_SETTLE + r->measure;
+	r->injected = 0;
+	r->rre = r->rim = r->yre = r->yim = 0;
+	INTRestoreInterrupts(status);
+	return r->step*rate/4294967296.0f;
+}
+
+int response_reference(struct Response * r)
+{
+	if (r->periods == 0)
+	{
+		r->injected = 0;
+		return 0;
+	}
+	r->sine = excite_sine(r->phase);
+	r->cosine = excite_sine(r->phase + 0x40000000u);
+	r->injected = (r->amplitude*r->sine) >> 15;
+	return r->injected;
+}
+
+void response_update(struct Response * r, int y)
+{
+	if (r->periods == 0)
+	{
+		return;
+	}
+	if (r->periods <= r->measure) // settled
+	{
+		r->rre += (long long)r->injected*r->cosine;
+		r->rim -= (long long)r->injected*r->sine;
+		r->yre += (long long)y*r->cosine;
+		r->yim -= (long long)y*r->sine;
+	}
+
+	unsigned int next = r->phase + r->step;
+	if (next < r->phase) // a period has been completed
+	{
+		--r->periods;
+	}
+	r->phase = next;
+}
+
+int response_done(const struct Response * r)
+{
+	return r->periods == 0;
+}
+
+void response_result(const struct Response * r, float * gain, float * phase)
+{
+	float rmag = sqrtf((float)r->rre*r->rre + (float)r->rim*r->rim);
+	float ymag = sqrtf((float)r->yre*r->yre + (float)r->yim*r->yim);
+	*gain = rmag > 0 ? ymag/rmag : 0;
+
+	float p = (atan2f((float)r->yim,(float)r->yre) - atan2f((float)r->rim,(float)r->rre))*180/PI;
+	while (p > 180)
+	{
+		p -= 360;
+	}
+	while (p <= -180)
+	{
+		p += 360;
+	}
+	*phase = p;
+}
@@ -0,0 +1,57 @@
+#ifndef RESPONSE_H_
+#define RESPONSE_H_
+/// @file response.h
+/// @brief Measures the frequency response of a control loop at one frequency at a time
+///	   The loop injects a sine from a lookup table into its reference and correlates
+///	   the injected and measured signals with the sine and cosine of the same phase
+///	   (a single bin DFT), so each tick costs a table lookup and four multiply-adds.
+///	   The accumulators span a whole number of periods of the sine, after some periods
+///	   of settling, and the gain and phase are computed only once at the end.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define RESPONSE_SETTLE 2	/// the periods the loop is given to settle before measuring
+
+/// @brief A measurement at one frequency.  The fields are private to response.c.
+struct Response {
+	unsigned int phase;		// the phase of the sine, a full turn is 2^32
+	unsigned int step;		// the phase advance per tick
+	int amplitude;			// the amplitude of the injected sine
+	volatile unsigned int periods;	// the periods left to settle and measure
+	unsigned int measure;		// the periods to measure
+	int injected;			// the sine injected on this tick
+	int cosine, sine;		// the correlation kernel on this tick, Q15
+	long long rre, rim;		// the correlation of the injected signal
+	long long yre, yim;		// the correlation of the measured signal
+};
+
+/// @brief Starts a measurement
+/// @param r         The measurement
+/// @param hz        The frequency of the sine, in Hz
+/// @param period    The period of the loop, in core timer ticks
+/// @param amplitude The amplitude of the sine, in the units of the loop
+/// @param cycles    The number of periods of the sine to measure, at least 1
+/// @return the frequency actually used, in Hz
+float response_begin(struct Response * r, float hz, unsigned int period, int amplitude, unsigned int cycles);
+
+/// @brief Get the sine to add to the reference on this tick. Called from the control loop interrupt.
+/// @return the value to add to the reference, 0 once the measurement is done
+int response_reference(struct Response * r);
+
+/// @brief Records the measured signal of this tick and advances to the next tick.
+///	   Called from the control loop interrupt after response_reference().
+/// @param y The measured signal, without the offset the sine is added to
+void response_update(struct Response * r, int y);
+
+/// @brief Checks whether the measurement is over
+/// @return 1 if it is over
+int response_done(const struct Response * r);
+
+/// @brief Computes the response from the measured signal to the injected sine
+/// @param gain  [out] The gain, measured amplitude over injected amplitude
+/// @param phase [out] The phase of the measured signal relative to the injected sine, in degrees
+/// @pre   response_done() is 1
+void response_result(const struct Response * r, float * gain, float * phase);
+
+#endif
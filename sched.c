@@ -0,0 +1,322 @@
+#include "NU32.h"
+#include "sched.h"
+#include "load.h"
+
+/// @file sched.c
+/// @brief Implements the multi-rate task scheduler
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define PRESCALE 8		// timer 1 prescaler
+#define CORE_PER_PB 2		// the core timer counts once every 2 peripheral bus clocks
+
+struct Task {
+	const char * name;
+	void (*run)(void);
+	enum SchedLevel level;
+	unsigned int divider, phase;
+	unsigned int countdown;		// ticks until the task is next due
+	volatile unsigned char pending;	// a deferred task is due but has not started yet
+	volatile unsigned char running;	// the task is executing (and may have been preempted)
+	unsigned char have_last;	// last_start is valid
+	unsigned int last_start;	// core timer count when the task last started
+	unsigned int release;		// core timer count of the tick that last released the task
+	unsigned int runs, max_jitter, max_time, late, overruns;
+};
+
+static struct Task tasks[SCHED_MAX_TASKS];
+static int ntasks = 0;
+static unsigned int base_hz = SCHED_BASE_HZ;
+static unsigned int last_tick = 0;	// core timer count when the tick interrupt last started
+static int have_tick = 0;		// last_tick is valid
+
+/// @brief Get the base tick period
+/// @return the base period, in core timer ticks
+static unsigned int base_period(void);
+
+/// @brief Runs a task, updating its timing statistics
+static void run_task(struct Task * t);
+
+/// @brief Restarts the period of every task
+static void restart(void);
+
+void __ISR(_TIMER_1_VECTOR,IPL7SRS) Sched_Tick_Interrupt(void)
+{
+	IFS0CLR = _IFS0_T1IF_MASK; // clear first, so a tick that arrives while we run shows up as an overrun
+
+	// the tick is late if interrupts were held off past the next tick
+	unsigned int now = _CP0_GET_COUNT(), base = base_period();
+	int late = have_tick && now - last_tick > base + base/2;
+	last_tick = now;
+	have_tick = 1;
+
+	int i = 0, defer = 0;
+	unsigned char ran[SCHED_MAX_TASKS];
+	for (i = 0; i != ntasks; ++i)
+	{
+		struct Task * t = &tasks[i];
+		ran[i] = 0;
+		if (t->countdown != 0)
+		{
+			--t->countdown;
+			continue;
+		}
+
+		t->countdown = t->divider - 1;
+		if (t->level == SCHED_TICK)
+		{
+			t->late += late;
+			run_task(t);
+			ran[i] = 1;
+		}
+		else
+		{
+			if (t->pending || t->running)
+			{
+				++t->overruns; // the previous run has not finished, or not even started
+			}
+			t->release = now;
+			t->pending = 1;
+			defer = 1;
+		}
+	}
+
+	if (defer)
+	{
+		IFS0SET = _IFS0_T2IF_MASK; // runs Sched_Deferred_Interrupt once we return
+	}
+
+	if (IFS0bits.T1IF) // the next tick is already due: the tasks in this one overran
+	{
+		for (i = 0; i != ntasks; ++i)
+		{
+			tasks[i].overruns += ran[i];
+		}
+	}
+	load_add(LOAD_TICK,_CP0_GET_COUNT() - now);
+}
+
+void __ISR(_TIMER_2_VECTOR,IPL6SOFT) Sched_Deferred_Interrupt(void)
+{
+	IFS0CLR = _IFS0_T2IF_MASK; // clear first, so a tick that releases more tasks is not lost
+
+	// ticks that preempt us are accounted for by the tick itself
+	unsigned int start = _CP0_GET_COUNT(), tick = load_total(LOAD_TICK);
+	int i = 0;
+	for (i = 0; i != ntasks; ++i)
+	{
+		struct Task * t = &tasks[i];
+		if (t->pending)
+		{
+			t->pending = 0;
+			if (_CP0_GET_COUNT() - t->release > base_period())
+			{
+				++t->late; // started after the tick following its release
+			}
+			run_task(t);
+		}
+	}
+	load_add(LOAD_DEFERRED,_CP0_GET_COUNT() - start - (load_total(LOAD_TICK) - tick));
+}
+
+void sched_init(void)
+{
+	ntasks = 0;
+	base_hz = SCHED_BASE_HZ;
+
+	// timer 1 generates the base tick
+	T1CONbits.ON = 0;
+	T1CONbits.TCS = 0;
+	T1CONbits.TCKPS = 0b01;		// prescaler N = 8
+	PR1 = SYS_FREQ/PRESCALE/base_hz - 1;
+	TMR1 = 0;
+	IPC1bits.T1IP = 7;
+	IPC1bits.T1IS = 0;
+	IFS0bits.T1IF = 0;
+	IEC0bits.T1IE = 1;
+
+	// the timer 2 interrupt runs the deferred tasks. It is only ever raised in software
+	T2CONbits.ON = 0;
+	IPC2bits.T2IP = 6;
+	IPC2bits.T2IS = 0;
+	IFS0bits.T2IF = 0;
+	IEC0bits.T2IE = 1;
+
+	T1CONbits.ON = 1;
+}
+
+int sched_register(const char * name, void (*task)(void), unsigned int divider, unsigned int phase, enum SchedLevel level)
+{
+	if (ntasks == SCHED_MAX_TASKS || !task || divider == 0 || phase >= divider)
+	{
+		return -1;
+	}
+
+	struct Task * t = &tasks[ntasks];
+	t->name = name;
+	t->run = task;
+	t->level = level;
+	t->divider = divider;
+	t->phase = phase;
+	t->countdown = phase;
+	t->pending = 0;
+	t->running = 0;
+	t->have_last = 0;
+	t->runs = t->max_jitter = t->max_time = t->late = t->overruns = 0;
+	return ntasks++;
+}
+
+int sched_divider_set(int index, unsigned int divider, unsigned int phase)
+{
+	if (index < 0 || index >= ntasks || divider == 0 || phase >= divider)
+	{
+		return 0;
+	}
+
+	unsigned int status = INTDisableInterrupts();
+	tasks[index].divider = divider;
+	tasks[index].phase = phase;
+	restart();
+	INTRestoreInterrupts(status);
+	return 1;
+}
+
+int sched_base_set(unsigned int hz)
+{
+	unsigned int period = hz ? SYS_FREQ/PRESCALE/hz : 0;
+	if (period < 2 || period > 0x10000)
+	{
+		return 0; // PR1 is 16 bits
+	}
+
+	unsigned int status = INTDisableInterrupts();
+	T1CONbits.ON = 0;
+	PR1 = period - 1;
+	TMR1 = 0;
+
+	// keep the rate of each task as close as possible to what it was
+	int i = 0;
+	for (i = 0; i != ntasks; ++i)
+	{
+		struct Task * t = &tasks[i];
+		unsigned int divider = ((unsigned long long)t->divider*hz + base_hz/2)/base_hz;
+		t->divider = divider ? divider : 1;
+		t->phase = (unsigned long long)t->phase*hz/base_hz;
+		if (t->phase >= t->divider)
+		{
+			t->phase = t->divider - 1;
+		}
+	}
+	base_hz = hz;
+	restart();
+	T1CONbits.ON = 1;
+	INTRestoreInterrupts(status);
+	return 1;
+}
+
+unsigned int sched_base_hz(void)
+{
+	return base_hz;
+}
+
+unsigned int sched_period(int index)
+{
+	if (index < 0 || index >= ntasks)
+	{
+		return 0;
+	}
+	return tasks[index].divider*base_period();
+}
+
+int sched_find(const char * name)
+{
+	int i = 0;
+	for (i = 0; i != ntasks; ++i)
+	{
+		if (strcmp(tasks[i].name,name) == 0)
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+int sched_count(void)
+{
+	return ntasks;
+}
+
+int sched_stats(int index, struct SchedStats * stats)
+{
+	if (index < 0 || index >= ntasks)
+	{
+		return 0;
+	}
+
+	const struct Task * t = &tasks[index];
+	stats->name = t->name;
+	stats->level = t->level;
+	stats->divider = t->divider;
+	stats->phase = t->phase;
+	stats->runs = t->runs;
+	stats->max_jitter = t->max_jitter;
+	stats->max_time = t->max_time;
+	stats->late = t->late;
+	stats->overruns = t->overruns;
+	return 1;
+}
+
+void sched_stats_reset(void)
+{
+	int i = 0;
+	for (i = 0; i != ntasks; ++i)
+	{
+		tasks[i].runs = tasks[i].max_jitter = tasks[i].max_time = 0;
+		tasks[i].late = tasks[i].overruns = 0;
+	}
+}
+
+static void run_task(struct Task * t)
+{
+	unsigned int start = _CP0_GET_COUNT();
+	t->running = 1;
+	t->run();
+	t->running = 0;
+	unsigned int time = _CP0_GET_COUNT() - start;
+
+	if (t->have_last)
+	{
+		unsigned int period = t->divider*base_period();
+		unsigned int interval = start - t->last_start;
+		unsigned int jitter = interval > period ? interval - period : period - interval;
+		if (jitter > t->max_jitter)
+		{
+			t->max_jitter = jitter;
+		}
+	}
+	if (time > t->max_time)
+	{
+		t->max_time = time;
+	}
+	t->last_start = start;
+	t->have_last = 1;
+	++t->runs;
+}
+
+static unsigned int base_period(void)
+{
+	return (PR1 + 1)*PRESCALE/CORE_PER_PB;
+}
+
+static void restart(void)
+{
+	int i = 0;
+	have_tick = 0;
+	for (i = 0; i != ntasks; ++i)
+	{
+		tasks[i].countdown = tasks[i].phase;
+		tasks[i].pending = 0;
+		tasks[i].have_last = 0;
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef SCHED_H_
+#define SCHED_H_
+/// @file sched.h
+/// @brief Runs the periodic tasks (current loop, motion loop, diagnostics) from one timer
+///	   Timer 1 generates the base tick at priority 7.  Every task runs once every
+///	   divider ticks, phase ticks into its period, so the relative timing of the loops
+///	   is fixed.  SCHED_TICK tasks run inside the tick interrupt itself.  SCHED_DEFERRED
+///	   tasks run at priority 6 as soon as the tick interrupt returns: the tick raises the
+///	   timer 2 interrupt flag in software (timer 2 itself is not running), so the current
+///	   loop can still preempt them.
+///	   Every task counts late starts and overruns, so a rate that no longer fits is noticed.
+///
+///	   The tasks preempt the foreground, but the foreground never preempts a task.  So when
+///	   the foreground sets up several fields a task reads together, such as the start of a
+///	   measurement or the queue of motion segments, it holds the tasks off with
+///	   INTDisableInterrupts() and INTRestoreInterrupts() around the writes; otherwise a tick
+///	   could see half of them.  A task needs no such guard against the foreground.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define SCHED_MAX_TASKS 8	/// the maximum number of tasks that can be registered
+#define SCHED_BASE_HZ 5000	/// the default base tick rate, in Hz
+
+/// @brief Where a task runs
+enum SchedLevel {
+		SCHED_TICK,	/// inside the priority 7 tick interrupt
+		SCHED_DEFERRED	/// in the priority 6 interrupt that follows the tick
+		};
+
+/// @brief Timing statistics of a task, collected since the last sched_stats_reset()
+struct SchedStats {
+	const char * name;		/// the name of the task
+	enum SchedLevel level;		/// where the task runs
+	unsigned int divider;		/// the task runs every divider ticks
+	unsigned int phase;		/// ...this many ticks into its period
+	unsigned int runs;		/// the number of times the task ran
+	unsigned int max_jitter;	/// largest deviation of the time between two runs from the period, in core timer ticks
+	unsigned int max_time;		/// longest execution time, in core timer ticks
+	unsigned int late;		/// runs that started more than a base tick after they were due
+	unsigned int overruns;		/// runs that were still executing, or had not started, when the next one was due
+};
+
+/// @brief Sets up timer 1 for the base tick at SCHED_BASE_HZ and the deferred interrupt
+/// @pre   Interrupts are disabled
+void sched_init(void);
+
+/// @brief Registers a periodic task.  This should be called during initialization.
+/// @param name    The name of the task, used in diagnostics
+/// @param task    The function to run
+/// @param divider The task runs every divider base ticks, at least 1
+/// @param phase   The tick within the period on which the task runs, less than divider
+/// @param level   Where the task runs
+/// @return the index of the task, or -1 if there is no room or the divider or phase is invalid
+int sched_register(const char * name, void (*task)(void), unsigned int divider, unsigned int phase, enum SchedLevel level);
+
+/// @brief Changes how often a task runs
+/// @param index   The index of the task
+/// @param divider The task runs every divider base ticks, at least 1
+/// @param phase   The tick within the period on which the task runs, less than divider
+/// @return 1 on success, 0 if the index, divider or phase is invalid
+int sched_divider_set(int index, unsigned int divider, unsigned int phase);
+
+/// @brief Changes the base tick rate
+/// @param hz The new base rate, in Hz
+/// @return 1 on success, 0 if the rate cannot be produced by timer 1
+/// @post  The dividers are scaled so every task keeps its rate as closely as possible.
+///	   Every task starts a new period on the next tick.
+int sched_base_set(unsigned int hz);
+
+/// @brief Get the base tick rate
+/// @return the base tick rate, in Hz
+unsigned int sched_base_hz(void);
+
+/// @brief Get the period of a task
+/// @param index The index of the task
+/// @return the period of the task in core timer ticks, or 0 if the index is invalid
+unsigned int sched_period(int index);
+
+/// @brief Finds a task by name
+/// @return the index of the task, or -1 if there is no such task
+int sched_find(const char * name);
+
+/// @brief Get the number of registered tasks
+int sched_count(void);
+
+/// @brief Get the timing statistics of a task
+/// @param index The index of the task
+/// @param stats [out] The statistics
+/// @return 1 on success, 0 if the index is invalid
+int sched_stats(int index, struct SchedStats * stats);
+
+/// @brief Starts a new measurement window for the timing statistics of all tasks
+void sched_stats_reset(void);
+
+#endif
@@ -0,0 +1,37 @@
+#include "NU32.h"
+#include "setpoint.h"
+
+/// @file setpoint.c
+/// @brief Implements the single writer, single reader setpoint mailbox
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+// slots[seq & 1] is the newest complete setpoint.  Both are volatile so the compiler
+// cannot move the writes to a slot past the write to seq that publishes it.
+static volatile struct Setpoint slots[2];
+static volatile unsigned int seq = 0;
+
+void setpoint_write(int current, int voltage)
+{
+	unsigned int next = seq + 1;
+	volatile struct Setpoint * sp = &slots[next & 1];
+
+	// the reader may interrupt us here, but it reads slots[seq & 1], not this slot
+	sp->current = current;
+	sp->voltage = voltage;
+	sp->stamp = _CP0_GET_COUNT();
+	sp->seq = next;
+	seq = next; // publish
+}
+
+unsigned int setpoint_read(struct Setpoint * sp)
+{
+	// the writer cannot run until we return, so the slot cannot change under us
+	const volatile struct Setpoint * newest = &slots[seq & 1];
+	sp->current = newest->current;
+	sp->voltage = newest->voltage;
+	sp->stamp = newest->stamp;
+	sp->seq = newest->seq;
+	return _CP0_GET_COUNT() - sp->stamp;
+}
@@ -0,0 +1,32 @@
+#ifndef SETPOINT_H_
+#define SETPOINT_H_
+/// @file setpoint.h
+/// @brief The mailbox that passes the current reference from the motion loop to the current loop
+///	   There is exactly one writer, the motion ISR (priority 6), and one reader, the current
+///	   ISR (priority 7).  The reader may interrupt the writer at any point, but never the other
+///	   way around.  The mailbox has two slots: the writer fills the slot the reader is not
+///	   using and then publishes it by bumping a sequence counter, so the reader always gets the
+///	   newest complete setpoint without waiting or retrying.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief A setpoint for the current loop
+struct Setpoint {
+	int current;		/// the current reference, in mA
+	int voltage;		/// feedforward added to the control effort, in the same units (+/- 2000 is full duty)
+	unsigned int stamp;	/// the core timer count when the setpoint was written
+	unsigned int seq;	/// the sequence number of the setpoint, incremented on every write
+};
+
+/// @brief Publishes a new setpoint.  Only the motion ISR may call this.
+/// @param current The current reference, in mA
+/// @param voltage The feedforward term, in control effort units
+void setpoint_write(int current, int voltage);
+
+/// @brief Gets the newest setpoint.  Only the current ISR may call this.
+/// @param sp [out] The newest complete setpoint
+/// @return the age of the setpoint, in core timer ticks
+unsigned int setpoint_read(struct Setpoint * sp);
+
+#endif
@@ -1,4 +1,7 @@
 #include "NU32.h"
+#include "streaming.h"
+#include "load.h"
+#include "trace.h"
 
 #define BUFFER_SIZE 4096	//the size of the input buffer, in items
 #define N_VARS 3 		//the number of variables to write
@@ -10,10 +13,23 @@ static volatile unsigned int overflow = 0;	// the number of times the buffer ove
 
 static volatile unsigned int nsamples = 0; // the number of samples to record
 static volatile unsigned int wsamples = 0; // the number of samples written
+static unsigned int rsamples = 0;	   // the number of samples read
+static unsigned int requested = 0;	   // the number of samples streaming_begin() was given
 
 static volatile unsigned int w_pos = 0;	// position in the buffer from which to read
 static volatile unsigned int r_pos = 0;	// position in the buffer from which to write
 
+static unsigned int cost_samples = 0;	// the samples formatted since streaming_cost was last called
+static unsigned int cost_ticks = 0;	// the foreground time formatting them took
+
+/// @brief Where streaming_poll() is in the stream
+enum Phase {
+	HEADER,		// the dimensions are next
+	SAMPLES,	// sending the samples
+	FINISHED	// the overflows have been reported
+};
+static enum Phase phase = FINISHED;
+
 
 void streaming_begin(unsigned int nsamp)
 {
@@ -21,6 +37,9 @@ void streaming_begin(unsigned int nsamp)
 	r_pos = 0;
 	overflow = 0;
 	wsamples = 0;
+	rsamples = 0;
+	requested = nsamp;
+	phase = HEADER;
 	nsamples = nsamp;
 }
 
@@ -41,6 +60,10 @@ void streaming_record(int r, int s, int u)
 		if(w_pos == r_pos) //an overflow has occurred
 		{
 			++overflow; //update the overflow count
+			if(overflow == 1)
+			{
+				trace_record(TRACE_STREAM_OVERFLOW,wsamples,overflow);
+			}
 				    //this means the next write will overwrite data
 				    //so advance the r_pos by one to skip over the oldest data
 			++r_pos;
@@ -59,31 +82,118 @@ void streaming_record(int r, int s, int u)
 
 void streaming_write(void)
 {
-	char buffer[100];
-	int rsamples = 0;
+	int progress = STREAM_SENT;
+	while (progress != STREAM_DONE)
+	{
+		progress = streaming_poll();
+		if (progress == STREAM_WAITING)
+		{
+			// waiting for samples counts as idle time, as in command_serve()
+			load_idle_begin();
+			while (streaming_available() == 0 && streaming_remaining() != 0)
+			{
+				;
+			}
+			load_idle_end();
+		}
+	}
+}
 
-	//send the dimensions of the data
-	sprintf(buffer,"%u %u\r\n",nsamples,N_VARS);
-	NU32_WriteUART1(buffer);
-	for(rsamples = 0; rsamples != nsamples; ++rsamples)
+int streaming_poll(void)
+{
+	char buffer[100];
+	if (phase == HEADER)
+	{
+		//send the dimensions of the data
+		sprintf(buffer,"%u %u\r\n",requested,N_VARS);
+		NU32_WriteUART1(buffer);
+		phase = SAMPLES;
+		return STREAM_SENT;
+	}
+	if (phase == SAMPLES && rsamples != nsamples)
 	{
-		//wait for data to become available
-		while(w_pos == r_pos)
+		if (rsamples == wsamples)
 		{
-			;
+			return STREAM_WAITING;
 		}
-		sprintf(buffer,"%d %d %d\r\n",r_buf[r_pos],s_buf[r_pos],u_buf[r_pos]);
+		int r = 0, s = 0, u = 0;
+		streaming_read(&r,&s,&u);
+		unsigned int start = load_foreground_clock();
+		sprintf(buffer,"%d %d %d\r\n",r,s,u);
+		cost_ticks += load_foreground_clock() - start;
+		++cost_samples;
 		NU32_WriteUART1(buffer);
-		++r_pos;
-		if(r_pos == BUFFER_SIZE)
+		return STREAM_SENT;
+	}
+	if (phase == SAMPLES)
+	{
+		phase = FINISHED;
+		unsigned int overflows = streaming_end();
+		if (overflows > 0)
 		{
-			r_pos = 0;
+			sprintf(buffer,"\a%u overflows detected.",overflows);
+			NU32_WriteUART1(buffer);
 		}
+		if (rsamples != requested)
+		{
+			sprintf(buffer,"\aStopped after %u samples.",rsamples);
+			NU32_WriteUART1(buffer);
+		}
+	}
+	return STREAM_DONE;
+}
+
+void streaming_stop(void)
+{
+	// the loop may be recording, so keep it out between reading wsamples and setting nsamples
+	unsigned int status = INTDisableInterrupts();
+	nsamples = wsamples;
+	INTRestoreInterrupts(status);
+}
+
+unsigned int streaming_available(void)
+{
+	return wsamples - rsamples;
+}
+
+unsigned int streaming_remaining(void)
+{
+	return nsamples - rsamples;
+}
+
+void streaming_read(int * r, int * s, int * u)
+{
+	//wait for data to become available
+	load_idle_begin();
+	while(w_pos == r_pos)
+	{
+		;
+	}
+	load_idle_end();
+	*r = r_buf[r_pos];
+	*s = s_buf[r_pos];
+	*u = u_buf[r_pos];
+	++r_pos;
+	if(r_pos == BUFFER_SIZE)
+	{
+		r_pos = 0;
 	}
-	
+	++rsamples;
+}
+
+unsigned int streaming_end(void)
+{
 	if(overflow > 0)
 	{
-		sprintf(buffer,"\a%u overflows detected.",overflow);
-		NU32_WriteUART1(buffer);
+		trace_record(TRACE_STREAM_OVERFLOW,wsamples,overflow);
 	}
+	return overflow;
+}
+
+void streaming_cost(unsigned int * samples, unsigned int * ticks)
+{
+	*samples = cost_samples;
+	*ticks = cost_ticks;
+	cost_samples = 0;
+	cost_ticks = 0;
 }
@@ -25,7 +25,47 @@ void streaming_begin(unsigned int nsamp);
 void streaming_record(int r, int s, int u);
 
 
+/// @brief What streaming_poll() did
+enum StreamPoll {
+		STREAM_DONE,	/// the stream is complete
+		STREAM_SENT,	/// a piece of the stream was sent
+		STREAM_WAITING	/// the next sample has not been recorded yet
+		};
+
 /// @brief Called from the communication code to write the samples over the serial port. 
+///	   Waits until all of them have been sent.
 void streaming_write(void);
 
+/// @brief Sends what streaming_write() sends a piece at a time, without waiting for samples, so
+///	   the caller can serve commands between the pieces: the dimensions on the first call after
+///	   streaming_begin(), then one sample per call as they are recorded, then any overflow or
+///	   stop report.
+/// @return an enum StreamPoll
+int streaming_poll(void);
+
+/// @brief Cuts the stream short at the samples recorded so far.  Called when the loop that
+///	   records them stops, so the reader does not wait for samples that will never come.
+void streaming_stop(void);
+
+/// @brief Get the number of samples recorded and not yet read
+unsigned int streaming_available(void);
+
+/// @brief Get the number of samples still to be read, recorded or not
+unsigned int streaming_remaining(void);
+
+/// @brief Waits for the next sample and takes it out of the buffer, for code that sends the
+///	   samples in another format than streaming_write().  Call it once per sample to be read.
+/// @param r, s, u [out] The sample
+void streaming_read(int * r, int * s, int * u);
+
+/// @brief Call after the last sample has been read with streaming_read()
+/// @return the number of samples lost because the buffer overflowed
+unsigned int streaming_end(void);
+
+/// @brief Get and reset the time streaming_write() spent formatting samples, not counting the
+///	   time it waited for them or for the serial port
+/// @param samples [out] The number of samples formatted
+/// @param ticks   [out] The time it took, in core timer ticks
+void streaming_cost(unsigned int * samples, unsigned int * ticks);
+
 #endif
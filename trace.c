@@ -0,0 +1,61 @@
+#include "NU32.h"
+#include "trace.h"
+
+/// @file trace.c
+/// @brief Implements the binary event trace
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+static struct TraceEntry entries[TRACE_SIZE];
+static unsigned int head = 0;		// the number of entries ever recorded, head % TRACE_SIZE is the next slot
+static volatile int enabled = 0;
+
+void trace_init(void)
+{
+	unsigned int status = INTDisableInterrupts();
+	head = 0;
+	enabled = 1;
+	INTRestoreInterrupts(status);
+}
+
+void trace_record(enum TraceEvent event, int a, int b)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	// any interrupt level may record, so claim and fill the slot in one go
+	unsigned int status = INTDisableInterrupts();
+	struct TraceEntry * e = &entries[head % TRACE_SIZE];
+	e->stamp = _CP0_GET_COUNT();
+	e->event = event;
+	e->seq = head;
+	e->a = a;
+	e->b = b;
+	++head;
+	INTRestoreInterrupts(status);
+}
+
+void trace_enable(int on)
+{
+	enabled = on;
+}
+
+unsigned int trace_count(void)
+{
+	return head < TRACE_SIZE ? head : TRACE_SIZE;
+}
+
+int trace_entry(unsigned int index, struct TraceEntry * entry)
+{
+	unsigned int status = INTDisableInterrupts();
+	unsigned int count = trace_count(), first = head - count;
+	if (index < count)
+	{
+		*entry = entries[(first + index) % TRACE_SIZE];
+	}
+	INTRestoreInterrupts(status);
+	return index < count;
+}
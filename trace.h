@@ -0,0 +1,59 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+/// @file trace.h
+/// @brief A ring of binary trace entries recording state transitions and control events,
+///	   so that problems in the field can be diagnosed after the fact.
+///	   Entries may be recorded from the interrupts and from the foreground.
+///	   When the ring is full the oldest entries are overwritten.
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+/// @brief The number of entries kept, a power of two
+#define TRACE_SIZE 256
+
+/// @brief The events that are traced, and the meaning of their two arguments
+enum TraceEvent {
+		TRACE_STATE = 1,	/// core_state changed: old state, new state
+		TRACE_VOLTAGE_SAT,	/// set_u started saturating: requested effort, applied effort
+		TRACE_CURRENT_SAT,	/// current_amps_set started saturating: requested mA, applied mA
+		TRACE_MOTION_CLAMP,	/// the motion integrator started clamping: unclamped integral, clamped integral
+		TRACE_STREAM_OVERFLOW,	/// the stream buffer overflowed: samples recorded so far, overflows so far
+		TRACE_FLASH_PACK,	/// the emulated eeprom packed a page: PackEE status, duration in us
+		TRACE_COMMAND,		/// a command arrived: menu character, command character (0 for the main menu),
+					/// or COMMAND_SYNC and the opcode of a binary frame
+		TRACE_EVENTS
+	       };
+
+/// @brief One entry of the trace. 16 bytes.
+struct TraceEntry {
+	unsigned int stamp;	/// the core timer count when the event was recorded (25 ns ticks)
+	unsigned short event;	/// an enum TraceEvent
+	unsigned short seq;	/// counts every entry recorded, so gaps and wrap around can be detected
+	int a, b;		/// the arguments of the event
+};
+
+/// @brief Empties the trace and enables recording
+void trace_init(void);
+
+/// @brief Records an event
+/// @param event The event
+/// @param a     The first argument
+/// @param b     The second argument
+void trace_record(enum TraceEvent event, int a, int b);
+
+/// @brief Enables or disables recording, so the trace can be read without it changing
+/// @param on 1 to record events, 0 to ignore them
+void trace_enable(int on);
+
+/// @brief Get the number of entries in the trace
+/// @return the number of entries, at most TRACE_SIZE
+unsigned int trace_count(void);
+
+/// @brief Get an entry of the trace
+/// @param index The index of the entry, 0 is the oldest
+/// @param entry [out] The entry
+/// @return 1 on success, 0 if the index is invalid
+int trace_entry(unsigned int index, struct TraceEntry * entry);
+
+#endif
@@ -0,0 +1,119 @@
+#include <math.h>
+#include "velocity.h"
+
+/// @file velocity.c
+/// @brief Implements the velocity estimators
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define PI 3.14159265f
+
+/// @brief Get a * b >> 16, rounded to nearest
+static int scale(int a, int b);
+
+void velocity_gains(struct VelocityGains * g, int mode, float hz, float period)
+{
+	// the pole of one tick of the bandwidth
+	float p = expf(-2*PI*hz*period);
+	g->mode = mode >= 0 && mode < VELOCITY_MODES ? mode : VELOCITY_DIFFERENCE;
+	g->alpha = (int)((1 - p)*65536 + 0.5f);
+	// predict x += v, then correct x by kp*e and v by ki*e, where e is the error of the prediction:
+	// the characteristic polynomial z^2 - (2 - kp - ki) z + (1 - kp) has a double root at p
+	g->kp = (int)((1 - p*p)*65536 + 0.5f);
+	g->ki = (int)((1 - p)*(1 - p)*65536 + 0.5f);
+	g->span = (unsigned int)(1/(2*PI*hz*period) + 0.5f);
+	g->span = g->span ? g->span : 1;
+	g->window = (unsigned int)(VELOCITY_STILL/period + 0.5f);
+	g->window = g->window > g->span ? g->window : g->span;
+}
+
+void velocity_reset(struct Velocity * v)
+{
+	v->mode = -1;
+}
+
+int velocity_update(struct Velocity * v, const volatile struct VelocityGains * g, int x)
+{
+	int mode = g->mode, d = x - v->previous;
+	if (mode != v->mode)
+	{
+		v->mode = mode;
+		v->previous = x;
+		v->velocity = 0;
+		v->position = x;
+		v->anchor = x;
+		v->elapsed = 0;
+		v->step = 0;
+		v->since = g->window;
+		return 0;
+	}
+	v->previous = x;
+
+	switch (mode)
+	{
+		case VELOCITY_FILTER:
+		{
+			v->velocity += scale(g->alpha,d - v->velocity);
+			break;
+		}
+		case VELOCITY_PLL:
+		{
+			int predicted = v->position + v->velocity, e = x - predicted;
+			v->position = predicted + scale(g->kp,e);
+			v->velocity += scale(g->ki,e);
+			break;
+		}
+		case VELOCITY_EDGES:
+		{
+			++v->elapsed;
+			if (d != 0)
+			{
+				v->step = d;
+				v->since = 0;
+				if (v->elapsed >= g->span)
+				{
+					v->velocity = (x - v->anchor)/(int)v->elapsed;
+					v->anchor = x;
+					v->elapsed = 0;
+				}
+			}
+			else if (v->since < g->window)
+			{
+				// no change for a while, so the velocity is at most the last change over the wait
+				++v->since;
+				int bound = (v->step < 0 ? -v->step : v->step)/(int)v->since;
+				if (v->since == g->window)
+				{
+					v->velocity = 0;
+				}
+				else if (v->velocity > bound)
+				{
+					v->velocity = bound;
+				}
+				else if (v->velocity < -bound)
+				{
+					v->velocity = -bound;
+				}
+			}
+			else
+			{
+				// at rest, so the next measurement begins at the next change
+				v->anchor = x;
+				v->elapsed = 0;
+			}
+			break;
+		}
+		default:
+		{
+			v->velocity = d;
+			break;
+		}
+	}
+	return v->velocity;
+}
+
+static int scale(int a, int b)
+{
+	return (int)(((long long)a*b + (1 << 15)) >> 16);
+}
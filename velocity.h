@@ -0,0 +1,71 @@
+#ifndef VELOCITY_H_
+#define VELOCITY_H_
+/// @file velocity.h
+/// @brief Estimates the velocity of a quantised position once per control loop tick
+///	   The difference of the position on successive ticks jumps by a whole quantum whenever
+///	   the encoder crosses an edge, so a derivative gain turns it into bursts of current.
+///	   The estimators trade that noise for lag:
+///	   - a first-order low-pass filter of the difference, with its corner at the bandwidth;
+///	   - a second-order tracking loop (a PLL) that follows the position with both its poles at
+///	     the bandwidth, and whose velocity state is the estimate.  It has no lag in following
+///	     a constant velocity, and its noise falls with the bandwidth;
+///	   - the time between edges: the distance from the change of the position that began the
+///	     measurement to the first change at least one time constant of the bandwidth after it,
+///	     over the ticks between them.  Measured from edge to edge, a constant velocity comes out
+///	     without the quantisation of a fixed time.  While no change comes the estimate falls as
+///	     1/t, and after VELOCITY_STILL seconds it is 0.
+///	   All arithmetic is in integers on positions << 16.  The coefficients are worked out in
+///	   floating point outside the loop by velocity_gains().
+/// @author Siyuan Yu
+/// @version 1.0
+/// @date 2026-10-19
+
+#define VELOCITY_STILL 0.25f	/// the seconds without a change of the position after which VELOCITY_EDGES reads 0
+
+/// @brief How the velocity is estimated
+enum VelocityMode {
+		VELOCITY_DIFFERENCE,	/// the change of the position on the last tick
+		VELOCITY_FILTER,	/// the change of the position through a first-order low-pass filter
+		VELOCITY_PLL,		/// the velocity of a tracking loop locked to the position
+		VELOCITY_EDGES,		/// the last change of the position over the ticks it took
+		VELOCITY_MODES
+		};
+
+/// @brief The coefficients of an estimator
+struct VelocityGains {
+	int mode;		/// an enum VelocityMode
+	int alpha;		/// VELOCITY_FILTER: the weight of the new difference, << 16
+	int kp, ki;		/// VELOCITY_PLL: the corrections of the position and velocity per unit of error, << 16
+	unsigned int span;	/// VELOCITY_EDGES: the fewest ticks a measurement takes
+	unsigned int window;	/// VELOCITY_EDGES: the ticks without a change after which the velocity is 0
+};
+
+/// @brief An estimator.  The fields are private to velocity.c.
+struct Velocity {
+	int mode;		// the mode the state was started in, -1 to start again on the next tick
+	int previous;		// the position on the last tick
+	int velocity;		// the estimate
+	int position;		// VELOCITY_PLL: the position of the loop
+	int anchor;		// VELOCITY_EDGES: the position at the change that began the measurement
+	unsigned int elapsed;	// VELOCITY_EDGES: the ticks since that change
+	int step;		// VELOCITY_EDGES: the last change of the position
+	unsigned int since;	// VELOCITY_EDGES: the ticks since the last change
+};
+
+/// @brief Works out the coefficients of an estimator
+/// @param g      [out] The coefficients
+/// @param mode   An enum VelocityMode
+/// @param hz     The bandwidth, in Hz
+/// @param period The loop period, in seconds
+void velocity_gains(struct VelocityGains * g, int mode, float hz, float period);
+
+/// @brief Makes the estimator start again from the next position, at rest
+void velocity_reset(struct Velocity * v);
+
+/// @brief Runs the estimator for one tick.  Called from the control loop interrupt.
+///	   When g->mode differs from the mode of the state, the estimator starts again.
+/// @param x The position, in units << 16
+/// @return the velocity, in units << 16 per tick
+int velocity_update(struct Velocity * v, const volatile struct VelocityGains * g, int x);
+
+#endif